@@ -0,0 +1,692 @@
+/**
+ * ecc-bench: scaling benchmarks for compiler phases and the fds containers.
+ *
+ * Every benchmark is run at a series of doubling sizes. Each size gets one untimed
+ * warm-up run followed by a number of timed trials, and the min/median/mean/stddev of the
+ * trials is written as one JSON object per line. A summary on stderr lists the scaling
+ * exponent between consecutive sizes (time ratio over work ratio on a log scale), so
+ * anything noticeably above 1 is super-linear.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cgen.h"
+#include "cli/argparse.h"
+#include "codegen/block_layout.h"
+#include "codegen/elf_writer.h"
+#include "fds/bitset.h"
+#include "fds/densegraph.h"
+#include "fds/interner.h"
+#include "frontend/include_cache.h"
+#include "frontend/lex_split.h"
+#include "frontend/symtab.h"
+#include "ir/call_graph.h"
+#include "ir/control_graph.h"
+#include "ir/interpreter.h"
+#include "ir/profile.h"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+namespace {
+
+// results are folded into this so the optimizer can't drop the measured work
+volatile size_t sink;
+
+struct Options {
+    unsigned trials = 5;
+    unsigned scales = 5;
+    string filter;
+    string outPath;
+    // exit with failure if any scaling exponent exceeds this (0 disables the check)
+    double maxExponent = 0.0;
+};
+
+/**
+ * One prepared trial. Setup happens before the trial is handed out and is not timed.
+ */
+struct Trial {
+    // units of work done by one run (bytes, nodes, ...), used for throughput and scaling
+    size_t work;
+    function<size_t()> run;
+};
+
+struct Benchmark {
+    string name;
+    // size at scale 0; every further scale doubles it
+    size_t baseSize;
+    function<Trial(size_t)> prepare;
+};
+
+struct Stats {
+    double minNs;
+    double medianNs;
+    double meanNs;
+    double stddevNs;
+};
+
+Stats summarize(vector<double> samples) {
+    sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+    double sum = 0.0;
+    for (double s : samples) {
+        sum += s;
+    }
+    double mean = sum / n;
+    double sq = 0.0;
+    for (double s : samples) {
+        sq += (s - mean) * (s - mean);
+    }
+    double median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    return {samples[0], median, mean, n > 1 ? sqrt(sq / (n - 1)) : 0.0};
+}
+
+///////////////////////////////////////////
+// Token scanner shared by the frontend benchmarks
+///////////////////////////////////////////
+enum class TokKind : uint8_t { IDENT, NUMBER, STRING, PUNCT };
+
+struct Token {
+    uint32_t offset;
+    uint32_t len;
+    TokKind kind;
+};
+
+bool isIdentStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+bool isIdentChar(char c) {
+    return isIdentStart(c) || (c >= '0' && c <= '9');
+}
+
+/**
+ * Minimal C tokenizer standing in for the flex lexer until it builds: skips whitespace
+ * and comments, and splits identifiers, numbers, literals and single-character
+ * punctuators. Offsets are relative to base.
+ */
+void scanTokens(const char* base, const char* begin, const char* end,
+                vector<Token>& out) {
+    const char* p = begin;
+    while (p < end) {
+        char c = *p;
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            ++p;
+        } else if (c == '/' && p + 1 < end && p[1] == '/') {
+            while (p < end && *p != '\n') {
+                ++p;
+            }
+        } else if (c == '/' && p + 1 < end && p[1] == '*') {
+            p += 2;
+            while (p + 1 < end && !(p[0] == '*' && p[1] == '/')) {
+                ++p;
+            }
+            p = min(p + 2, end);
+        } else {
+            const char* start = p;
+            TokKind kind;
+            if (isIdentStart(c)) {
+                kind = TokKind::IDENT;
+                while (p < end && isIdentChar(*p)) {
+                    ++p;
+                }
+            } else if (c >= '0' && c <= '9') {
+                kind = TokKind::NUMBER;
+                while (p < end && isIdentChar(*p)) {
+                    ++p;
+                }
+            } else if (c == '"' || c == '\'') {
+                kind = TokKind::STRING;
+                for (++p; p < end && *p != c; ++p) {
+                    if (*p == '\\') {
+                        ++p;
+                    }
+                }
+                p = min(p + 1, end);
+            } else {
+                kind = TokKind::PUNCT;
+                ++p;
+            }
+            out.push_back({static_cast<uint32_t>(start - base),
+                           static_cast<uint32_t>(p - start), kind});
+        }
+    }
+}
+
+///////////////////////////////////////////
+// Frontend phases on generated sources
+///////////////////////////////////////////
+constexpr size_t SPLIT_CHUNK = 64 * 1024;
+
+Trial prescanTrial(Bench::Shape shape, size_t size) {
+    auto src = make_shared<string>(Bench::generate(shape, size));
+    return {src->size(), [src]() {
+                return Frontend::findSplitPoints(src->data(), src->size(), SPLIT_CHUNK)
+                    .size();
+            }};
+}
+
+Trial lexTrial(Bench::Shape shape, size_t size) {
+    auto src = make_shared<string>(Bench::generate(shape, size));
+    return {src->size(), [src]() {
+                vector<Token> tokens;
+                scanTokens(src->data(), src->data(), src->data() + src->size(), tokens);
+                return tokens.size();
+            }};
+}
+
+Trial lexParallelTrial(Bench::Shape shape, size_t size) {
+    auto src = make_shared<string>(Bench::generate(shape, size));
+    return {src->size(), [src]() {
+                const char* data = src->data();
+                auto splits = Frontend::findSplitPoints(data, src->size(), SPLIT_CHUNK);
+                auto lexChunk = [data](const char* begin, const char* end, size_t,
+                                       vector<Token>& out) {
+                    scanTokens(data, begin, end, out);
+                };
+                return Frontend::lexParallel<Token>(data, src->size(), splits, lexChunk)
+                    .size();
+            }};
+}
+
+Trial guardTrial(Bench::Shape shape, size_t size) {
+    auto src = make_shared<string>("#ifndef BENCH_H\n#define BENCH_H\n" +
+                                   Bench::generate(shape, size) + "#endif\n");
+    return {src->size(), [src]() { return Frontend::detectIncludeGuard(*src).size(); }};
+}
+
+Trial internTrial(Bench::Shape shape, size_t size) {
+    auto src = make_shared<string>(Bench::generate(shape, size));
+    auto tokens = make_shared<vector<Token>>();
+    scanTokens(src->data(), src->data(), src->data() + src->size(), *tokens);
+    return {tokens->size(), [src, tokens]() {
+                StringInterner interner;
+                for (const Token& tok : *tokens) {
+                    if (tok.kind == TokKind::IDENT) {
+                        interner.intern(string_view(src->data() + tok.offset, tok.len));
+                    }
+                }
+                return interner.size();
+            }};
+}
+
+/**
+ * Name resolution over the token stream: braces open and close scopes, an identifier
+ * after "int" is declared and any other identifier is looked up.
+ */
+Trial symtabTrial(Bench::Shape shape, size_t size) {
+    string src = Bench::generate(shape, size);
+    vector<Token> tokens;
+    scanTokens(src.data(), src.data(), src.data() + src.size(), tokens);
+
+    // intern up front so only the table itself is measured
+    enum Op : uint32_t { PUSH = UINT32_MAX - 2, POP, DECLARE };
+    auto ops = make_shared<vector<uint32_t>>();
+    StringInterner interner;
+    StringInterner::Id intKw = interner.intern("int");
+    bool declare = false;
+    for (const Token& tok : tokens) {
+        if (tok.kind == TokKind::PUNCT && src[tok.offset] == '{') {
+            ops->push_back(PUSH);
+        } else if (tok.kind == TokKind::PUNCT && src[tok.offset] == '}') {
+            ops->push_back(POP);
+        } else if (tok.kind == TokKind::IDENT) {
+            string_view name(&src[tok.offset], tok.len);
+            StringInterner::Id id = interner.intern(name);
+            if (id == intKw) {
+                declare = true;
+                continue;
+            }
+            if (declare) {
+                ops->push_back(DECLARE);
+            }
+            ops->push_back(id);
+        }
+        declare = false;
+    }
+    return {ops->size(), [ops]() {
+                Frontend::SymbolTable<uint32_t> table;
+                size_t found = 0;
+                for (size_t i = 0; i < ops->size(); ++i) {
+                    uint32_t op = (*ops)[i];
+                    if (op == PUSH) {
+                        table.pushScope();
+                    } else if (op == POP) {
+                        table.popScope();
+                    } else if (op == DECLARE) {
+                        ++i;
+                        table.insert((*ops)[i], static_cast<uint32_t>(i));
+                    } else {
+                        found += table.lookup(op) != nullptr;
+                    }
+                }
+                return found;
+            }};
+}
+
+///////////////////////////////////////////
+// fds containers and graph algorithms
+///////////////////////////////////////////
+
+/**
+ * Dataflow-style sweep: a set of live-in bitsets, each repeatedly unioned with its
+ * neighbours and masked, as a liveness solver would.
+ */
+Trial bitsetTrial(size_t bits) {
+    constexpr size_t SETS = 32;
+    auto sets = make_shared<vector<Bitset>>();
+    mt19937_64 rng(bits);
+    for (size_t i = 0; i < SETS; ++i) {
+        Bitset set(bits);
+        for (size_t j = 0; j < bits / 8; ++j) {
+            set.set(rng() % bits);
+        }
+        sets->push_back(move(set));
+    }
+    return {bits * SETS, [sets]() {
+                size_t full = 0;
+                for (size_t i = 0; i < SETS; ++i) {
+                    Bitset acc = (*sets)[i] | (*sets)[(i + 1) % SETS];
+                    acc &= ~(*sets)[(i + 7) % SETS];
+                    acc ^= (*sets)[(i + 3) % SETS];
+                    full += acc == (*sets)[i];
+                    full += acc.all();
+                }
+                return full;
+            }};
+}
+
+/**
+ * Random call graph with roughly four call sites per function and a long backbone so the
+ * SCC walk has to go deep.
+ */
+IR::CallGraph makeCallGraph(size_t funcs) {
+    IR::CallGraph cg;
+    mt19937_64 rng(funcs);
+    for (size_t i = 0; i < funcs; ++i) {
+        cg.addFunction("f" + to_string(i), 10 + rng() % 100);
+    }
+    for (size_t i = 0; i + 1 < funcs; ++i) {
+        cg.addCall(i, i + 1);
+    }
+    for (size_t i = 0; i < 3 * funcs; ++i) {
+        cg.addCall(rng() % funcs, rng() % funcs);
+    }
+    return cg;
+}
+
+Trial graphBuildTrial(size_t nodes) {
+    return {nodes, [nodes]() {
+                DenseGraph<uint32_t, uint32_t> graph;
+                for (size_t i = 0; i < nodes; ++i) {
+                    graph.addNode(static_cast<uint32_t>(i));
+                }
+                size_t x = 1;
+                for (size_t i = 0; i < 4 * nodes; ++i) {
+                    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+                    graph.addEdge(i % nodes, (x >> 33) % nodes, static_cast<uint32_t>(i));
+                }
+                return graph.numEdges();
+            }};
+}
+
+Trial sccTrial(size_t funcs) {
+    auto cg = make_shared<IR::CallGraph>(makeCallGraph(funcs));
+    return {funcs, [cg]() { return cg->bottomUpSCCs().size(); }};
+}
+
+///////////////////////////////////////////
+// IR and code generation
+///////////////////////////////////////////
+
+/**
+ * Control graph shaped like a lowered wide if-chain, with a back edge every few blocks.
+ */
+IR::ControlGraph makeControlGraph(size_t diamonds) {
+    IR::ControlGraph cfg;
+    mt19937_64 rng(diamonds);
+    IR::ControlGraph::BlockId prev = cfg.addBlock("entry");
+    for (size_t i = 0; i < diamonds; ++i) {
+        auto then = cfg.addBlock("then");
+        auto other = cfg.addBlock("else");
+        auto join = cfg.addBlock("join");
+        double p = static_cast<double>(rng() % 100) / 100.0;
+        cfg.addEdge(prev, then, p);
+        cfg.addEdge(prev, other, 1.0 - p);
+        cfg.addEdge(then, join, 1.0);
+        cfg.addEdge(other, join, 1.0);
+        if (i % 8 == 7) {
+            auto latch = cfg.addBlock("latch");
+            cfg.addEdge(join, latch, 1.0);
+            cfg.addEdge(latch, join - 9, 0.9);
+            join = latch;
+        }
+        prev = join;
+    }
+    cfg.addEdge(prev, cfg.addBlock("exit"), 1.0);
+    return cfg;
+}
+
+Trial layoutTrial(size_t diamonds) {
+    auto cfg = make_shared<IR::ControlGraph>(makeControlGraph(diamonds));
+    return {cfg->getGraph().numNodes(),
+            [cfg]() { return Codegen::layoutBlocks(*cfg).order.size(); }};
+}
+
+Trial profilePlanTrial(size_t diamonds) {
+    auto cfg = make_shared<IR::ControlGraph>(makeControlGraph(diamonds));
+    return {cfg->getGraph().numEdges(),
+            [cfg]() { return IR::planEdgeCounters(*cfg).counted.size(); }};
+}
+
+/**
+ * Interpreter dispatch: a counted loop of six bytecode instructions per iteration.
+ */
+Trial interpTrial(size_t iters) {
+    IR::BcBuilder b("loop", 1);
+    auto n = b.param(0);
+    auto acc = b.newReg();
+    auto i = b.newReg();
+    auto tmp = b.newReg();
+    auto loop = b.newLabel();
+    auto done = b.newLabel();
+    b.movImm(acc, 0);
+    b.movImm(i, 0);
+    b.bind(loop);
+    b.binary(IR::BcOp::LT, tmp, i, n);
+    b.jz(tmp, done);
+    b.binary(IR::BcOp::MUL, tmp, i, i);
+    b.binary(IR::BcOp::XOR, acc, acc, tmp);
+    b.addImm(i, i, 1);
+    b.jmp(loop);
+    b.bind(done);
+    b.ret(acc);
+    vector<IR::BcFunction> program;
+    program.push_back(b.finish());
+    auto interp =
+        make_shared<IR::Interpreter>(move(IR::Interpreter::create(program).value()));
+    return {iters * 6, [interp, iters]() {
+                auto res = interp->run(0, {static_cast<int64_t>(iters)});
+                return res ? static_cast<size_t>(res.value()) : 0;
+            }};
+}
+
+/**
+ * Object and listing emission for a TU of small functions: parallel encoding, then both
+ * outputs stitched from the per-function buffers and written to /dev/null.
+ */
+Trial emitTrial(size_t funcs) {
+    return {funcs, [funcs]() {
+                using namespace Codegen;
+                ElfWriter writer;
+                vector<ElfWriter::SymbolId> syms;
+                for (size_t i = 0; i < funcs; ++i) {
+                    syms.push_back(writer.addSymbol("func" + to_string(i)));
+                }
+                auto code = encodeParallel(
+                    funcs,
+                    [&](size_t idx, X86Encoder& enc) {
+                        auto loop = enc.newLabel();
+                        enc.movImm(Reg::RAX, 0);
+                        enc.bind(loop);
+                        enc.alu(AluOp::ADD, Reg::RAX, Reg::RDI);
+                        enc.aluImm(AluOp::SUB, Reg::RDI, 1);
+                        enc.jcc(Cond::NE, loop);
+                        enc.callSym(syms[(idx + 1) % funcs]);
+                        enc.ret();
+                    },
+                    true, writer.symbolNames());
+                for (size_t i = 0; i < funcs; ++i) {
+                    writer.addFunction(syms[i], move(code[i]));
+                }
+                Rope out = writer.object();
+                out.splice(writer.listing());
+                string error;
+                return out.writeFile("/dev/null", error) ? out.size() : 0;
+            }};
+}
+
+///////////////////////////////////////////
+// Command line parsing
+///////////////////////////////////////////
+
+/**
+ * Command line of a build-system generated compile: mostly -I and -D flags, with the
+ * occasional long option. Parser construction is timed too, as every invocation pays it.
+ */
+Trial argparseTrial(size_t flags) {
+    auto storage = make_shared<vector<string>>();
+    storage->push_back("ecc");
+    for (size_t i = 0; i < flags; ++i) {
+        switch (i % 4) {
+            case 0:
+            case 1:
+                storage->push_back("-I/usr/src/project/mod" + to_string(i) + "/include");
+                break;
+            case 2:
+                storage->push_back("-DCONFIG_OPTION_" + to_string(i) + "=1");
+                break;
+            default:
+                storage->push_back("--include");
+                storage->push_back("gen/dir" + to_string(i));
+                break;
+        }
+    }
+    storage->push_back("main.c");
+    return {flags, [storage]() {
+                vector<char*> argv;
+                for (string& arg : *storage) {
+                    argv.push_back(&arg[0]);
+                }
+                ArgParse::ArgumentParser parser;
+                parser.addArgument("-I", "--include")
+                    .nargs(1)
+                    .action<ArgParse::AppendAction>();
+                parser.addArgument("-D").nargs(1).action<ArgParse::AppendAction>();
+                parser.addArgument("file").nargs(1);
+                auto args = parser.parseArgs(static_cast<int>(argv.size()), argv.data());
+                return args ? args->get<vector<string>>("include").val.size() : 0;
+            }};
+}
+
+///////////////////////////////////////////
+// Registry
+///////////////////////////////////////////
+vector<Benchmark> allBenchmarks() {
+    using Bench::Shape;
+    const Shape shapes[] = {Shape::MANY_FUNCS, Shape::GIANT_FUNC, Shape::DEEP_NESTING,
+                            Shape::WIDE_IF_CHAIN, Shape::MANY_IDENTS};
+    struct Phase {
+        const char* name;
+        Trial (*prepare)(Shape, size_t);
+    };
+    const Phase phases[] = {
+        {"prescan", prescanTrial},
+        {"lex", lexTrial},
+        {"lex_parallel", lexParallelTrial},
+        {"guard", guardTrial},
+        {"intern", internTrial},
+        {"symtab", symtabTrial},
+    };
+
+    vector<Benchmark> benches;
+    for (const Phase& phase : phases) {
+        for (Shape shape : shapes) {
+            auto prepare = phase.prepare;
+            benches.push_back({string(phase.name) + "/" + Bench::shapeName(shape), 1000,
+                               [prepare, shape](size_t n) { return prepare(shape, n); }});
+        }
+    }
+    benches.push_back({"fds/bitset", 1 << 14, bitsetTrial});
+    benches.push_back({"fds/densegraph_build", 1 << 14, graphBuildTrial});
+    benches.push_back({"ir/call_graph_scc", 1 << 14, sccTrial});
+    benches.push_back({"ir/profile_plan", 1 << 10, profilePlanTrial});
+    benches.push_back({"ir/interp", 1 << 16, interpTrial});
+    benches.push_back({"codegen/block_layout", 1 << 10, layoutTrial});
+    benches.push_back({"codegen/emit", 1 << 10, emitTrial});
+    benches.push_back({"cli/argparse", 1 << 10, argparseTrial});
+    return benches;
+}
+
+///////////////////////////////////////////
+// Driver
+///////////////////////////////////////////
+void writeJson(ostream& out, const string& name, size_t size, const Trial& trial,
+               unsigned trials, const Stats& stats) {
+    out << fixed << setprecision(1) << "{\"bench\":\"" << name << "\",\"size\":" << size
+        << ",\"work\":" << trial.work << ",\"trials\":" << trials
+        << ",\"min_ns\":" << stats.minNs << ",\"median_ns\":" << stats.medianNs
+        << ",\"mean_ns\":" << stats.meanNs << ",\"stddev_ns\":" << stats.stddevNs
+        << setprecision(3) << ",\"ns_per_unit\":"
+        << (trial.work ? stats.medianNs / trial.work : 0.0) << "}\n";
+    out.unsetf(ios::floatfield);
+}
+
+/**
+ * Run one benchmark at every scale.
+ *
+ * @return the largest scaling exponent seen.
+ */
+double runBenchmark(const Benchmark& bench, const Options& opts, ostream& json) {
+    double worst = 0.0;
+    double prevNs = 0.0;
+    size_t prevWork = 0;
+    cerr << bench.name << "\n";
+    for (unsigned scale = 0; scale < opts.scales; ++scale) {
+        size_t size = bench.baseSize << scale;
+        Trial trial = bench.prepare(size);
+        sink = sink + trial.run();
+
+        vector<double> samples;
+        for (unsigned i = 0; i < opts.trials; ++i) {
+            Clock::time_point start = Clock::now();
+            sink = sink + trial.run();
+            chrono::duration<double, nano> elapsed = Clock::now() - start;
+            samples.push_back(elapsed.count());
+        }
+        Stats stats = summarize(samples);
+        writeJson(json, bench.name, size, trial, opts.trials, stats);
+
+        cerr << "  size " << setw(9) << size << "  median " << fixed << setprecision(3)
+             << setw(10) << stats.medianNs / 1e6 << " ms  +/- " << setw(8)
+             << stats.stddevNs / 1e6 << " ms";
+        // below ~50us timer noise swamps the ratio, so don't report an exponent
+        if (prevWork && trial.work > prevWork && prevNs > 50e3) {
+            double exponent = log(stats.medianNs / prevNs) /
+                              log(static_cast<double>(trial.work) / prevWork);
+            worst = max(worst, exponent);
+            cerr << "  exp " << setprecision(2) << exponent;
+            if (exponent > 1.3) {
+                cerr << "  !!";
+            }
+        }
+        cerr << "\n";
+        cerr.unsetf(ios::floatfield);
+        prevNs = stats.medianNs;
+        prevWork = trial.work;
+    }
+    return worst;
+}
+
+void usage(const char* prog) {
+    cerr << "usage: " << prog << " [options]\n"
+         << "  --trials N         timed trials per size (default 5)\n"
+         << "  --scales N         number of doubling sizes per benchmark (default 5)\n"
+         << "  --filter STR       only run benchmarks whose name contains STR\n"
+         << "  --out FILE         write JSON lines to FILE instead of stdout\n"
+         << "  --max-exponent X   fail if any scaling exponent exceeds X\n"
+         << "  --list             list benchmark names and exit\n"
+         << "  --gen SHAPE SIZE   print a generated source file and exit\n";
+}
+
+bool parseUnsigned(const char* str, unsigned& val) {
+    char* end;
+    unsigned long parsed = strtoul(str, &end, 10);
+    val = static_cast<unsigned>(parsed);
+    return *str && !*end && parsed > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opts;
+    vector<Benchmark> benches = allBenchmarks();
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool hasVal = i + 1 < argc;
+        if (arg == "--trials" && hasVal && parseUnsigned(argv[i + 1], opts.trials)) {
+            ++i;
+        } else if (arg == "--scales" && hasVal &&
+                   parseUnsigned(argv[i + 1], opts.scales)) {
+            ++i;
+        } else if (arg == "--filter" && hasVal) {
+            opts.filter = argv[++i];
+        } else if (arg == "--out" && hasVal) {
+            opts.outPath = argv[++i];
+        } else if (arg == "--max-exponent" && hasVal) {
+            opts.maxExponent = atof(argv[++i]);
+        } else if (arg == "--list") {
+            for (const Benchmark& bench : benches) {
+                cout << bench.name << "\n";
+            }
+            return EXIT_SUCCESS;
+        } else if (arg == "--gen" && i + 2 < argc) {
+            for (auto shape : {Bench::Shape::MANY_FUNCS, Bench::Shape::GIANT_FUNC,
+                               Bench::Shape::DEEP_NESTING, Bench::Shape::WIDE_IF_CHAIN,
+                               Bench::Shape::MANY_IDENTS}) {
+                if (strcmp(argv[i + 1], Bench::shapeName(shape)) == 0) {
+                    cout << Bench::generate(shape, strtoul(argv[i + 2], nullptr, 10));
+                    return EXIT_SUCCESS;
+                }
+            }
+            cerr << "unknown shape '" << argv[i + 1] << "'\n";
+            return EXIT_FAILURE;
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    ofstream file;
+    if (!opts.outPath.empty()) {
+        file.open(opts.outPath);
+        if (!file) {
+            cerr << "cannot open '" << opts.outPath << "'\n";
+            return EXIT_FAILURE;
+        }
+    }
+    ostream& json = opts.outPath.empty() ? cout : file;
+
+    double worst = 0.0;
+    string worstName;
+    for (const Benchmark& bench : benches) {
+        if (bench.name.find(opts.filter) == string::npos) {
+            continue;
+        }
+        double exponent = runBenchmark(bench, opts, json);
+        if (exponent > worst) {
+            worst = exponent;
+            worstName = bench.name;
+        }
+    }
+    if (!worstName.empty()) {
+        cerr << "worst scaling exponent " << fixed << setprecision(2) << worst << " ("
+             << worstName << ")\n";
+    }
+    if (opts.maxExponent > 0.0 && worst > opts.maxExponent) {
+        cerr << "scaling exponent exceeds " << opts.maxExponent << "\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+#include "cgen.h"
+
+using namespace std;
+
+namespace Bench {
+
+const char* shapeName(Shape shape) {
+    switch (shape) {
+        case Shape::MANY_FUNCS:
+            return "many_funcs";
+        case Shape::GIANT_FUNC:
+            return "giant_func";
+        case Shape::DEEP_NESTING:
+            return "deep_nesting";
+        case Shape::WIDE_IF_CHAIN:
+            return "wide_if_chain";
+        case Shape::MANY_IDENTS:
+            return "many_idents";
+    }
+    return "unknown";
+}
+
+static void manyFuncs(string& out, size_t size) {
+    out += "int f_0(int a, int b) { return a + b; }\n";
+    for (size_t i = 1; i < size; ++i) {
+        string n = to_string(i);
+        out += "/* helper " + n + " */\n";
+        out += "int f_" + n + "(int a, int b) {\n";
+        out += "    int x = a * " + n + " + b;\n";
+        out += "    if (x > " + n + ") {\n";
+        out += "        x = x - f_" + to_string(i - 1) + "(a, b);\n";
+        out += "    }\n";
+        out += "    return x;\n";
+        out += "}\n";
+    }
+}
+
+static void giantFunc(string& out, size_t size) {
+    out += "int giant(int a, int b) {\n";
+    out += "    int acc = 0;\n";
+    for (size_t i = 0; i < size; ++i) {
+        string n = to_string(i);
+        out += "    int t_" + n + " = a * " + n + " + b; // step " + n + "\n";
+        out += "    acc = acc + t_" + n + ";\n";
+    }
+    out += "    return acc;\n";
+    out += "}\n";
+}
+
+static void deepNesting(string& out, size_t size) {
+    out += "int nested(int a) {\n";
+    out += "    int v = a;\n";
+    for (size_t i = 0; i < size; ++i) {
+        out += string(4 + (i % 64) * 2, ' ') + "{ int v = a + " + to_string(i) + ";\n";
+    }
+    for (size_t i = size; i-- > 0;) {
+        out += string(4 + (i % 64) * 2, ' ') + "a = v; }\n";
+    }
+    out += "    return v;\n";
+    out += "}\n";
+}
+
+static void wideIfChain(string& out, size_t size) {
+    out += "int dispatch(int op, int a, int b) {\n";
+    out += "    int r = 0;\n";
+    for (size_t i = 0; i < size; ++i) {
+        string n = to_string(i);
+        out += i == 0 ? "    if" : "    else if";
+        out += " (op == " + n + ") {\n";
+        out += "        r = a * " + n + " - b;\n";
+        out += "    }\n";
+    }
+    out += "    else {\n";
+    out += "        r = -1;\n";
+    out += "    }\n";
+    out += "    return r;\n";
+    out += "}\n";
+}
+
+static void manyIdents(string& out, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        out += "int global_identifier_number_" + to_string(i) + ";\n";
+    }
+    out += "int sum(void) {\n";
+    out += "    int s = 0;\n";
+    for (size_t i = 0; i < size; ++i) {
+        out += "    s = s + global_identifier_number_" + to_string(i) + ";\n";
+    }
+    out += "    return s;\n";
+    out += "}\n";
+}
+
+string generate(Shape shape, size_t size) {
+    string out = "/* generated by ecc-bench: ";
+    out += shapeName(shape);
+    out += " x" + to_string(size) + " */\n";
+    switch (shape) {
+        case Shape::MANY_FUNCS:
+            manyFuncs(out, size);
+            break;
+        case Shape::GIANT_FUNC:
+            giantFunc(out, size);
+            break;
+        case Shape::DEEP_NESTING:
+            deepNesting(out, size);
+            break;
+        case Shape::WIDE_IF_CHAIN:
+            wideIfChain(out, size);
+            break;
+        case Shape::MANY_IDENTS:
+            manyIdents(out, size);
+            break;
+    }
+    return out;
+}
+
+} // namespace Bench
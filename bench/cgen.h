@@ -0,0 +1,42 @@
+/**
+ * Synthetic C source generator for the benchmark harness.
+ *
+ * Each shape stresses a different part of the compiler as the size parameter grows, so
+ * that scaling curves expose super-linear behaviour.
+ */
+#ifndef CGEN_H
+#define CGEN_H
+
+#include <cstddef>
+#include <string>
+
+namespace Bench {
+
+enum class Shape
+{
+    // many small functions, each calling the previous one
+    MANY_FUNCS,
+    // a single function with a very long straight-line body
+    GIANT_FUNC,
+    // deeply nested blocks, each declaring a shadowing local
+    DEEP_NESTING,
+    // one long if/else-if chain, the way switch statements often get generated
+    WIDE_IF_CHAIN,
+    // a huge number of distinct global identifiers
+    MANY_IDENTS,
+};
+
+const char* shapeName(Shape shape);
+
+/**
+ * Generate a translation unit.
+ *
+ * @param shape shape of the generated code.
+ * @param size size parameter; the output grows linearly in it.
+ * @return the generated source.
+ */
+std::string generate(Shape shape, std::size_t size);
+
+} // namespace Bench
+
+#endif // CGEN_H
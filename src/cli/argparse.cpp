@@ -1,32 +1,173 @@
 #include "argparse.h"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
 
+#include "debug_macros.h"
+#include "fds/isvector.h"
+#include "util/error.h"
+
 using namespace std;
 
 namespace ArgParse {
 
-#define UNUSED(x) ((void)(x))
-
 #define POSARG_GROUP_IDX 0
 #define OPTARG_GROUP_IDX 1
+// bounds @file recursion, which would otherwise never end for a file including itself
+#define MAX_RESPONSE_DEPTH 32
+// bounds reading a response file that never ends, such as @/dev/zero
+#define MAX_RESPONSE_SIZE (size_t{64} << 20)
+
+namespace {
+
+/**
+ * Split a response file in place into null terminated arguments, removing quotes and
+ * escapes.
+ */
+void splitResponseFile(char* data, vector<const char*>& out) {
+    char* read = data;
+    char* write = data;
+    while (*read) {
+        while (*read && isspace(static_cast<unsigned char>(*read))) {
+            ++read;
+        }
+        if (!*read) {
+            break;
+        }
+        out.push_back(write);
+        char quote = '\0';
+        for (; *read; ++read) {
+            if (*read == '\\' && read[1]) {
+                *write++ = *++read;
+            } else if (quote) {
+                if (*read == quote) {
+                    quote = '\0';
+                } else {
+                    *write++ = *read;
+                }
+            } else if (*read == '\'' || *read == '"') {
+                quote = *read;
+            } else if (isspace(static_cast<unsigned char>(*read))) {
+                ++read;
+                break;
+            } else {
+                *write++ = *read;
+            }
+        }
+        // the terminator may overwrite the separator just consumed, never unread input
+        *write++ = '\0';
+    }
+}
+
+/**
+ * Read a response file to its end, so pipes such as @<(cmd) work as well as regular
+ * files.
+ *
+ * @return the null terminated contents, null if the file can't be opened (the argument
+ * is then kept as is), or an error if it is a directory, too large or fails to read.
+ */
+Util::Expected<unique_ptr<char[]>> readResponseFile(const char* path) {
+    auto fail = [path](const string& why) {
+        return Util::Unexpected(
+            Util::Error(string("Unable to read response file '") + path + "': " + why));
+    };
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return unique_ptr<char[]>();
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        string why = strerror(errno);
+        close(fd);
+        return fail(why + ".");
+    }
+    if (S_ISDIR(info.st_mode)) {
+        close(fd);
+        return fail("is a directory.");
+    }
+    bool regular = S_ISREG(info.st_mode);
+    if (regular && static_cast<uint64_t>(info.st_size) > MAX_RESPONSE_SIZE) {
+        close(fd);
+        return fail("file too large.");
+    }
+    // room for the terminator and one byte more, so that reading a regular file whose
+    // size is unchanged hits EOF without growing the buffer
+    size_t cap = regular ? static_cast<size_t>(info.st_size) + 2 : 4096;
+    size_t size = 0;
+    // no make_unique, which would zero the buffer only to have it overwritten
+    unique_ptr<char[]> data(new char[cap]);
+    while (true) {
+        if (size + 1 == cap) {
+            if (cap > MAX_RESPONSE_SIZE) {
+                close(fd);
+                return fail("file too large.");
+            }
+            unique_ptr<char[]> grown(new char[cap * 2]);
+            memcpy(grown.get(), data.get(), size);
+            data = move(grown);
+            cap *= 2;
+        }
+        ssize_t n = read(fd, data.get() + size, cap - size - 1);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            string why = strerror(errno);
+            close(fd);
+            return fail(why + ".");
+        }
+        if (n == 0) {
+            break;
+        }
+        size += static_cast<size_t>(n);
+    }
+    close(fd);
+    data[size] = '\0';
+    return data;
+}
+
+template <typename L, typename T> void pushToList(Value& list, T&& val) {
+    if (!holds_alternative<L>(list)) {
+        list = L();
+    }
+    get<L>(list).push_back(forward<T>(val));
+}
+
+} // namespace
 
 //////////////////////////////////////////////
 // ArgumentParser Implementations
 //////////////////////////////////////////////
-ArgumentParser::ArgumentParser() : termW{90}, progSet{false}, helpEn{true} {
+ArgumentParser::ArgumentParser()
+    : pfxChars{"-"},
+      termW{90},
+      progSet{false},
+      helpEn{true},
+      helpShown{false},
+      helpAdded{false},
+      compiled{false} {
     ArgGroup posargGroup(this, 0, "Positional Arguments", "", false);
     ArgGroup optargGroup(this, 1, "Options", "", false);
     groups.emplace_back(std::move(posargGroup));
     groups.emplace_back(std::move(optargGroup));
 }
 
-Args ArgumentParser::parseArgs(int argc, char** argv) {
+void ArgumentParser::compile() {
+    if (compiled) {
+        return;
+    }
     // add --help option if - is in the list of prefix characters or if no prefix
     // characters are set and the defualt help is enabled
-    if (helpEn) {
+    if (helpEn && !helpAdded) {
+        helpAdded = true;
         string::size_type found = pfxChars.find('-');
         if (!pfxChars.empty() && found != string::npos) {
             addArgument("-h", "--help")
@@ -40,98 +181,232 @@ Args ArgumentParser::parseArgs(int argc, char** argv) {
         }
     }
 
+    // actions sharing a destination share its slot
+    dests = make_shared<vector<pair<string, ArgId>>>();
+    for (const Action::UPtr& action : actions) {
+        dests->emplace_back(action->dest, 0);
+    }
+    sort(dests->begin(), dests->end());
+    dests->erase(unique(dests->begin(), dests->end()), dests->end());
+    for (size_t i = 0; i < dests->size(); ++i) {
+        (*dests)[i].second = static_cast<ArgId>(i);
+    }
+    for (const Action::UPtr& action : actions) {
+        auto it = lower_bound(dests->begin(), dests->end(), make_pair(action->dest, 0u));
+        action->slot = it->second;
+    }
+
+    shortOpts.assign(pfxChars.size(), {});
+    longOpts.clear();
+    for (const auto& opt : optArgs) {
+        const string& flag = opt.first;
+        string::size_type pfx = pfxChars.find(flag[0]);
+        if (pfx == string::npos) {
+            // added before prefixChars() dropped its prefix; it can never match
+            continue;
+        }
+        if (flag.size() == 2 && flag[1] != flag[0]) {
+            shortOpts[pfx][static_cast<unsigned char>(flag[1])] = opt.second;
+        } else {
+            longOpts.emplace_back(flag, opt.second);
+        }
+    }
+    sort(longOpts.begin(), longOpts.end());
+    compiled = true;
+}
+
+Action* ArgumentParser::findLong(std::string_view name) const {
+    auto it = lower_bound(longOpts.begin(), longOpts.end(), name,
+                          [](const pair<string, Action*>& opt, std::string_view key) {
+                              return opt.first < key;
+                          });
+    if (it == longOpts.end() || it->first != name) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+Util::Expected<void> ArgumentParser::expandResponseFiles(
+    std::vector<const char*>& args, std::vector<std::unique_ptr<char[]>>& buffers) {
+    // expansions are appended in place of their @file, so each argument is visited once
+    // and the depth of an argument is that of the file it came from
+    vector<const char*> out;
+    vector<pair<const char*, int>> work;
+    work.reserve(args.size());
+    for (auto it = args.rbegin(); it != args.rend(); ++it) {
+        work.emplace_back(*it, 0);
+    }
+    out.reserve(args.size());
+    vector<const char*> fileArgs;
+    while (!work.empty()) {
+        auto [arg, depth] = work.back();
+        work.pop_back();
+        if (arg[0] != '@') {
+            out.push_back(arg);
+            continue;
+        }
+        Util::Expected<unique_ptr<char[]>> read = readResponseFile(arg + 1);
+        if (!read) {
+            return Util::Unexpected(move(read).error());
+        }
+        unique_ptr<char[]> data = move(read).value();
+        if (!data) {
+            out.push_back(arg);
+            continue;
+        }
+        if (depth == MAX_RESPONSE_DEPTH) {
+            return Util::Unexpected(Util::Error(
+                string("Response files nested too deeply at '") + arg + "'."));
+        }
+        fileArgs.clear();
+        splitResponseFile(data.get(), fileArgs);
+        buffers.push_back(move(data));
+        for (auto it = fileArgs.rbegin(); it != fileArgs.rend(); ++it) {
+            work.emplace_back(*it, depth + 1);
+        }
+    }
+    args = move(out);
+    return {};
+}
+
+Util::Expected<Args> ArgumentParser::parseArgs(int argc, char** argv) {
+    compile();
+
+    auto fail = [](string msg) { return Util::Unexpected(Util::Error(move(msg))); };
+    vector<const char*> argList(argv + min(argc, 1), argv + argc);
+    vector<unique_ptr<char[]>> buffers;
+    Util::Expected<void> expanded = expandResponseFiles(argList, buffers);
+    if (!expanded) {
+        return Util::Unexpected(move(expanded).error());
+    }
+
     Args arguments;
+    arguments.dests = dests;
+    arguments.slots.resize(dests->size());
     // insert default argument values
     for (const Action::UPtr& action : actions) {
-        if (action->defaultval.has_value()) {
-            arguments.args[action->dest] = action->defaultval;
+        Value& val = arguments.slots[action->slot].val;
+        if (holds_alternative<monostate>(val)) {
+            val = action->defaultval;
         }
     }
 
-    int cArg = 1;
+    size_t cArg = 0;
     size_t cPosArg = 0;
+    bool optsDone = false;
+    helpShown = false;
+    // reused for every argument, so values only allocate for long strings
+    SmallVector<Value, 4> values;
+    string optStr;
+    string err;
     // parse arguments
-    while (true) {
-        string argStr = argv[cArg];
+    while (cArg < argList.size()) {
+        const char* arg = argList[cArg++];
+        std::string_view argStr = arg;
         Action* action = nullptr;
-        OptKind optKind = getOptKind(argStr);
-
-        vector<any> values;
-        string err;
-        if (optKind == OptKind::SHORT) {
-            for (size_t i = 0; i < argStr.length() - 1; ++i) {
-                auto it = optArgs.find(argStr.substr(i + 1, 1));
-                if (it == optArgs.end()) {
-                    // error: invalid short opt
-                    cerr << "Argument Parsing Error: Invalid optional argument '"
-                         << argStr << "'." << endl;
-                }
-                action = it->second;
-                if (action->nargs != 0) {
-                    // handle error as multiple short args must all take 0 args except for
-                    // the last one
-                    cerr << "Argument Parsing Error: optional argument '" << argStr[i]
-                         << "' takes one or more parameters but zero given." << endl;
-                }
-                action->process(*this, arguments, {}, argStr.substr(i, 1), err);
+        // the first parameter, if it is part of the argument itself
+        const char* attached = nullptr;
+        values.clear();
+
+        OptKind optKind = optsDone ? OptKind::POS : getOptKind(argStr);
+        if (optKind == OptKind::LONG && argStr.size() == 2) {
+            // "--" alone: everything after it is positional
+            optsDone = true;
+            continue;
+        }
+        if (optKind == OptKind::POS) {
+            if (cPosArg >= posArgs.size()) {
+                return fail("Too many positional arguments specified.");
             }
-        } else if (optKind == OptKind::LONG) {
+            action = posArgs[cPosArg++];
+            attached = arg;
+            optStr = action->dest;
+        } else {
             size_t pos = argStr.find('=');
-            if (pos != string::npos) {
-                argStr = argStr.substr(0, pos); // trim
-            }
-            auto it = optArgs.find(argStr);
-            if (it == optArgs.end()) {
-                // error: invalid long opt
-                cerr << "Argument Parsing Error: Invalid optional argument '" << argStr
-                     << "'." << endl;
-                return {};
+            if (pos != std::string_view::npos) {
+                action = findLong(argStr.substr(0, pos));
             }
-            action = it->second;
-            if (pos != string::npos) {
+            if (action) {
                 if (action->nargs != 1) {
-                    // error, must take exactly one arg
-                    cerr << "Argument Parsing Error: Assignment expression used for "
-                            "argument '"
-                         << argStr << "' that takes " << action->nargs << " parameters."
-                         << endl;
+                    return fail("Assignment expression used for argument '" +
+                                string(argStr.substr(0, pos)) + "' that takes " +
+                                to_string(action->nargs) + " parameters.");
                 }
-                values.emplace_back(convertType(
-                    argStr.substr(pos + 1, argStr.size() - pos - 1), action->type));
-            }
-        } else if (optKind == OptKind::POS) {
-            if (cPosArg >= posArgs.size()) {
-                // throw error
-                cerr << "Argument Parsing Error: Too many positional arguments specified."
-                     << endl;
+                attached = arg + pos + 1;
+                optStr.assign(argStr.substr(0, pos));
+            } else if ((action = findLong(argStr))) {
+                optStr.assign(argStr);
+            } else if (optKind == OptKind::SHORT) {
+                // a cluster of single character flags. All but the last must take no
+                // parameters, and the rest of the argument after one that does is its
+                // first parameter.
+                const auto& table = shortOpts[pfxChars.find(argStr[0])];
+                for (size_t i = 1; i < argStr.size(); ++i) {
+                    action = table[static_cast<unsigned char>(argStr[i])];
+                    optStr.assign({argStr[0], argStr[i]});
+                    if (!action) {
+                        return fail("Invalid optional argument '" + optStr + "'.");
+                    }
+                    if (action->nargs != 0) {
+                        if (i + 1 < argStr.size()) {
+                            attached = arg + i + 1;
+                        }
+                        break;
+                    }
+                    if (!action->process(*this, arguments, {}, optStr, err)) {
+                        return fail(err);
+                    }
+                    if (helpShown) {
+                        return arguments;
+                    }
+                    action = nullptr;
+                }
+                if (!action) {
+                    continue;
+                }
+            } else {
+                return fail("Invalid optional argument '" + string(argStr) + "'.");
             }
-            action = posArgs[cPosArg++];
-        } else {
-            // throw error
-            cerr << "Internal error: invalid argument kind." << endl;
-            return {};
         }
 
-        for (long i = 0; i < action->nargs; ++i) {
-            if (cArg > argc) {
-                cerr << "Argument Parsing Error: Not enough arguments provided for "
-                        "argument '"
-                     << action->dest << "'." << endl;
+        long nargs = action->nargs;
+        if (optKind == OptKind::POS && nargs == 0) {
+            // a positional argument always consumes itself
+            nargs = 1;
+        }
+        for (long i = 0; i < nargs; ++i) {
+            const char* param = attached;
+            attached = nullptr;
+            if (!param) {
+                if (cArg >= argList.size()) {
+                    return fail("Not enough arguments provided for argument '" + optStr +
+                                "'.");
+                }
+                param = argList[cArg++];
+            }
+            Util::Expected<Value> val = convertType(param, action->type);
+            if (!val) {
+                return fail("Argument '" + optStr + "': " + val.error().message());
             }
-            values.emplace_back(convertType(argv[cArg++], action->type));
+            if (!action->choices.empty() &&
+                find(action->choices.begin(), action->choices.end(), *val) ==
+                    action->choices.end()) {
+                return fail("Argument '" + optStr + "': invalid choice '" + param + "'.");
+            }
+            values.push_back(move(*val));
         }
-        action->process(*this, arguments, values, argStr, err);
-        if (cArg == argc) {
-            break;
+        if (!action->process(*this, arguments, values, optStr, err)) {
+            return fail(err);
+        }
+        if (helpShown) {
+            return arguments;
         }
     }
 
     // check all required args
     for (const Action::UPtr& action : actions) {
-        if (action->required && !action->present) {
-            // throw error
-            cerr << "Argument Parsing Error: Required argument " << action->dest
-                 << "not present." << endl;
+        if (action->required && !arguments.slots[action->slot].present) {
+            return fail("Required argument '" + action->dest + "' not present.");
         }
     }
 
@@ -141,7 +416,8 @@ Args ArgumentParser::parseArgs(int argc, char** argv) {
 ArgumentParser::ArgBuilder ArgumentParser::addArgument(std::string nameOrFlags,
                                                        bool addToDefaultGroup) {
     Action::UPtr action = StoreAction::instantiate();
-    ArgBuilder arg(this, action.get(), actions.size() - 1, addToDefaultGroup);
+    ArgBuilder arg(this, action.get(), actions.size(), addToDefaultGroup);
+    compiled = false;
     arg.addNameOrFlag(move(nameOrFlags));
     actions.emplace_back(move(action));
     return arg;
@@ -175,6 +451,8 @@ ArgumentParser& ArgumentParser::epilog(std::string epilogStr) {
 
 ArgumentParser& ArgumentParser::prefixChars(string pfxChars) {
     this->pfxChars = move(pfxChars);
+    // the option tables are indexed by prefix character
+    compiled = false;
     return *this;
 }
 
@@ -183,8 +461,9 @@ ArgumentParser& ArgumentParser::addHelp(bool status) {
     return *this;
 }
 
-ArgumentParser::OptKind ArgumentParser::getOptKind(const string& arg) {
-    if (!arg.empty() && pfxChars.find(arg[0]) != string::npos) {
+ArgumentParser::OptKind ArgumentParser::getOptKind(std::string_view arg) const {
+    // a lone prefix character is positional, usually naming stdin
+    if (arg.size() > 1 && pfxChars.find(arg[0]) != string::npos) {
         if (arg.size() > 1 && arg[1] == arg[0]) {
             return OptKind::LONG;
         } else {
@@ -194,20 +473,36 @@ ArgumentParser::OptKind ArgumentParser::getOptKind(const string& arg) {
     return OptKind::POS;
 }
 
-std::any ArgumentParser::convertType(const std::string& str, Type type) {
+Util::Expected<Value> ArgumentParser::convertType(const char* str, Type type) {
+    // strtol/strtod rather than stol/stod, which report bad input by throwing
+    char* end = nullptr;
+    errno = 0;
     switch (type) {
         case Type::CUSTOM:
         case Type::STRING:
-            return str;
-        case Type::INT:
-            return stol(str);
-        case Type::FLOAT:
-            return stod(str);
+            return Value(in_place_type<string>, str);
+        case Type::INT: {
+            long val = strtol(str, &end, 0);
+            if (end == str || *end != '\0' || errno == ERANGE) {
+                return Util::Unexpected(
+                    Util::Error(string("invalid integer '") + str + "'"));
+            }
+            return Value(val);
+        }
+        case Type::FLOAT: {
+            double val = strtod(str, &end);
+            if (end == str || *end != '\0' || errno == ERANGE) {
+                return Util::Unexpected(
+                    Util::Error(string("invalid number '") + str + "'"));
+            }
+            return Value(val);
+        }
     }
-    return str;
+    return Value(in_place_type<string>, str);
 }
 
 void ArgumentParser::printHelp() {
+    helpShown = true;
     cout << "usage:" << usageText << endl;
     if (!descText.empty()) {
         cout << descText;
@@ -261,27 +556,40 @@ Action::Action()
     : type(ArgumentParser::Type::STRING),
       groupIdx(0),
       nargs(0),
-      required(false),
-      present(false) {
+      slot(0),
+      required(false) {
 }
 
-template <typename T>
-Optional<T> Action::getArgVal(Args& argsContainer, const string& argname) {
-    auto it = argsContainer.args.find(argname);
-    if (it == argsContainer.args.end()) {
-        return {false, T()};
-    }
-    return {true, std::any_cast<T>(it->second)};
+Value& Action::argVal(Args& argsContainer) const {
+    BOUND_CHK_LT(slot, argsContainer.slots.size());
+    return argsContainer.slots[slot].val;
 }
 
-void Action::insertArg(Args& argsContainer, const std::string& dest, std::any val) {
-    argsContainer.args[dest] = std::move(val);
+void Action::insertArg(Args& argsContainer, Value val) const {
+    BOUND_CHK_LT(slot, argsContainer.slots.size());
+    argsContainer.slots[slot].val = std::move(val);
+    argsContainer.slots[slot].present = true;
 }
 
-bool Action::hasConflict(Args& parser, const string& arg) const {
-    UNUSED(parser);
-    UNUSED(arg);
-    return present;
+bool Action::hasConflict(Args& argsContainer) const {
+    BOUND_CHK_LT(slot, argsContainer.slots.size());
+    return argsContainer.slots[slot].present;
+}
+
+bool Action::appendArg(Args& argsContainer, Value val, std::string& error) const {
+    Value& list = argVal(argsContainer);
+    if (auto* str = get_if<string>(&val)) {
+        pushToList<vector<string>>(list, std::move(*str));
+    } else if (auto* num = get_if<long>(&val)) {
+        pushToList<vector<long>>(list, *num);
+    } else if (auto* num = get_if<double>(&val)) {
+        pushToList<vector<double>>(list, *num);
+    } else {
+        error = "Argument '" + dest + "' has a value that can't be stored in a list.";
+        return false;
+    }
+    argsContainer.slots[slot].present = true;
+    return true;
 }
 
 void Action::printHelp(ArgumentParser& parser) {
@@ -306,8 +614,8 @@ void ArgumentParser::ArgBuilder::addNameOrFlag(std::string str) {
     if (found != string::npos) {
         // treat as an optional argument, not a positional argument
         if (kind == ArgKind::POS)
-            throw runtime_error(
-                "Can't specify positional argument alias for optional argument");
+            Util::throwOrAbort(runtime_error(
+                "Can't specify positional argument alias for optional argument"));
         if (kind == ArgKind::NONE && addToDefaultGroup) {
             parser->groups[OPTARG_GROUP_IDX].actions.push_back(actionRef);
             actionRef->groupIdx = OPTARG_GROUP_IDX;
@@ -319,8 +627,8 @@ void ArgumentParser::ArgBuilder::addNameOrFlag(std::string str) {
         // positional arguments are ordered by order of addition and thus just thrown into
         // the vector
         if (kind == ArgKind::OPT)
-            throw runtime_error(
-                "Can't specify optional argument alias for positional argument");
+            Util::throwOrAbort(runtime_error(
+                "Can't specify optional argument alias for positional argument"));
         if (kind == ArgKind::NONE && addToDefaultGroup) {
             parser->groups[POSARG_GROUP_IDX].actions.push_back(actionRef);
             actionRef->groupIdx = POSARG_GROUP_IDX;
@@ -328,7 +636,9 @@ void ArgumentParser::ArgBuilder::addNameOrFlag(std::string str) {
             kind = ArgKind::POS;
         }
         parser->posArgs.push_back(actionRef);
+        actionRef->dest = str;
     }
+    actionRef->nameFlags.push_back(str);
     // set destination to most recently added option
     OptKind optKind = parser->getOptKind(str);
     if (optKind == OptKind::SHORT && !destAdded) {
@@ -339,16 +649,6 @@ void ArgumentParser::ArgBuilder::addNameOrFlag(std::string str) {
     }
 }
 
-ArgumentParser::ArgBuilder& ArgumentParser::ArgBuilder::constVal(std::any value) {
-    actionRef->constVal = std::move(value);
-    return *this;
-}
-
-ArgumentParser::ArgBuilder& ArgumentParser::ArgBuilder::defaultVal(std::any value) {
-    actionRef->defaultval = std::move(value);
-    return *this;
-}
-
 ArgumentParser::ArgBuilder& ArgumentParser::ArgBuilder::dest(std::string destName) {
     actionRef->dest = std::move(destName);
     return *this;
@@ -406,6 +706,27 @@ ArgumentParser::ArgGroup& ArgumentParser::ArgGroup::setMutex(bool val) {
     return *this;
 }
 
+//////////////////////////////////////////////
+// Args implementation
+//////////////////////////////////////////////
+Optional<ArgId> Args::id(const std::string& argRef) const {
+    if (!dests) {
+        return {false, 0};
+    }
+    auto it = lower_bound(dests->begin(), dests->end(), argRef,
+                          [](const pair<string, ArgId>& dest, const string& key) {
+                              return dest.first < key;
+                          });
+    if (it == dests->end() || it->first != argRef) {
+        return {false, 0};
+    }
+    return {true, it->second};
+}
+
+bool Args::given(ArgId argId) const {
+    return argId < slots.size() && slots[argId].present;
+}
+
 //////////////////////////////////////////////
 // StoreAction implementation
 //////////////////////////////////////////////
@@ -413,24 +734,27 @@ Action::UPtr StoreAction::instantiate() {
     return make_unique<StoreAction>();
 }
 
-bool StoreAction::process(ArgumentParser& parser, Args& args,
-                          std::vector<std::any> values, std::string optStr,
-                          string& error) {
+bool StoreAction::process(ArgumentParser& parser, Args& args, Span<Value> values,
+                          const std::string& optStr, string& error) {
     UNUSED(parser);
 
-    if (hasConflict(args, this->dest)) {
+    if (hasConflict(args)) {
         error = "Argument '" + optStr + "' is already defined.";
         return false;
     }
 
     if (values.size() > 1) {
-        insertArg(args, this->dest, move(values));
+        argVal(args) = monostate();
+        for (Value& val : values) {
+            if (!appendArg(args, std::move(val), error)) {
+                return false;
+            }
+        }
     } else if (values.size() == 1) {
-        insertArg(args, this->dest, move(values[0]));
+        insertArg(args, std::move(values[0]));
     } else {
-        insertArg(args, this->dest, this->defaultval);
+        insertArg(args, this->defaultval);
     }
-    present = true;
     return true;
 }
 
@@ -441,18 +765,16 @@ Action::UPtr StoreConstAction::instantiate() {
     return make_unique<StoreConstAction>();
 }
 
-bool StoreConstAction::process(ArgumentParser& parser, Args& args,
-                               std::vector<std::any> values, std::string optStr,
-                               string& error) {
+bool StoreConstAction::process(ArgumentParser& parser, Args& args, Span<Value> values,
+                               const std::string& optStr, string& error) {
     UNUSED(parser);
     UNUSED(values);
 
-    if (hasConflict(args, this->dest)) {
+    if (hasConflict(args)) {
         error = "Argument '" + optStr + "' is already defined.";
         return false;
     }
-    insertArg(args, this->dest, constVal);
-    present = true;
+    insertArg(args, constVal);
     return true;
 }
 
@@ -460,20 +782,21 @@ bool StoreConstAction::process(ArgumentParser& parser, Args& args,
 // StoreTrueAction implementation
 //////////////////////////////////////////////
 Action::UPtr StoreTrueAction::instantiate() {
-    return make_unique<StoreTrueAction>();
+    auto action = make_unique<StoreTrueAction>();
+    action->defaultval = false;
+    return action;
 }
 
-bool StoreTrueAction::process(ArgumentParser& parser, Args& args,
-                              std::vector<std::any> values, std::string optStr,
-                              string& error) {
+bool StoreTrueAction::process(ArgumentParser& parser, Args& args, Span<Value> values,
+                              const std::string& optStr, string& error) {
     UNUSED(parser);
     UNUSED(values);
 
-    if (hasConflict(args, this->dest)) {
+    if (hasConflict(args)) {
         error = "Argument '" + optStr + "' is already defined.";
         return false;
     }
-    insertArg(args, this->dest, true);
+    insertArg(args, true);
     return true;
 }
 
@@ -481,20 +804,21 @@ bool StoreTrueAction::process(ArgumentParser& parser, Args& args,
 // StoreFalseAction implementation
 //////////////////////////////////////////////
 Action::UPtr StoreFalseAction::instantiate() {
-    return make_unique<StoreFalseAction>();
+    auto action = make_unique<StoreFalseAction>();
+    action->defaultval = true;
+    return action;
 }
 
-bool StoreFalseAction::process(ArgumentParser& parser, Args& args,
-                               std::vector<std::any> values, std::string optStr,
-                               string& error) {
+bool StoreFalseAction::process(ArgumentParser& parser, Args& args, Span<Value> values,
+                               const std::string& optStr, string& error) {
     UNUSED(parser);
     UNUSED(values);
 
-    if (hasConflict(args, this->dest)) {
+    if (hasConflict(args)) {
         error = "Argument '" + optStr + "' is already defined.";
         return false;
     }
-    insertArg(args, this->dest, true);
+    insertArg(args, false);
     return true;
 }
 
@@ -505,17 +829,17 @@ Action::UPtr AppendAction::instantiate() {
     return make_unique<AppendAction>();
 }
 
-bool AppendAction::process(ArgumentParser& parser, Args& args,
-                           std::vector<std::any> values, std::string optStr,
-                           string& error) {
-    // TODO implement
+bool AppendAction::process(ArgumentParser& parser, Args& args, Span<Value> values,
+                           const std::string& optStr, string& error) {
     UNUSED(parser);
-    UNUSED(args);
-    UNUSED(values);
     UNUSED(optStr);
-    UNUSED(error);
 
-    return false;
+    for (Value& val : values) {
+        if (!appendArg(args, std::move(val), error)) {
+            return false;
+        }
+    }
+    return true;
 }
 
 //////////////////////////////////////////////
@@ -525,17 +849,13 @@ Action::UPtr AppendConstAction::instantiate() {
     return make_unique<AppendConstAction>();
 }
 
-bool AppendConstAction::process(ArgumentParser& parser, Args& args,
-                                std::vector<std::any> values, std::string optStr,
-                                string& error) {
-    // TODO implement
+bool AppendConstAction::process(ArgumentParser& parser, Args& args, Span<Value> values,
+                                const std::string& optStr, string& error) {
     UNUSED(parser);
-    UNUSED(args);
     UNUSED(values);
     UNUSED(optStr);
-    UNUSED(error);
 
-    return false;
+    return appendArg(args, constVal, error);
 }
 
 //////////////////////////////////////////////
@@ -545,24 +865,16 @@ Action::UPtr CountAction::instantiate() {
     return make_unique<CountAction>();
 }
 
-bool CountAction::process(ArgumentParser& parser, Args& args,
-                          std::vector<std::any> values, std::string optStr,
-                          string& error) {
+bool CountAction::process(ArgumentParser& parser, Args& args, Span<Value> values,
+                          const std::string& optStr, string& error) {
     UNUSED(parser);
     UNUSED(values);
     UNUSED(optStr);
     UNUSED(error);
 
-    long count = 0;
-    if (present) {
-        Optional<long> val = getArgVal<long>(args, optStr);
-        if (!val.present) {
-            error = "Internal error!";
-            return false;
-        }
-        count = val.value;
-    }
-    insertArg(args, this->dest, count + 1);
+    Value& val = argVal(args);
+    long count = holds_alternative<long>(val) ? get<long>(val) : 0;
+    insertArg(args, count + 1);
     return true;
 }
 
@@ -573,15 +885,16 @@ Action::UPtr HelpAction::instantiate() {
     return make_unique<HelpAction>();
 }
 
-bool HelpAction::process(ArgumentParser& parser, Args& args, std::vector<std::any> values,
-                         std::string optStr, string& error) {
-    UNUSED(args);
+bool HelpAction::process(ArgumentParser& parser, Args& args, Span<Value> values,
+                         const std::string& optStr, string& error) {
     UNUSED(values);
     UNUSED(optStr);
     UNUSED(error);
 
+    // the parser stops as soon as help has been shown
     printHelp(parser);
-    return false;
+    insertArg(args, true);
+    return true;
 }
 
-} // namespace ArgParse
\ No newline at end of file
+} // namespace ArgParse
@@ -1,22 +1,59 @@
 /**
  * A CLI argument parser interface inspired (very heavily) by the Python argparse system.
+ *
+ * The options added to a parser are compiled into lookup tables on the first parse:
+ * single character flags index a table by character, longer flags are binary searched,
+ * and every destination is resolved to an integer slot. Parsed values are stored as typed
+ * Values in those slots, so a command line with thousands of -I/-D flags is handled in
+ * linear time without per-option string hashing. Arguments of the form @file are
+ * replaced by the whitespace separated arguments read from file, as in GCC.
  */
 #ifndef ARGPARSE_H
 #define ARGPARSE_H
 
-#include <any>
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <variant>
 #include <vector>
 
+#include "fds/arrayref.h"
+#include "fds/span.h"
+#include "util/expected.h"
+
 namespace ArgParse {
 
 // forward declare classes needed by the ArgBuilder Parser
 class Action;
 class Args;
 
+/**
+ * Index of a destination slot in Args.
+ */
+using ArgId = uint32_t;
+
+/**
+ * A parsed argument value. Integers are stored as long and floats as double. The list
+ * alternatives hold options that take several parameters or are repeated with an
+ * append action.
+ */
+using Value =
+    std::variant<std::monostate, bool, long, double, std::string, std::vector<long>,
+                 std::vector<double>, std::vector<std::string>>;
+
+/**
+ * Wrap a C++ value in the matching Value alternative. Needed because std::variant would
+ * convert a string literal to bool and an int ambiguously.
+ */
+template <typename T> Value toValue(T&& val);
+
 /**
  * A Parser for commandline arguments.
  *
@@ -65,6 +102,13 @@ private:
     std::vector<std::unique_ptr<Action>> actions;
     std::vector<ArgGroup> groups;
 
+    // lookup tables built by compile() from optArgs. Flags of one prefix character and
+    // one name character are found by indexing shortOpts, all others by binary search.
+    std::vector<std::array<Action*, UCHAR_MAX + 1>> shortOpts;
+    std::vector<std::pair<std::string, Action*>> longOpts;
+    // destination names sorted for lookup, shared with the Args produced
+    std::shared_ptr<std::vector<std::pair<std::string, ArgId>>> dests;
+
     std::string pfxChars;
     std::string progName;
     std::string usageText;
@@ -73,10 +117,15 @@ private:
     const long termW;
     bool progSet;
     bool helpEn;
+    bool helpShown;
+    bool helpAdded;
+    bool compiled;
 
 private:
-    OptKind getOptKind(const std::string& arg);
-    std::any convertType(const std::string& str, Type type);
+    void compile();
+    Action* findLong(std::string_view name) const;
+    OptKind getOptKind(std::string_view arg) const;
+    static Util::Expected<Value> convertType(const char* str, Type type);
     void printHelp();
     static void printPadded(const std::string& str, long padTo, long wrapAt,
                             long start = 0);
@@ -91,7 +140,32 @@ public:
     ArgumentParser(ArgumentParser&& parser) = default;
     ArgumentParser& operator=(ArgumentParser&& parser) noexcept = default;
 
-    Args parseArgs(int argc, char** argv);
+    /**
+     * Parse a command line. If help is requested, the help text is printed and parsing
+     * stops early, with the "help" entry of the result set.
+     *
+     * Single character flags take their parameter either attached (-Ipath) or as the
+     * next argument (-I path), long flags either as --flag=value or --flag value. A
+     * lone "--" ends option parsing.
+     *
+     * @return the parsed arguments, or the first error encountered.
+     */
+    Util::Expected<Args> parseArgs(int argc, char** argv);
+
+    /**
+     * Replace every argument of the form @file by the arguments read from file.
+     * Arguments in the file are separated by whitespace, which can be quoted with single
+     * or double quotes or escaped with a backslash. Response files may include other
+     * response files. As in GCC, an @file argument naming a file that can't be opened is
+     * kept as is.
+     *
+     * @param args arguments to expand. Expanded arguments point into buffers.
+     * @param buffers receives the contents of the response files read.
+     * @return an error if response files are nested too deeply, or if one is a directory,
+     * too large or fails to read.
+     */
+    static Util::Expected<void> expandResponseFiles(
+        std::vector<const char*>& args, std::vector<std::unique_ptr<char[]>>& buffers);
 
     /**
      * Add an argument to be parsed by the argument parser. Arguments, that don't start
@@ -157,9 +231,9 @@ protected:
 
 public:
     template <typename T> ArgBuilder& action();
-    template <typename T> ArgBuilder& choices(std::vector<T> choices);
-    ArgBuilder& constVal(std::any value);
-    ArgBuilder& defaultVal(std::any value);
+    template <typename T> ArgBuilder& choices(ArrayRef<T> choices);
+    template <typename T> ArgBuilder& constVal(T&& value);
+    template <typename T> ArgBuilder& defaultVal(T&& value);
     ArgBuilder& dest(std::string destName);
     ArgBuilder& help(std::string helptext);
     ArgBuilder& metavar(std::string name);
@@ -203,7 +277,13 @@ public:
  */
 class Args {
 private:
-    std::unordered_map<std::string, std::any> args;
+    struct Slot {
+        Value val;
+        // set by the command line, not by a default
+        bool present = false;
+    };
+    std::vector<Slot> slots;
+    std::shared_ptr<const std::vector<std::pair<std::string, ArgId>>> dests;
 
     friend class Action;
     friend class ArgumentParser;
@@ -211,18 +291,31 @@ private:
 public:
     template <typename T> struct Entry;
 
-    template <typename T> Entry<T> get(const std::string& argRef);
+    /**
+     * @return the slot of destination name, to be used with the ArgId overloads when an
+     * argument is accessed repeatedly.
+     */
+    Optional<ArgId> id(const std::string& argRef) const;
+    /**
+     * @return whether the argument was given on the command line, as opposed to being
+     * set from its default value or not set at all.
+     */
+    bool given(ArgId argId) const;
+    template <typename T> Entry<T> get(const std::string& argRef) const;
+    template <typename T> Entry<T> get(ArgId argId) const;
 };
 
 /**
  * An entry from an args object containing whether or not it was found, and the value if
- * it was found.
+ * it was found. The value refers into the Args object (or to an empty T if the entry was
+ * not found), so looking up a long list doesn't copy it; it stays valid as long as the
+ * Args object does.
  *
  * @tparam T type of entry.
  */
 template <typename T> struct Args::Entry {
     bool present;
-    T val;
+    const T& val;
 };
 
 /**
@@ -234,25 +327,30 @@ private:
 
 protected:
     std::string helpText;
-    std::any constVal;
-    std::any defaultval;
+    Value constVal;
+    Value defaultval;
     std::string dest;
     std::string metavar;
-    std::vector<std::any> choices;
+    std::vector<Value> choices;
     std::vector<std::string> nameFlags;
     ArgumentParser::Type type;
     std::size_t groupIdx;
     long nargs;
+    // slot of dest, assigned when the parser compiles its tables
+    ArgId slot;
     bool required;
-    bool present;
 
 protected:
     Action();
 
-    template <typename T>
-    Optional<T> getArgVal(Args& argsContainer, const std::string& argname);
-    static void insertArg(Args& argsContainer, const std::string& dest, std::any val);
-    bool hasConflict(Args& parser, const std::string& arg) const;
+    Value& argVal(Args& argsContainer) const;
+    void insertArg(Args& argsContainer, Value val) const;
+    bool hasConflict(Args& argsContainer) const;
+    /**
+     * Append val to the list in this action's slot, starting a new list if the slot
+     * holds anything else.
+     */
+    bool appendArg(Args& argsContainer, Value val, std::string& error) const;
     static void printHelp(ArgumentParser& parser);
 
 public:
@@ -264,12 +362,14 @@ public:
      *
      * @param parser Argument parser action is attached to.
      * @param args Arguments object to add parsed arg to.
-     * @param values Values obtained from the argument values.
+     * @param values Values obtained from the argument values. The parser does not use
+     * them afterwards, so actions may move from them.
+     * @param optStr The option string the argument was given as.
      * @param error An error string to return to the parser if the action fails.
      * @return
      */
-    virtual bool process(ArgumentParser& parser, Args& args, std::vector<std::any> values,
-                         std::string optStr, std::string& error) = 0;
+    virtual bool process(ArgumentParser& parser, Args& args, Span<Value> values,
+                         const std::string& optStr, std::string& error) = 0;
 };
 
 /////////////////////////////////////////////////////////////
@@ -279,93 +379,148 @@ public:
 class StoreAction : public Action {
 public:
     static Action::UPtr instantiate();
-    bool process(ArgumentParser& parser, Args& args, std::vector<std::any> values,
-                 std::string optStr, std::string& error) override;
+    bool process(ArgumentParser& parser, Args& args, Span<Value> values,
+                 const std::string& optStr, std::string& error) override;
 };
 
 class StoreConstAction : public Action {
 public:
     static Action::UPtr instantiate();
-    bool process(ArgumentParser& parser, Args& args, std::vector<std::any> values,
-                 std::string optStr, std::string& error) override;
+    bool process(ArgumentParser& parser, Args& args, Span<Value> values,
+                 const std::string& optStr, std::string& error) override;
 };
 
 class StoreTrueAction : public Action {
 public:
     static Action::UPtr instantiate();
-    bool process(ArgumentParser& parser, Args& args, std::vector<std::any> values,
-                 std::string optStr, std::string& error) override;
+    bool process(ArgumentParser& parser, Args& args, Span<Value> values,
+                 const std::string& optStr, std::string& error) override;
 };
 
 class StoreFalseAction : public Action {
 public:
     static Action::UPtr instantiate();
-    bool process(ArgumentParser& parser, Args& args, std::vector<std::any> values,
-                 std::string optStr, std::string& error) override;
+    bool process(ArgumentParser& parser, Args& args, Span<Value> values,
+                 const std::string& optStr, std::string& error) override;
 };
 
 class AppendAction : public Action {
 public:
     static Action::UPtr instantiate();
-    bool process(ArgumentParser& parser, Args& args, std::vector<std::any> values,
-                 std::string optStr, std::string& error) override;
+    bool process(ArgumentParser& parser, Args& args, Span<Value> values,
+                 const std::string& optStr, std::string& error) override;
 };
 
 class AppendConstAction : public Action {
 public:
     static Action::UPtr instantiate();
-    bool process(ArgumentParser& parser, Args& args, std::vector<std::any> values,
-                 std::string optStr, std::string& error) override;
+    bool process(ArgumentParser& parser, Args& args, Span<Value> values,
+                 const std::string& optStr, std::string& error) override;
 };
 
 class CountAction : public Action {
 public:
     static Action::UPtr instantiate();
-    bool process(ArgumentParser& parser, Args& args, std::vector<std::any> values,
-                 std::string optStr, std::string& error) override;
+    bool process(ArgumentParser& parser, Args& args, Span<Value> values,
+                 const std::string& optStr, std::string& error) override;
 };
 
 class HelpAction : public Action {
 public:
     static Action::UPtr instantiate();
-    bool process(ArgumentParser& parser, Args& args, std::vector<std::any> values,
-                 std::string optStr, std::string& error) override;
+    bool process(ArgumentParser& parser, Args& args, Span<Value> values,
+                 const std::string& optStr, std::string& error) override;
 };
 
 ////////////////////////////////////
 // template function implementations
 ////////////////////////////////////
-template <typename T> Args::Entry<T> Args::get(const std::string& argRef) {
-    auto it = args.find(argRef);
-    if (it != args.end()) {
-        try {
-            return {true, std::any_cast<T>(it->second)};
-        } catch (const std::bad_any_cast& e) {
-            return {false, T()};
+template <typename T> Value toValue(T&& val) {
+    using D = std::decay_t<T>;
+    if constexpr (std::is_same_v<D, Value>) {
+        return std::forward<T>(val);
+    } else if constexpr (std::is_same_v<D, bool>) {
+        return Value(std::in_place_type<bool>, val);
+    } else if constexpr (std::is_integral_v<D> || std::is_enum_v<D>) {
+        return Value(std::in_place_type<long>, static_cast<long>(val));
+    } else if constexpr (std::is_floating_point_v<D>) {
+        return Value(std::in_place_type<double>, static_cast<double>(val));
+    } else if constexpr (std::is_convertible_v<T, std::string_view>) {
+        return Value(std::in_place_type<std::string>, std::string_view(val));
+    } else {
+        return Value(std::forward<T>(val));
+    }
+}
+
+template <typename T> Args::Entry<T> Args::get(ArgId argId) const {
+    static const T missing{};
+    if (argId < slots.size()) {
+        if (const T* val = std::get_if<T>(&slots[argId].val)) {
+            return {true, *val};
         }
     }
-    return {false, T()};
+    return {false, missing};
+}
+
+template <typename T> Args::Entry<T> Args::get(const std::string& argRef) const {
+    Optional<ArgId> argId = id(argRef);
+    if (!argId.present) {
+        return get<T>(static_cast<ArgId>(slots.size()));
+    }
+    return get<T>(argId.value);
 }
 
 template <typename T>
-ArgumentParser::ArgBuilder& ArgumentParser::ArgBuilder::choices(std::vector<T> choices) {
+ArgumentParser::ArgBuilder& ArgumentParser::ArgBuilder::choices(ArrayRef<T> choices) {
     actionRef->choices.clear();
-    actionRef->choices.resize(actionRef->choices.size());
-    for (T& item : choices) {
-        actionRef->choices.push_back(item);
+    actionRef->choices.reserve(choices.size());
+    for (const T& item : choices) {
+        actionRef->choices.push_back(toValue(item));
     }
     return *this;
 }
+
+template <typename T>
+ArgumentParser::ArgBuilder& ArgumentParser::ArgBuilder::constVal(T&& value) {
+    actionRef->constVal = toValue(std::forward<T>(value));
+    return *this;
+}
+
+template <typename T>
+ArgumentParser::ArgBuilder& ArgumentParser::ArgBuilder::defaultVal(T&& value) {
+    actionRef->defaultval = toValue(std::forward<T>(value));
+    return *this;
+}
 template <typename T> ArgumentParser::ArgBuilder& ArgumentParser::ArgBuilder::action() {
     static_assert(std::is_convertible_v<T*, Action*>,
                   "Error: All actions must derive from ArgumentParser::Action.");
     Action::UPtr action = T::instantiate();
+    if (!actionRef) {
+        actionRef = action.get();
+        parser->actions.emplace_back(std::move(action));
+        return *this;
+    }
 
-    if (actionRef) {
-        parser->actions.erase(parser->actions.begin() + ptrIdx);
+    // keep everything configured so far and repoint the lookup tables, which would
+    // otherwise be left holding the replaced action. Defaults the new action brings
+    // along (false for store_true, ...) apply unless one was set explicitly.
+    Value implicitDefault = std::move(action->defaultval);
+    static_cast<Action&>(*action) = *actionRef;
+    if (std::holds_alternative<std::monostate>(action->defaultval)) {
+        action->defaultval = std::move(implicitDefault);
+    }
+    for (auto& opt : parser->optArgs) {
+        if (opt.second == actionRef) {
+            opt.second = action.get();
+        }
+    }
+    std::replace(parser->posArgs.begin(), parser->posArgs.end(), actionRef, action.get());
+    for (ArgGroup& group : parser->groups) {
+        std::replace(group.actions.begin(), group.actions.end(), actionRef, action.get());
     }
     actionRef = action.get();
-    parser->actions.emplace_back(std::move(action));
+    parser->actions[ptrIdx] = std::move(action);
+    parser->compiled = false;
     return *this;
 }
 
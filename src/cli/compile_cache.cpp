@@ -0,0 +1,233 @@
+#include "compile_cache.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "cli/driver.h"
+#include "util/hash.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace Driver {
+
+// second seed used to widen keys to 128 bits
+static constexpr uint64_t KEY_SEED_HI = 0x6563632d63616368ULL;
+// holds the size estimate; entries only live in subdirectories, so it can't clash
+static const char SIZE_FILE[] = "size";
+
+//////////////////////////////////////////////
+// CacheKeyBuilder implementation
+//////////////////////////////////////////////
+CacheKeyBuilder::CacheKeyBuilder() {
+    append(ECC_VERSION);
+}
+
+void CacheKeyBuilder::append(const std::string& str) {
+    // length prefix so that ("ab", "c") and ("a", "bc") hash differently
+    buf += to_string(str.size());
+    buf += ':';
+    buf += str;
+}
+
+CacheKeyBuilder& CacheKeyBuilder::addInput(const std::string& contents) {
+    // only the digest is kept so large inputs are not copied
+    char digest[33];
+    snprintf(digest, sizeof(digest), "%016llx%016llx",
+             static_cast<unsigned long long>(Util::hash64(contents)),
+             static_cast<unsigned long long>(Util::hash64(contents, KEY_SEED_HI)));
+    append("input");
+    append(digest);
+    return *this;
+}
+
+CacheKeyBuilder& CacheKeyBuilder::addFlag(const std::string& name,
+                                          const std::string& value) {
+    append(name);
+    append(value);
+    return *this;
+}
+
+std::string CacheKeyBuilder::finish() const {
+    char key[33];
+    snprintf(key, sizeof(key), "%016llx%016llx",
+             static_cast<unsigned long long>(Util::hash64(buf)),
+             static_cast<unsigned long long>(Util::hash64(buf, KEY_SEED_HI)));
+    return key;
+}
+
+//////////////////////////////////////////////
+// CompileCache implementation
+//////////////////////////////////////////////
+CompileCache::CompileCache(std::string dir, uint64_t maxBytes)
+    : root{move(dir)}, maxBytes{maxBytes}, numStores{0} {
+}
+
+fs::path CompileCache::entryPath(const std::string& key) const {
+    // keys are hex digests; anything else could name a path outside the cache
+    bool valid = key.size() > 2 && all_of(key.begin(), key.end(), [](char c) {
+                     return isxdigit(static_cast<unsigned char>(c));
+                 });
+    if (!valid) {
+        return fs::path();
+    }
+    // fan out over 256 subdirectories to keep directory sizes sane
+    return root / key.substr(0, 2) / key.substr(2);
+}
+
+uint64_t CompileCache::growEstimate(uint64_t bytes) {
+    uint64_t size;
+    ifstream in(root / SIZE_FILE);
+    if (!(in >> size)) {
+        return UINT64_MAX;
+    }
+    in.close();
+    // concurrent stores may lose each other's updates; periodic rescans correct that
+    writeEstimate(size + bytes);
+    return size + bytes;
+}
+
+void CompileCache::writeEstimate(uint64_t bytes) {
+    static atomic<unsigned> tmpCounter{0};
+    fs::path tmp = root / (".tmp.size." + to_string(getpid()) + "." +
+                           to_string(tmpCounter++));
+    error_code ec;
+    {
+        ofstream out(tmp, ios::trunc);
+        if (!(out << bytes << "\n")) {
+            fs::remove(tmp, ec);
+            return;
+        }
+    }
+    fs::rename(tmp, root / SIZE_FILE, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+    }
+}
+
+bool CompileCache::lookup(const std::string& key, std::string& out) {
+    fs::path path = entryPath(key);
+    if (path.empty()) {
+        return false;
+    }
+    ifstream in(path, ios::binary);
+    if (!in) {
+        return false;
+    }
+    stringstream ss;
+    ss << in.rdbuf();
+    if (!in) {
+        return false;
+    }
+    out = ss.str();
+    // refresh the entry for LRU eviction; failing to do so is harmless
+    error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    return true;
+}
+
+bool CompileCache::store(const std::string& key, const std::string& data,
+                         std::string& error) {
+    static atomic<unsigned> tmpCounter{0};
+    fs::path path = entryPath(key);
+    if (path.empty()) {
+        error = "Invalid cache key '" + key + "'.";
+        return false;
+    }
+    error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+    if (ec) {
+        error = "Unable to create cache directory '" + path.parent_path().string() +
+                "': " + ec.message();
+        return false;
+    }
+
+    fs::path tmp = path.parent_path() / (".tmp." + to_string(getpid()) + "." +
+                                         to_string(tmpCounter++));
+    {
+        ofstream out(tmp, ios::binary | ios::trunc);
+        out.write(data.data(), static_cast<streamsize>(data.size()));
+        if (!out) {
+            error = "Unable to write cache entry '" + tmp.string() + "'.";
+            fs::remove(tmp, ec);
+            return false;
+        }
+    }
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        error = "Unable to commit cache entry '" + path.string() + "': " + ec.message();
+        fs::remove(tmp, ec);
+        return false;
+    }
+    uint64_t estimate = growEstimate(data.size());
+    if (estimate > maxBytes || ++numStores % RESCAN_INTERVAL == 0) {
+        evict();
+    }
+    return true;
+}
+
+uint64_t CompileCache::evict() {
+    struct Entry {
+        fs::path path;
+        fs::file_time_type mtime;
+        uint64_t size;
+    };
+    vector<Entry> entries;
+    uint64_t total = 0;
+    error_code ec;
+    for (fs::recursive_directory_iterator it(root, ec), end; !ec && it != end;
+         it.increment(ec)) {
+        // skip in-flight temporaries of concurrent stores and the size estimate
+        bool isTmp = it->path().filename().string().rfind(".tmp.", 0) == 0;
+        if (it.depth() == 0 || isTmp) {
+            continue;
+        }
+        // failures here mean the entry raced with another compiler's eviction. They are
+        // checked after every call, as a later success clears the error of an earlier
+        // one, and kept apart from ec, which ends the scan.
+        error_code entryEc;
+        if (!it->is_regular_file(entryEc)) {
+            continue;
+        }
+        Entry entry{it->path(), it->last_write_time(entryEc), 0};
+        if (entryEc) {
+            continue;
+        }
+        entry.size = it->file_size(entryEc);
+        if (entryEc) {
+            continue;
+        }
+        total += entry.size;
+        entries.push_back(move(entry));
+    }
+    if (total <= maxBytes) {
+        writeEstimate(total);
+        return 0;
+    }
+
+    // evict down to a low-water mark, so that the estimate stays below the limit (and
+    // stores skip the scan) until about a tenth of the limit has been added again
+    uint64_t target = maxBytes / 10 * 9;
+    sort(entries.begin(), entries.end(),
+         [](const Entry& a, const Entry& b) { return a.mtime < b.mtime; });
+    uint64_t freed = 0;
+    for (const Entry& entry : entries) {
+        if (total - freed <= target) {
+            break;
+        }
+        if (fs::remove(entry.path, ec)) {
+            freed += entry.size;
+        }
+    }
+    writeEstimate(total - freed);
+    return freed;
+}
+
+} // namespace Driver
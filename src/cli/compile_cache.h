@@ -0,0 +1,109 @@
+/**
+ * A content addressed, on-disk cache of compiler outputs.
+ *
+ * Entries are keyed by a hash of everything that can affect the output of a compile: the
+ * preprocessed input, the output-relevant flags and the compiler version. A hit lets the
+ * driver skip lexing and parsing entirely.
+ */
+#ifndef COMPILE_CACHE_H
+#define COMPILE_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+namespace Driver {
+
+/**
+ * Accumulates the inputs of a compile into a cache key. The order of calls matters, so
+ * flags should be added in a fixed order (e.g. the order of the option table), not in
+ * command line order.
+ */
+class CacheKeyBuilder {
+private:
+    std::string buf;
+
+    void append(const std::string& str);
+
+public:
+    /**
+     * Start a key. The compiler version is always part of the key.
+     */
+    CacheKeyBuilder();
+
+    CacheKeyBuilder& addInput(const std::string& contents);
+    CacheKeyBuilder& addFlag(const std::string& name, const std::string& value);
+
+    /**
+     * @return the key as 32 lower case hex digits.
+     */
+    std::string finish() const;
+};
+
+/**
+ * The cache directory itself. Entries are written to a temporary file and renamed into
+ * place, so concurrent compilers sharing a directory never observe a partial entry.
+ * When the directory grows past its size limit, the least recently used entries are
+ * evicted (a hit refreshes an entry's modification time).
+ *
+ * Rather than walking the directory on every store, the cache keeps an estimate of its
+ * size in a file at its root, which every store bumps. The directory is only scanned,
+ * and the estimate made exact, when the estimate is missing or crosses the limit, and
+ * every RESCAN_INTERVAL stores of a process to catch updates lost to concurrent
+ * compilers.
+ */
+class CompileCache {
+private:
+    std::filesystem::path root;
+    uint64_t maxBytes;
+    std::atomic<unsigned> numStores;
+
+    /**
+     * @return the path of an entry, or an empty path if key is not a valid key.
+     */
+    std::filesystem::path entryPath(const std::string& key) const;
+    /**
+     * Add bytes to the size estimate.
+     *
+     * @return the new estimate, or UINT64_MAX if there is none yet.
+     */
+    uint64_t growEstimate(uint64_t bytes);
+    void writeEstimate(uint64_t bytes);
+
+public:
+    static constexpr unsigned RESCAN_INTERVAL = 256;
+
+    CompileCache(std::string dir, uint64_t maxBytes);
+
+    /**
+     * Look up an entry.
+     *
+     * @param key key returned by CacheKeyBuilder::finish().
+     * @param out set to the cached output on a hit.
+     * @return true on a hit.
+     */
+    bool lookup(const std::string& key, std::string& out);
+    /**
+     * Atomically store an entry, evicting old entries if the cache is estimated to be
+     * over its limit.
+     *
+     * @param key key returned by CacheKeyBuilder::finish().
+     * @param data compiler output to cache.
+     * @param error set to a description of the problem on failure.
+     * @return true if the entry was stored.
+     */
+    bool store(const std::string& key, const std::string& data, std::string& error);
+    /**
+     * Scan the whole cache, record its exact size, and if it is over its limit evict
+     * least recently used entries until it is below 90% of the limit, so that the next
+     * stores stay clear of another scan.
+     *
+     * @return the number of bytes freed.
+     */
+    uint64_t evict();
+};
+
+} // namespace Driver
+
+#endif // COMPILE_CACHE_H
@@ -0,0 +1,438 @@
+#include "compile_server.h"
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <ostream>
+#include <streambuf>
+
+#include "frontend/include_cache.h"
+
+using namespace std;
+
+namespace Driver {
+
+namespace {
+
+enum FrameType : char {
+    FRAME_REQUEST = 'R',
+    FRAME_STDOUT = 'O',
+    FRAME_STDERR = 'E',
+    FRAME_EXIT = 'X',
+};
+
+// reject anything larger so a confused peer can't make us allocate gigabytes
+constexpr uint32_t MAX_FRAME = 64 * 1024 * 1024;
+// a client that connects and then stalls must not hold a worker forever
+constexpr time_t REQUEST_TIMEOUT_SEC = 30;
+
+bool writeAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        // MSG_NOSIGNAL: a client that went away must not SIGPIPE the whole server
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool readAll(int fd, char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = read(fd, data, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+void putU32(string& buf, uint32_t val) {
+    for (int i = 0; i < 4; ++i) {
+        buf += static_cast<char>(val >> (8 * i));
+    }
+}
+
+uint32_t getU32(const char* data) {
+    uint32_t val = 0;
+    for (int i = 0; i < 4; ++i) {
+        val |= static_cast<uint32_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+    }
+    return val;
+}
+
+void putString(string& buf, const string& str) {
+    putU32(buf, static_cast<uint32_t>(str.size()));
+    buf += str;
+}
+
+bool getString(const string& buf, size_t& pos, string& str) {
+    if (buf.size() - pos < 4) {
+        return false;
+    }
+    uint32_t len = getU32(&buf[pos]);
+    pos += 4;
+    if (buf.size() - pos < len) {
+        return false;
+    }
+    str.assign(buf, pos, len);
+    pos += len;
+    return true;
+}
+
+bool sendFrame(int fd, char type, const char* data, size_t len) {
+    string header;
+    putU32(header, static_cast<uint32_t>(len));
+    header += type;
+    return writeAll(fd, header.data(), header.size()) && writeAll(fd, data, len);
+}
+
+bool recvFrame(int fd, char& type, string& payload) {
+    char header[5];
+    if (!readAll(fd, header, sizeof(header))) {
+        return false;
+    }
+    uint32_t len = getU32(header);
+    if (len > MAX_FRAME) {
+        return false;
+    }
+    type = header[4];
+    payload.resize(len);
+    return readAll(fd, &payload[0], len);
+}
+
+/**
+ * Stream buffer that sends its contents as frames of one type whenever it fills up or
+ * is flushed. Write errors are dropped: the client has gone away and the compile simply
+ * runs to completion unobserved.
+ */
+class FrameBuf : public streambuf {
+private:
+    int fd;
+    char type;
+    char buf[4096];
+
+    void send() {
+        if (pptr() != pbase()) {
+            sendFrame(fd, type, pbase(), pptr() - pbase());
+        }
+        setp(buf, buf + sizeof(buf));
+    }
+
+protected:
+    int_type overflow(int_type ch) override {
+        send();
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int sync() override {
+        send();
+        return 0;
+    }
+
+public:
+    FrameBuf(int fd, char type) : fd{fd}, type{type} {
+        setp(buf, buf + sizeof(buf));
+    }
+};
+
+bool makeAddress(const string& path, sockaddr_un& addr, string& error) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        error = "socket path '" + path + "' is too long";
+        return false;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+/**
+ * @return true if the process at the other end of a connected socket runs as our user.
+ */
+bool peerIsUs(int fd) {
+    ucred cred;
+    socklen_t len = sizeof(cred);
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 &&
+           len == sizeof(cred) && cred.uid == getuid();
+}
+
+/**
+ * Make sure the directory holding the socket is private to us, creating it if needed.
+ * Anyone who can write to the directory could replace the socket with their own, so a
+ * directory that is a symlink, owned by someone else or open to group or others is
+ * refused.
+ */
+bool securePrivateDir(const string& socketPath, string& error) {
+    string::size_type slash = socketPath.rfind('/');
+    // a socket directly in / keeps the slash
+    string dir = slash == string::npos ? "." : socketPath.substr(0, slash ? slash : 1);
+    if (mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) {
+        error = "cannot create '" + dir + "': " + strerror(errno);
+        return false;
+    }
+    struct stat info;
+    if (lstat(dir.c_str(), &info) != 0) {
+        error = "cannot stat '" + dir + "': " + strerror(errno);
+        return false;
+    }
+    if (!S_ISDIR(info.st_mode) || info.st_uid != getuid() || (info.st_mode & 077) != 0) {
+        error = "socket directory '" + dir +
+                "' must be a directory owned by the current user with mode 0700";
+        return false;
+    }
+    return true;
+}
+
+int connectTo(const sockaddr_un& addr) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+} // namespace
+
+//////////////////////////////////////////////
+// CompileServer implementation
+//////////////////////////////////////////////
+CompileServer::CompileServer(std::string socketPath, CompileHandler handler,
+                             unsigned threads)
+    : socketPath{move(socketPath)}, handler{move(handler)}, numThreads{threads},
+      listenFd{-1}, stopping{false} {
+    if (numThreads == 0) {
+        numThreads = max(1u, thread::hardware_concurrency());
+    }
+}
+
+CompileServer::~CompileServer() {
+    if (listenFd >= 0) {
+        close(listenFd);
+    }
+}
+
+bool CompileServer::listen(std::string& error) {
+    sockaddr_un addr;
+    if (!makeAddress(socketPath, addr, error) || !securePrivateDir(socketPath, error)) {
+        return false;
+    }
+    // a socket file nobody answers on is left over from a server that died
+    int probe = connectTo(addr);
+    if (probe >= 0) {
+        close(probe);
+        error = "a compile server is already listening on '" + socketPath + "'";
+        return false;
+    }
+    unlink(socketPath.c_str());
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0 ||
+        bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listenFd, SOMAXCONN) != 0) {
+        error = "cannot listen on '" + socketPath + "': " + strerror(errno);
+        if (listenFd >= 0) {
+            close(listenFd);
+            listenFd = -1;
+        }
+        return false;
+    }
+    return true;
+}
+
+void CompileServer::run() {
+    for (unsigned i = 0; i < numThreads; ++i) {
+        pool.emplace_back(&CompileServer::worker, this);
+    }
+    while (!stopping) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            break;
+        }
+        // the directory keeps other users out, but don't rely on it alone
+        if (!peerIsUs(fd)) {
+            close(fd);
+            continue;
+        }
+        timeval timeout = {REQUEST_TIMEOUT_SEC, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        {
+            lock_guard<mutex> guard(lock);
+            pending.push_back(fd);
+        }
+        ready.notify_one();
+    }
+
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (thread& t : pool) {
+        t.join();
+    }
+    pool.clear();
+    close(listenFd);
+    listenFd = -1;
+    unlink(socketPath.c_str());
+}
+
+void CompileServer::stop() {
+    stopping = true;
+    // wakes up the blocking accept() in run()
+    shutdown(listenFd, SHUT_RDWR);
+}
+
+void CompileServer::worker() {
+    while (true) {
+        int fd;
+        {
+            unique_lock<mutex> guard(lock);
+            ready.wait(guard, [this]() { return stopping || !pending.empty(); });
+            if (pending.empty()) {
+                return;
+            }
+            fd = pending.front();
+            pending.pop_front();
+        }
+        serve(fd);
+        close(fd);
+    }
+}
+
+void CompileServer::serve(int fd) {
+    char type;
+    string payload;
+    if (!recvFrame(fd, type, payload) || type != FRAME_REQUEST) {
+        return;
+    }
+    CompileRequest req;
+    size_t pos = 0;
+    if (!getString(payload, pos, req.cwd) || payload.size() - pos < 4) {
+        return;
+    }
+    uint32_t argc = getU32(&payload[pos]);
+    pos += 4;
+    for (uint32_t i = 0; i < argc; ++i) {
+        string arg;
+        if (!getString(payload, pos, arg)) {
+            return;
+        }
+        req.args.push_back(move(arg));
+    }
+
+    // headers edited since the last compile must not be served from the cache
+    Frontend::IncludeCache::global().revalidate();
+
+    FrameBuf outBuf(fd, FRAME_STDOUT);
+    FrameBuf diagBuf(fd, FRAME_STDERR);
+    ostream out(&outBuf);
+    ostream diag(&diagBuf);
+    int status;
+#ifdef __cpp_exceptions
+    try {
+        status = handler(req, out, diag);
+    } catch (const exception& e) {
+        // one bad compile must not take down the server and every other client with it
+        diag << "ecc: internal compiler error: " << e.what() << "\n";
+        status = EXIT_FAILURE;
+    }
+#else
+    status = handler(req, out, diag);
+#endif
+    out.flush();
+    diag.flush();
+
+    string exit;
+    putU32(exit, static_cast<uint32_t>(status));
+    sendFrame(fd, FRAME_EXIT, exit.data(), exit.size());
+}
+
+//////////////////////////////////////////////
+// Client implementation
+//////////////////////////////////////////////
+bool forwardCompile(const std::string& socketPath, const CompileRequest& req,
+                    std::ostream& out, std::ostream& diag, int& status,
+                    std::string& error) {
+    sockaddr_un addr;
+    if (!makeAddress(socketPath, addr, error)) {
+        return false;
+    }
+    int fd = connectTo(addr);
+    if (fd < 0) {
+        error = "no compile server on '" + socketPath + "'";
+        return false;
+    }
+    // our command line and sources must not go to a server run by someone else
+    if (!peerIsUs(fd)) {
+        close(fd);
+        error = "compile server on '" + socketPath + "' belongs to another user";
+        return false;
+    }
+
+    string payload;
+    putString(payload, req.cwd);
+    putU32(payload, static_cast<uint32_t>(req.args.size()));
+    for (const string& arg : req.args) {
+        putString(payload, arg);
+    }
+    bool ok = sendFrame(fd, FRAME_REQUEST, payload.data(), payload.size());
+
+    char type;
+    while (ok && (ok = recvFrame(fd, type, payload))) {
+        if (type == FRAME_STDOUT) {
+            out.write(payload.data(), payload.size());
+        } else if (type == FRAME_STDERR) {
+            diag.write(payload.data(), payload.size());
+        } else if (type == FRAME_EXIT && payload.size() == 4) {
+            status = static_cast<int>(getU32(payload.data()));
+            break;
+        } else {
+            ok = false;
+        }
+    }
+    close(fd);
+    if (!ok) {
+        error = "lost connection to compile server on '" + socketPath + "'";
+    }
+    return ok;
+}
+
+std::string defaultSocketPath() {
+    const char* runtimeDir = getenv("XDG_RUNTIME_DIR");
+    if (runtimeDir && *runtimeDir) {
+        return string(runtimeDir) + "/ecc.sock";
+    }
+    return "/tmp/ecc-" + to_string(getuid()) + "/ecc.sock";
+}
+
+} // namespace Driver
@@ -0,0 +1,123 @@
+/**
+ * Persistent compile server (ecc --server) and its thin client.
+ *
+ * The server listens on a local Unix socket and runs each incoming compile on a shared
+ * thread pool. Because the process stays alive between compiles, process-wide caches
+ * (IncludeCache::global(), the compile cache, ...) stay warm across requests. A client
+ * sends its command line and working directory, and the server streams back the
+ * compile's stdout and stderr followed by its exit status. Cached headers that changed
+ * on disk are dropped before each compile.
+ *
+ * Wire format: every message is a frame of a 4-byte little-endian payload length, a
+ * 1-byte frame type and the payload. Strings inside a payload are length prefixed the
+ * same way.
+ */
+#ifndef COMPILE_SERVER_H
+#define COMPILE_SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Driver {
+
+/**
+ * A compile forwarded by a client.
+ */
+struct CompileRequest {
+    // working directory of the client. The server never changes its own working
+    // directory (it is shared by all threads), so handlers must resolve relative paths
+    // against this.
+    std::string cwd;
+    // full command line, including argv[0]
+    std::vector<std::string> args;
+};
+
+/**
+ * Runs one compile. Output written to out and diag is streamed to the client as it is
+ * flushed. Called concurrently from the pool threads.
+ *
+ * @return the exit status reported to the client.
+ */
+using CompileHandler =
+    std::function<int(const CompileRequest& req, std::ostream& out, std::ostream& diag)>;
+
+class CompileServer {
+private:
+    std::string socketPath;
+    CompileHandler handler;
+    unsigned numThreads;
+    int listenFd;
+    std::atomic<bool> stopping;
+
+    std::mutex lock;
+    std::condition_variable ready;
+    std::deque<int> pending;
+    std::vector<std::thread> pool;
+
+    void worker();
+    void serve(int fd);
+
+public:
+    /**
+     * @param socketPath path of the Unix socket to listen on.
+     * @param handler compile implementation.
+     * @param threads number of pool threads (0 picks the hardware concurrency).
+     */
+    CompileServer(std::string socketPath, CompileHandler handler, unsigned threads = 0);
+    ~CompileServer();
+    CompileServer(const CompileServer&) = delete;
+    CompileServer& operator=(const CompileServer&) = delete;
+
+    /**
+     * Bind the socket, replacing a stale socket file left behind by a dead server. The
+     * directory of the socket is created with mode 0700 if missing; an existing one must
+     * be owned by the current user and closed to everyone else. Connections from other
+     * users are dropped.
+     *
+     * @param error set to a description of the problem on failure.
+     * @return false if the socket could not be bound, e.g. because another server is
+     * already listening on it or its directory is not private.
+     */
+    bool listen(std::string& error);
+    /**
+     * Accept and serve connections until stop() is called. Requests still queued or
+     * running when the server stops are finished before this returns.
+     */
+    void run();
+    /**
+     * Make run() return. Safe to call from another thread.
+     */
+    void stop();
+};
+
+/**
+ * Forward a compile to a running server and copy its output to out and diag as it
+ * arrives. A server running as another user is refused.
+ *
+ * @param socketPath path of the server's socket.
+ * @param req command line and working directory to forward.
+ * @param status set to the exit status of the compile.
+ * @param error set to a description of the problem on failure.
+ * @return false if no server could be reached or the connection dropped, in which case
+ * the caller should fall back to compiling in process.
+ */
+bool forwardCompile(const std::string& socketPath, const CompileRequest& req,
+                    std::ostream& out, std::ostream& diag, int& status,
+                    std::string& error);
+
+/**
+ * Default socket path for the current user: $XDG_RUNTIME_DIR/ecc.sock if set, and
+ * /tmp/ecc-<uid>/ecc.sock otherwise.
+ */
+std::string defaultSocketPath();
+
+} // namespace Driver
+
+#endif // COMPILE_SERVER_H
@@ -1 +1,10 @@
- 
+#ifndef DRIVER_H
+#define DRIVER_H
+
+// Compiler version string. It is mixed into every compile cache key, so bumping it
+// invalidates all cached outputs. Can be overridden from the Makefile with -DECC_VERSION.
+#ifndef ECC_VERSION
+#define ECC_VERSION "0.1.0-dev"
+#endif
+
+#endif // DRIVER_H
@@ -0,0 +1,208 @@
+#include "block_layout.h"
+
+#include <algorithm>
+#include <numeric>
+#include <queue>
+#include <tuple>
+
+#include "util/timetrace.h"
+
+using namespace std;
+using IR::ControlGraph;
+
+namespace Codegen {
+
+using BlockId = ControlGraph::BlockId;
+using EdgeId = ControlGraph::EdgeId;
+
+/**
+ * Fill in per-edge and per-block execution weights, returning the weight of the entry
+ * block that cold thresholds are relative to.
+ */
+static double estimateWeights(const ControlGraph& cfg, const LayoutParams& params,
+                              vector<double>& edgeW, vector<double>& blockW) {
+    const auto& g = cfg.getGraph();
+    edgeW.assign(g.numEdges(), 0.0);
+    blockW.assign(g.numNodes(), 0.0);
+    if (g.numNodes() == 0) {
+        return 0.0;
+    }
+
+    if (cfg.hasProfile()) {
+        for (EdgeId e = 0; e < g.numEdges(); ++e) {
+            edgeW[e] = static_cast<double>(g.edge(e).data.count);
+        }
+        for (BlockId b = 0; b < g.numNodes(); ++b) {
+            blockW[b] = static_cast<double>(g.node(b).count);
+        }
+        return blockW[cfg.getEntry()];
+    }
+
+    // reverse postorder of the reachable blocks
+    constexpr size_t UNVISITED = ~static_cast<size_t>(0);
+    vector<BlockId> postorder;
+    vector<bool> visited(g.numNodes(), false);
+    vector<pair<BlockId, size_t>> dfs;
+    dfs.emplace_back(cfg.getEntry(), 0);
+    visited[cfg.getEntry()] = true;
+    while (!dfs.empty()) {
+        BlockId b = dfs.back().first;
+        size_t& pos = dfs.back().second;
+        ArrayRef<EdgeId> out = g.succEdges(b);
+        if (pos < out.size()) {
+            BlockId next = g.edge(out[pos++]).dst;
+            if (!visited[next]) {
+                visited[next] = true;
+                dfs.emplace_back(next, 0);
+            }
+            continue;
+        }
+        postorder.push_back(b);
+        dfs.pop_back();
+    }
+    vector<size_t> rpoIdx(g.numNodes(), UNVISITED);
+    for (size_t i = 0; i < postorder.size(); ++i) {
+        rpoIdx[postorder[postorder.size() - 1 - i]] = i;
+    }
+
+    // propagate frequencies along forward edges; back edges mark loop headers
+    for (auto it = postorder.rbegin(); it != postorder.rend(); ++it) {
+        BlockId b = *it;
+        double freq = b == cfg.getEntry() ? 1.0 : 0.0;
+        bool loopHeader = false;
+        for (EdgeId e : g.predEdges(b)) {
+            BlockId src = g.edge(e).src;
+            if (rpoIdx[src] == UNVISITED) {
+                continue;
+            }
+            if (rpoIdx[src] >= rpoIdx[b]) {
+                loopHeader = true;
+            } else {
+                freq += edgeW[e];
+            }
+        }
+        if (loopHeader) {
+            freq *= params.loopScale;
+        }
+        blockW[b] = freq;
+        for (EdgeId e : g.succEdges(b)) {
+            edgeW[e] = freq * cfg.edgeProb(e);
+        }
+    }
+    return 1.0;
+}
+
+vector<double> estimateEdgeWeights(const ControlGraph& cfg, const LayoutParams& params) {
+    vector<double> edgeW;
+    vector<double> blockW;
+    estimateWeights(cfg, params, edgeW, blockW);
+    return edgeW;
+}
+
+BlockLayout layoutBlocks(const ControlGraph& cfg, const LayoutParams& params) {
+    TIME_SCOPE("block_layout");
+    const auto& g = cfg.getGraph();
+    size_t numBlocks = g.numNodes();
+    BlockLayout layout;
+    layout.coldStart = 0;
+    if (numBlocks == 0) {
+        return layout;
+    }
+
+    vector<double> edgeW;
+    vector<double> blockW;
+    double entryW = estimateWeights(cfg, params, edgeW, blockW);
+    BlockId entry = cfg.getEntry();
+
+    // every block starts out as its own chain
+    vector<vector<BlockId>> chains(numBlocks);
+    vector<size_t> chainOf(numBlocks);
+    for (BlockId b = 0; b < numBlocks; ++b) {
+        chains[b].push_back(b);
+        chainOf[b] = b;
+    }
+
+    // join chains along the hottest edges first
+    vector<EdgeId> edges(g.numEdges());
+    iota(edges.begin(), edges.end(), 0);
+    stable_sort(edges.begin(), edges.end(),
+                [&](EdgeId a, EdgeId b) { return edgeW[a] > edgeW[b]; });
+    for (EdgeId e : edges) {
+        BlockId src = g.edge(e).src;
+        BlockId dst = g.edge(e).dst;
+        size_t srcChain = chainOf[src];
+        size_t dstChain = chainOf[dst];
+        if (srcChain == dstChain || dst == entry || chains[srcChain].back() != src ||
+            chains[dstChain].front() != dst) {
+            continue;
+        }
+        for (BlockId b : chains[dstChain]) {
+            chainOf[b] = srcChain;
+        }
+        chains[srcChain].insert(chains[srcChain].end(), chains[dstChain].begin(),
+                                chains[dstChain].end());
+        chains[dstChain].clear();
+    }
+
+    // a chain is cold if none of its blocks reach the cold threshold
+    vector<bool> cold(numBlocks, true);
+    for (BlockId b = 0; b < numBlocks; ++b) {
+        if (blockW[b] >= params.coldFreq * entryW && blockW[b] > 0.0) {
+            cold[chainOf[b]] = false;
+        }
+    }
+    cold[chainOf[entry]] = false;
+
+    // Place chains greedily by their connection weight to the chains already placed. The
+    // heap holds (weight, -first block, chain) so that ties keep the original IR order.
+    vector<double> score(numBlocks, 0.0);
+    vector<bool> placed(numBlocks, false);
+    priority_queue<tuple<double, long, size_t>> heap;
+    auto place = [&](size_t chain) {
+        placed[chain] = true;
+        for (BlockId b : chains[chain]) {
+            layout.order.push_back(b);
+        }
+        for (BlockId b : chains[chain]) {
+            for (ArrayRef<EdgeId> list : {g.succEdges(b), g.predEdges(b)}) {
+                for (EdgeId e : list) {
+                    BlockId other = g.edge(e).src == b ? g.edge(e).dst : g.edge(e).src;
+                    size_t c = chainOf[other];
+                    if (placed[c] || cold[c]) {
+                        continue;
+                    }
+                    score[c] += edgeW[e];
+                    heap.emplace(score[c], -static_cast<long>(chains[c].front()), c);
+                }
+            }
+        }
+    };
+
+    place(chainOf[entry]);
+    while (!heap.empty()) {
+        size_t chain = get<2>(heap.top());
+        heap.pop();
+        if (!placed[chain]) {
+            place(chain);
+        }
+    }
+    // chains not connected to anything placed (e.g. unreachable blocks) keep IR order
+    for (BlockId b = 0; b < numBlocks; ++b) {
+        size_t chain = chainOf[b];
+        if (!placed[chain] && !cold[chain] && chains[chain].front() == b) {
+            place(chain);
+        }
+    }
+    layout.coldStart = layout.order.size();
+    for (BlockId b = 0; b < numBlocks; ++b) {
+        size_t chain = chainOf[b];
+        if (!placed[chain] && chains[chain].front() == b) {
+            placed[chain] = true;
+            layout.order.insert(layout.order.end(), chains[chain].begin(),
+                                chains[chain].end());
+        }
+    }
+    return layout;
+}
+
+} // namespace Codegen
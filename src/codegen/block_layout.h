@@ -0,0 +1,52 @@
+#ifndef BLOCK_LAYOUT_H
+#define BLOCK_LAYOUT_H
+
+#include <cstddef>
+#include <vector>
+
+#include "ir/control_graph.h"
+
+namespace Codegen {
+
+/**
+ * Tunables for block placement.
+ */
+struct LayoutParams {
+    // frequency multiplier for loop headers when no profile is available
+    double loopScale = 10.0;
+    // blocks executed less often than this (relative to the entry) are moved into the
+    // cold part of the function
+    double coldFreq = 0.01;
+};
+
+/**
+ * Final block order of a function. Blocks from coldStart onwards are cold and may be
+ * emitted into a separate section.
+ */
+struct BlockLayout {
+    std::vector<IR::ControlGraph::BlockId> order;
+    std::size_t coldStart;
+};
+
+/**
+ * Estimate the execution frequency of every edge. Uses profile counts if the graph has a
+ * profile, and otherwise propagates static branch probabilities from the entry in reverse
+ * postorder, scaling loop headers by LayoutParams::loopScale.
+ *
+ * @return one weight per edge, indexed by edge id.
+ */
+std::vector<double> estimateEdgeWeights(const IR::ControlGraph& cfg,
+                                        const LayoutParams& params = {});
+
+/**
+ * Compute a block order using Pettis-Hansen style chain merging: edges are visited from
+ * hottest to coldest and joined into fall-through chains whenever the source ends a chain
+ * and the destination starts one. Chains are then placed starting from the entry, each
+ * time picking the chain most strongly connected to what has been placed so far, with
+ * cold chains sunk to the end.
+ */
+BlockLayout layoutBlocks(const IR::ControlGraph& cfg, const LayoutParams& params = {});
+
+} // namespace Codegen
+
+#endif // BLOCK_LAYOUT_H
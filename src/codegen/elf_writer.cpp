@@ -0,0 +1,363 @@
+#include "elf_writer.h"
+
+#include <elf.h>
+
+#include <cstring>
+
+#include "debug_macros.h"
+
+using namespace std;
+
+namespace Codegen {
+
+namespace {
+
+// section header indices. Relocation sections follow .strtab, one for each section with
+// relocations, then come .note.GNU-stack and .shstrtab.
+constexpr uint16_t SHN_FIRST = 1;
+constexpr uint16_t SHN_SYMTAB = SHN_FIRST + ElfWriter::NUM_SECTIONS;
+constexpr uint16_t SHN_STRTAB = SHN_SYMTAB + 1;
+
+const char* const SECTION_NAMES[] = {".text", ".data", ".rodata", ".bss"};
+
+// every name in .shstrtab, with the offset of each name
+const char SHSTRTAB[] = "\0.text\0.data\0.rodata\0.bss\0.symtab\0.strtab\0.rela.text\0"
+                        ".rela.data\0.rela.rodata\0.note.GNU-stack\0.shstrtab";
+
+uint32_t shstrOffset(const char* name) {
+    for (size_t i = 1; i < sizeof(SHSTRTAB); i += strlen(SHSTRTAB + i) + 1) {
+        if (strcmp(SHSTRTAB + i, name) == 0) {
+            return static_cast<uint32_t>(i);
+        }
+    }
+    return 0;
+}
+
+uint64_t alignUp(uint64_t val, uint64_t align) {
+    return (val + align - 1) / align * align;
+}
+
+uint32_t relocType(RelocKind kind) {
+    switch (kind) {
+        case RelocKind::PC32:
+            return R_X86_64_PC32;
+        case RelocKind::PLT32:
+            return R_X86_64_PLT32;
+        case RelocKind::ABS64:
+            return R_X86_64_64;
+    }
+    return R_X86_64_NONE;
+}
+
+} // namespace
+
+ElfWriter::SymbolId ElfWriter::addSymbol(std::string name, Binding binding) {
+    symbols.push_back({binding, false, false, Section::TEXT, 0, 0});
+    names.push_back(move(name));
+    return static_cast<SymbolId>(symbols.size() - 1);
+}
+
+ArrayRef<std::string> ElfWriter::symbolNames() const noexcept {
+    return names;
+}
+
+uint64_t ElfWriter::place(Section section, uint64_t size, uint32_t align) {
+    SectionData& sec = sections[static_cast<size_t>(section)];
+    sec.align = max(sec.align, align);
+    uint64_t offset = alignUp(sec.size, align);
+    sec.size = offset + size;
+    return offset;
+}
+
+void ElfWriter::define(SymbolId sym, Section section, uint64_t offset, uint64_t size,
+                       bool isFunc) {
+    BOUND_CHK_LT(sym, symbols.size());
+    Symbol& symbol = symbols[sym];
+    ENSURE(!symbol.defined);
+    symbol.defined = true;
+    symbol.isFunc = isFunc;
+    symbol.section = section;
+    symbol.offset = offset;
+    symbol.size = size;
+}
+
+void ElfWriter::addFunction(SymbolId sym, FunctionCode code) {
+    uint64_t offset = place(Section::TEXT, code.bytes.size(), FUNC_ALIGN);
+    define(sym, Section::TEXT, offset, code.bytes.size(), true);
+    functions.push_back({sym, offset, move(code)});
+}
+
+void ElfWriter::addData(SymbolId sym, Section section, ArrayRef<uint8_t> bytes,
+                        uint32_t align, ArrayRef<Reloc> relocs) {
+    ENSURE(section == Section::DATA || section == Section::RODATA);
+    SectionData& sec = sections[static_cast<size_t>(section)];
+    uint64_t offset = place(section, bytes.size(), align);
+    define(sym, section, offset, bytes.size(), false);
+    sec.bytes.resize(offset);
+    sec.bytes.insert(sec.bytes.end(), bytes.begin(), bytes.end());
+    for (Reloc reloc : relocs) {
+        reloc.offset += static_cast<uint32_t>(offset);
+        sec.relocs.push_back(reloc);
+    }
+}
+
+void ElfWriter::addBss(SymbolId sym, uint64_t size, uint32_t align) {
+    uint64_t offset = place(Section::BSS, size, align);
+    define(sym, Section::BSS, offset, size, false);
+}
+
+ElfWriter::Layout ElfWriter::layout() const {
+    Layout lay;
+    uint64_t pos = sizeof(Elf64_Ehdr);
+    for (size_t i = 0; i < NUM_SECTIONS; ++i) {
+        if (static_cast<Section>(i) == Section::BSS) {
+            lay.sectionOff[i] = pos;
+            continue;
+        }
+        pos = alignUp(pos, sections[i].align);
+        lay.sectionOff[i] = pos;
+        pos += sections[i].size;
+    }
+
+    // locals first, then globals and undefined symbols, after the null symbol
+    lay.elfIndex.resize(symbols.size());
+    uint32_t next = 1;
+    lay.strtabSize = 1;
+    for (int pass = 0; pass < 2; ++pass) {
+        if (pass == 1) {
+            lay.firstGlobal = next;
+        }
+        for (size_t i = 0; i < symbols.size(); ++i) {
+            bool local = symbols[i].binding == Binding::LOCAL && symbols[i].defined;
+            if (local == (pass == 0)) {
+                lay.elfIndex[i] = next++;
+                lay.strtabSize += names[i].size() + 1;
+            }
+        }
+    }
+    pos = alignUp(pos, 8);
+    lay.symtabOff = pos;
+    pos += static_cast<uint64_t>(next) * sizeof(Elf64_Sym);
+    lay.strtabOff = pos;
+    pos += lay.strtabSize;
+
+    lay.numShdrs = SHN_STRTAB + 1;
+    pos = alignUp(pos, 8);
+    for (size_t i = 0; i < NUM_SECTIONS; ++i) {
+        lay.relaOff[i] = pos;
+        size_t count = sections[i].relocs.size();
+        if (static_cast<Section>(i) == Section::TEXT) {
+            count = 0;
+            for (const Function& func : functions) {
+                count += func.code.relocs.size();
+            }
+        }
+        if (count) {
+            pos += count * sizeof(Elf64_Rela);
+            ++lay.numShdrs;
+        }
+    }
+    // .note.GNU-stack and .shstrtab
+    lay.numShdrs += 2;
+    lay.shstrtabOff = pos;
+    pos += sizeof(SHSTRTAB);
+    pos = alignUp(pos, 8);
+    lay.shdrOff = pos;
+    pos += static_cast<uint64_t>(lay.numShdrs) * sizeof(Elf64_Shdr);
+    lay.total = pos;
+    return lay;
+}
+
+Rope ElfWriter::object() const {
+    Layout lay = layout();
+    Rope out;
+    auto padTo = [&out](uint64_t offset, char fill) {
+        ENSURE(offset >= out.size());
+        out.fill(fill, offset - out.size());
+    };
+
+    Elf64_Ehdr ehdr{};
+    memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+    ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+    ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+    ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr.e_ident[EI_OSABI] = ELFOSABI_NONE;
+    ehdr.e_type = ET_REL;
+    ehdr.e_machine = EM_X86_64;
+    ehdr.e_version = EV_CURRENT;
+    ehdr.e_shoff = lay.shdrOff;
+    ehdr.e_ehsize = sizeof(Elf64_Ehdr);
+    ehdr.e_shentsize = sizeof(Elf64_Shdr);
+    ehdr.e_shnum = lay.numShdrs;
+    ehdr.e_shstrndx = lay.numShdrs - 1;
+    out.append(&ehdr, sizeof(ehdr));
+
+    // section contents; the padding between functions is filled with int3
+    uint64_t textOff = lay.sectionOff[static_cast<size_t>(Section::TEXT)];
+    padTo(textOff, 0);
+    for (const Function& func : functions) {
+        padTo(textOff + func.offset, '\xcc');
+        out.appendRef(func.code.bytes.data(), func.code.bytes.size());
+    }
+    padTo(textOff + sections[static_cast<size_t>(Section::TEXT)].size, '\xcc');
+    for (Section section : {Section::DATA, Section::RODATA}) {
+        const SectionData& sec = sections[static_cast<size_t>(section)];
+        padTo(lay.sectionOff[static_cast<size_t>(section)], 0);
+        out.appendRef(sec.bytes.data(), sec.bytes.size());
+    }
+
+    // symbol and string tables
+    vector<Elf64_Sym> syms((lay.strtabOff - lay.symtabOff) / sizeof(Elf64_Sym));
+    Rope strtab;
+    strtab.push_back('\0');
+    for (size_t i = 0; i < symbols.size(); ++i) {
+        const Symbol& symbol = symbols[i];
+        Elf64_Sym& sym = syms[lay.elfIndex[i]];
+        sym.st_name = static_cast<uint32_t>(strtab.size());
+        strtab << names[i] << '\0';
+        unsigned char bind = symbol.binding == Binding::LOCAL ? STB_LOCAL : STB_GLOBAL;
+        unsigned char type = STT_NOTYPE;
+        if (symbol.defined) {
+            type = symbol.isFunc ? STT_FUNC : STT_OBJECT;
+            sym.st_shndx = SHN_FIRST + static_cast<uint16_t>(symbol.section);
+            sym.st_value = symbol.offset;
+            sym.st_size = symbol.size;
+        } else {
+            // an undefined local can't be resolved by anyone
+            bind = STB_GLOBAL;
+            sym.st_shndx = SHN_UNDEF;
+        }
+        sym.st_info = ELF64_ST_INFO(bind, type);
+    }
+    padTo(lay.symtabOff, 0);
+    out.append(syms.data(), syms.size() * sizeof(Elf64_Sym));
+    out.splice(move(strtab));
+
+    // relocations
+    auto writeRela = [&](const Reloc& reloc, uint64_t base) {
+        Elf64_Rela rela{};
+        rela.r_offset = base + reloc.offset;
+        rela.r_info = ELF64_R_INFO(lay.elfIndex[reloc.symbol], relocType(reloc.kind));
+        rela.r_addend = reloc.addend;
+        out.append(&rela, sizeof(rela));
+    };
+    uint64_t relaEnd[NUM_SECTIONS];
+    for (size_t i = 0; i < NUM_SECTIONS; ++i) {
+        padTo(lay.relaOff[i], 0);
+        if (static_cast<Section>(i) == Section::TEXT) {
+            for (const Function& func : functions) {
+                for (const Reloc& reloc : func.code.relocs) {
+                    writeRela(reloc, func.offset);
+                }
+            }
+        } else {
+            for (const Reloc& reloc : sections[i].relocs) {
+                writeRela(reloc, 0);
+            }
+        }
+        relaEnd[i] = out.size();
+    }
+    padTo(lay.shstrtabOff, 0);
+    out.append(SHSTRTAB, sizeof(SHSTRTAB));
+
+    // section headers
+    vector<Elf64_Shdr> shdrs(lay.numShdrs);
+    for (size_t i = 0; i < NUM_SECTIONS; ++i) {
+        Elf64_Shdr& shdr = shdrs[SHN_FIRST + i];
+        Section section = static_cast<Section>(i);
+        shdr.sh_name = shstrOffset(SECTION_NAMES[i]);
+        shdr.sh_type = section == Section::BSS ? SHT_NOBITS : SHT_PROGBITS;
+        shdr.sh_flags = SHF_ALLOC;
+        if (section == Section::TEXT) {
+            shdr.sh_flags |= SHF_EXECINSTR;
+        } else if (section != Section::RODATA) {
+            shdr.sh_flags |= SHF_WRITE;
+        }
+        shdr.sh_offset = lay.sectionOff[i];
+        shdr.sh_size = sections[i].size;
+        shdr.sh_addralign = sections[i].align;
+    }
+    Elf64_Shdr& symtab = shdrs[SHN_SYMTAB];
+    symtab.sh_name = shstrOffset(".symtab");
+    symtab.sh_type = SHT_SYMTAB;
+    symtab.sh_offset = lay.symtabOff;
+    symtab.sh_size = lay.strtabOff - lay.symtabOff;
+    symtab.sh_link = SHN_STRTAB;
+    symtab.sh_info = lay.firstGlobal;
+    symtab.sh_addralign = 8;
+    symtab.sh_entsize = sizeof(Elf64_Sym);
+    Elf64_Shdr& strtabHdr = shdrs[SHN_STRTAB];
+    strtabHdr.sh_name = shstrOffset(".strtab");
+    strtabHdr.sh_type = SHT_STRTAB;
+    strtabHdr.sh_offset = lay.strtabOff;
+    strtabHdr.sh_size = lay.strtabSize;
+    strtabHdr.sh_addralign = 1;
+    uint16_t idx = SHN_STRTAB + 1;
+    for (size_t i = 0; i < NUM_SECTIONS; ++i) {
+        if (relaEnd[i] == lay.relaOff[i]) {
+            continue;
+        }
+        Elf64_Shdr& shdr = shdrs[idx++];
+        shdr.sh_name = shstrOffset((string(".rela") + SECTION_NAMES[i]).c_str());
+        shdr.sh_type = SHT_RELA;
+        shdr.sh_flags = SHF_INFO_LINK;
+        shdr.sh_offset = lay.relaOff[i];
+        shdr.sh_size = relaEnd[i] - lay.relaOff[i];
+        shdr.sh_link = SHN_SYMTAB;
+        shdr.sh_info = SHN_FIRST + static_cast<uint32_t>(i);
+        shdr.sh_addralign = 8;
+        shdr.sh_entsize = sizeof(Elf64_Rela);
+    }
+    // an empty .note.GNU-stack keeps the linker from making the stack executable
+    Elf64_Shdr& note = shdrs[idx++];
+    note.sh_name = shstrOffset(".note.GNU-stack");
+    note.sh_type = SHT_PROGBITS;
+    note.sh_offset = lay.shstrtabOff;
+    note.sh_addralign = 1;
+    Elf64_Shdr& shstrtab = shdrs[idx];
+    shstrtab.sh_name = shstrOffset(".shstrtab");
+    shstrtab.sh_type = SHT_STRTAB;
+    shstrtab.sh_offset = lay.shstrtabOff;
+    shstrtab.sh_size = sizeof(SHSTRTAB);
+    shstrtab.sh_addralign = 1;
+    padTo(lay.shdrOff, 0);
+    out.append(shdrs.data(), shdrs.size() * sizeof(Elf64_Shdr));
+    ENSURE(out.size() == lay.total);
+    return out;
+}
+
+std::size_t ElfWriter::objectSize() const {
+    return layout().total;
+}
+
+void ElfWriter::writeTo(uint8_t* out) const {
+    object().copyTo(out);
+}
+
+std::vector<uint8_t> ElfWriter::finish() const {
+    vector<uint8_t> out(objectSize());
+    writeTo(out.data());
+    return out;
+}
+
+bool ElfWriter::writeFile(const std::string& path, std::string& error) const {
+    return object().writeFile(path, error);
+}
+
+Rope ElfWriter::listing() const {
+    Rope text;
+    for (const Function& func : functions) {
+        if (func.code.listing.empty()) {
+            continue;
+        }
+        const string& name = names[func.sym];
+        if (symbols[func.sym].binding == Binding::GLOBAL) {
+            text << "    .globl " << name << '\n';
+        }
+        text << name << ":\n";
+        text.appendRef(func.code.listing);
+    }
+    return text;
+}
+
+} // namespace Codegen
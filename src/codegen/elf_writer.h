@@ -0,0 +1,163 @@
+/**
+ * ELF64 relocatable object writer for x86-64.
+ *
+ * Symbols are declared up front, so that functions referring to each other can be
+ * encoded in parallel against stable symbol ids. The finished object is laid out once and
+ * emitted as a Rope in file order: headers and tables go into its chunks, while function
+ * code is referenced where the encoders left it, so writing the object with writev()
+ * copies no code at all.
+ */
+#ifndef ELF_WRITER_H
+#define ELF_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "codegen/x86_encoder.h"
+#include "fds/arrayref.h"
+#include "fds/rope.h"
+
+namespace Codegen {
+
+class JitImage;
+
+class ElfWriter {
+public:
+    using SymbolId = uint32_t;
+
+    enum class Section : uint8_t
+    {
+        TEXT,
+        DATA,
+        RODATA,
+        BSS,
+    };
+    static constexpr std::size_t NUM_SECTIONS = 4;
+
+    enum class Binding : uint8_t
+    {
+        LOCAL,
+        GLOBAL,
+    };
+
+private:
+    static constexpr uint32_t FUNC_ALIGN = 16;
+
+    struct Symbol {
+        Binding binding;
+        bool defined;
+        bool isFunc;
+        Section section;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct SectionData {
+        // contents, except for .text, whose functions are kept apart until written
+        std::vector<uint8_t> bytes;
+        // size, including .text functions and .bss
+        uint64_t size = 0;
+        uint32_t align = 1;
+        // relocations with offsets relative to the section
+        std::vector<Reloc> relocs;
+    };
+
+    struct Function {
+        SymbolId sym;
+        // offset in .text
+        uint64_t offset;
+        FunctionCode code;
+    };
+
+    /**
+     * File offsets of everything in the object, and the order of the symbol table.
+     */
+    struct Layout {
+        uint64_t sectionOff[NUM_SECTIONS];
+        uint64_t relaOff[NUM_SECTIONS];
+        uint64_t symtabOff;
+        uint64_t strtabOff;
+        uint64_t strtabSize;
+        uint64_t shstrtabOff;
+        uint64_t shdrOff;
+        uint64_t total;
+        uint16_t numShdrs;
+        // ELF symbol table index of each symbol id
+        std::vector<uint32_t> elfIndex;
+        // index of the first global symbol, as all locals must come first
+        uint32_t firstGlobal;
+    };
+
+    std::vector<Symbol> symbols;
+    // kept apart from symbols so the encoders can list them by id
+    std::vector<std::string> names;
+    SectionData sections[NUM_SECTIONS];
+    std::vector<Function> functions;
+
+    // loads the sections into memory instead of writing them out
+    friend class JitImage;
+
+    uint64_t place(Section section, uint64_t size, uint32_t align);
+    void define(SymbolId sym, Section section, uint64_t offset, uint64_t size,
+                bool isFunc);
+    Layout layout() const;
+
+public:
+    /**
+     * Declare a symbol. It stays undefined, i.e. external, unless code or data is added
+     * for it. Symbols must be declared before encoding the functions that refer to them.
+     */
+    SymbolId addSymbol(std::string name, Binding binding = Binding::GLOBAL);
+    /**
+     * @return the names of all symbols, indexed by id, for X86Encoder listings.
+     */
+    ArrayRef<std::string> symbolNames() const noexcept;
+
+    /**
+     * Append the code of a function to .text and define sym at it. Relocation symbol ids
+     * in the code are the ids returned by addSymbol.
+     */
+    void addFunction(SymbolId sym, FunctionCode code);
+    /**
+     * Append initialized data to .data or .rodata and define sym at it.
+     *
+     * @param relocs relocations within bytes, e.g. for pointers to other symbols.
+     */
+    void addData(SymbolId sym, Section section, ArrayRef<uint8_t> bytes, uint32_t align,
+                 ArrayRef<Reloc> relocs = {});
+    /**
+     * Reserve zero initialized space in .bss and define sym at it.
+     */
+    void addBss(SymbolId sym, uint64_t size, uint32_t align);
+
+    /**
+     * @return the object file. It refers to the function code held by the writer, so the
+     * writer must outlive it and not be added to meanwhile.
+     */
+    Rope object() const;
+    /**
+     * @return the size of the object file.
+     */
+    std::size_t objectSize() const;
+    /**
+     * Write the object file.
+     *
+     * @param out buffer of objectSize() bytes.
+     */
+    void writeTo(uint8_t* out) const;
+    std::vector<uint8_t> finish() const;
+    bool writeFile(const std::string& path, std::string& error) const;
+
+    /**
+     * @return the assembly listings of all functions, labeled with their symbols. Only
+     * functions encoded with listing enabled contribute. As with object(), the listings
+     * are referenced rather than copied.
+     */
+    Rope listing() const;
+};
+
+} // namespace Codegen
+
+#endif // ELF_WRITER_H
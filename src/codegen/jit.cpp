@@ -0,0 +1,223 @@
+#include "jit.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "debug_macros.h"
+
+using namespace std;
+
+namespace Codegen {
+
+namespace {
+
+// jmp qword ptr [rip + disp32], padded with int3
+constexpr size_t STUB_SIZE = 8;
+constexpr uint8_t LEA_OPCODE = 0x8d;
+constexpr uint8_t MOV_LOAD_OPCODE = 0x8b;
+
+uint64_t alignUp(uint64_t val, uint64_t align) {
+    return (val + align - 1) / align * align;
+}
+
+bool fitsRel32(int64_t val) {
+    return val >= INT32_MIN && val <= INT32_MAX;
+}
+
+// the host is little-endian x86-64, like the code
+void put32(uint8_t* at, int64_t val) {
+    int32_t narrow = static_cast<int32_t>(val);
+    memcpy(at, &narrow, sizeof(narrow));
+}
+
+void put64(uint8_t* at, uint64_t val) {
+    memcpy(at, &val, sizeof(val));
+}
+
+int64_t addr(const void* ptr) {
+    return static_cast<int64_t>(reinterpret_cast<uintptr_t>(ptr));
+}
+
+} // namespace
+
+JitImage::JitImage(JitImage&& other) noexcept
+    : base{other.base}, mapped{other.mapped}, names{move(other.names)},
+      addresses{move(other.addresses)} {
+    other.base = nullptr;
+    other.mapped = 0;
+}
+
+JitImage& JitImage::operator=(JitImage&& other) noexcept {
+    if (this != &other) {
+        if (base) {
+            munmap(base, mapped);
+        }
+        base = other.base;
+        mapped = other.mapped;
+        names = move(other.names);
+        addresses = move(other.addresses);
+        other.base = nullptr;
+        other.mapped = 0;
+    }
+    return *this;
+}
+
+JitImage::~JitImage() {
+    if (base) {
+        munmap(base, mapped);
+    }
+}
+
+Util::Expected<JitImage> JitImage::load(const ElfWriter& module,
+                                        const Resolver& resolve) {
+    using Section = ElfWriter::Section;
+    auto fail = [](string msg) { return Util::Unexpected(Util::Error(move(msg))); };
+    auto sec = [&module](Section section) -> const ElfWriter::SectionData& {
+        return module.sections[static_cast<size_t>(section)];
+    };
+    const vector<ElfWriter::Symbol>& symbols = module.symbols;
+    uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+
+    // every undefined symbol gets a jump stub and a slot in the address table
+    constexpr uint32_t NO_SLOT = ~static_cast<uint32_t>(0);
+    vector<uint32_t> slot(symbols.size(), NO_SLOT);
+    uint32_t numSlots = 0;
+    for (size_t i = 0; i < symbols.size(); ++i) {
+        if (!symbols[i].defined) {
+            slot[i] = numSlots++;
+        }
+    }
+
+    // three page aligned segments: code (.text and the stubs), read-only (.rodata and the
+    // address table) and writable (.data and .bss)
+    uint64_t off[ElfWriter::NUM_SECTIONS];
+    auto place = [&](Section section, uint64_t at) {
+        off[static_cast<size_t>(section)] = alignUp(at, sec(section).align);
+        return off[static_cast<size_t>(section)] + sec(section).size;
+    };
+    uint64_t stubOff = alignUp(place(Section::TEXT, 0), 16);
+    uint64_t codeEnd = alignUp(stubOff + numSlots * STUB_SIZE, page);
+    uint64_t tableOff = alignUp(place(Section::RODATA, codeEnd), sizeof(uint64_t));
+    uint64_t roEnd = alignUp(tableOff + numSlots * sizeof(uint64_t), page);
+    uint64_t end = place(Section::BSS, place(Section::DATA, roEnd));
+    uint64_t total = max(alignUp(end, page), page);
+
+    void* mem = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                     -1, 0);
+    if (mem == MAP_FAILED) {
+        return fail(string("cannot map memory for JIT code: ") + strerror(errno));
+    }
+    // from here on the image unmaps the memory on failure
+    JitImage image;
+    image.base = static_cast<uint8_t*>(mem);
+    image.mapped = total;
+    image.names = module.names;
+    image.addresses.resize(symbols.size());
+    uint8_t* base = image.base;
+
+    // section contents; the padding in the code segment is filled with int3
+    memset(base, 0xcc, codeEnd);
+    for (const ElfWriter::Function& func : module.functions) {
+        memcpy(base + func.offset, func.code.bytes.data(), func.code.bytes.size());
+    }
+    for (Section section : {Section::DATA, Section::RODATA}) {
+        const vector<uint8_t>& bytes = sec(section).bytes;
+        if (!bytes.empty()) {
+            memcpy(base + off[static_cast<size_t>(section)], bytes.data(), bytes.size());
+        }
+    }
+
+    // symbol addresses, stubs and the address table
+    for (size_t i = 0; i < symbols.size(); ++i) {
+        const ElfWriter::Symbol& sym = symbols[i];
+        if (sym.defined) {
+            uint64_t secOff = off[static_cast<size_t>(sym.section)];
+            image.addresses[i] = base + secOff + sym.offset;
+            continue;
+        }
+        const string& name = module.names[i];
+        void* target = resolve ? resolve(name) : dlsym(RTLD_DEFAULT, name.c_str());
+        if (!target) {
+            return fail("undefined symbol '" + name + "'");
+        }
+        image.addresses[i] = target;
+        uint8_t* entry = base + tableOff + slot[i] * sizeof(uint64_t);
+        put64(entry, reinterpret_cast<uintptr_t>(target));
+        uint8_t* stub = base + stubOff + slot[i] * STUB_SIZE;
+        stub[0] = 0xff;
+        stub[1] = 0x25;
+        put32(stub + 2, addr(entry) - addr(stub + 6));
+    }
+
+    // relocations, in place
+    auto apply = [&](const Reloc& reloc, uint8_t* field, bool inCode) -> bool {
+        BOUND_CHK_LT(reloc.symbol, symbols.size());
+        int64_t target = addr(image.addresses[reloc.symbol]);
+        if (reloc.kind == RelocKind::ABS64) {
+            put64(field, static_cast<uint64_t>(target + reloc.addend));
+            return true;
+        }
+        int64_t val = target + reloc.addend - addr(field);
+        uint32_t entry = slot[reloc.symbol];
+        if (!fitsRel32(val) && entry != NO_SLOT) {
+            if (reloc.kind == RelocKind::PLT32) {
+                target = addr(base + stubOff + entry * STUB_SIZE);
+            } else if (inCode && field[-2] == LEA_OPCODE && reloc.addend == -4) {
+                // lea reg, [rip + sym] becomes mov reg, [rip + table entry of sym]
+                field[-2] = MOV_LOAD_OPCODE;
+                target = addr(base + tableOff + entry * sizeof(uint64_t));
+            }
+            val = target + reloc.addend - addr(field);
+        }
+        if (!fitsRel32(val)) {
+            return false;
+        }
+        put32(field, val);
+        return true;
+    };
+    for (const ElfWriter::Function& func : module.functions) {
+        for (const Reloc& reloc : func.code.relocs) {
+            // the opcode of a rip-relative lea sits two bytes before its displacement
+            if (!apply(reloc, base + func.offset + reloc.offset, reloc.offset >= 2)) {
+                return fail("relocation against '" + module.names[reloc.symbol] +
+                            "' out of range");
+            }
+        }
+    }
+    for (Section section : {Section::DATA, Section::RODATA}) {
+        for (const Reloc& reloc : sec(section).relocs) {
+            uint8_t* field = base + off[static_cast<size_t>(section)] + reloc.offset;
+            if (!apply(reloc, field, false)) {
+                return fail("relocation against '" + module.names[reloc.symbol] +
+                            "' out of range");
+            }
+        }
+    }
+
+    if ((codeEnd > 0 && mprotect(base, codeEnd, PROT_READ | PROT_EXEC) != 0) ||
+        (roEnd > codeEnd && mprotect(base + codeEnd, roEnd - codeEnd, PROT_READ) != 0)) {
+        return fail(string("cannot protect JIT memory: ") + strerror(errno));
+    }
+    return Util::Expected<JitImage>(move(image));
+}
+
+void* JitImage::symbol(const std::string& name) const {
+    auto it = find(names.begin(), names.end(), name);
+    return it == names.end() ? nullptr : addresses[it - names.begin()];
+}
+
+Util::Expected<int> JitImage::runMain(int argc, char** argv) const {
+    auto entry = function<int(int, char**)>("main");
+    if (!entry) {
+        return Util::Unexpected(Util::Error("no main function to run"));
+    }
+    return entry(argc, argv);
+}
+
+} // namespace Codegen
@@ -0,0 +1,89 @@
+/**
+ * In-memory execution of generated code.
+ *
+ * A JitImage loads the functions and data collected in an ElfWriter straight into
+ * executable memory, without writing an object file, linking it or starting a process:
+ * the sections are copied into one anonymous mapping, relocations are applied in place,
+ * symbols left undefined are resolved in the running process (by default with dlsym, so
+ * generated code can call libc) and the pages are then protected as the sections require.
+ *
+ * Undefined symbols usually live more than 2GB away from the mapping, out of reach of the
+ * rel32 fields the encoder emits. Calls to them go through a jump stub, and rip-relative
+ * address loads of them are turned into loads from a table of addresses, much as a linker
+ * does with the GOT and PLT.
+ */
+#ifndef JIT_H
+#define JIT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "codegen/elf_writer.h"
+#include "util/expected.h"
+
+namespace Codegen {
+
+class JitImage {
+public:
+    /**
+     * Finds the address of a symbol that the module leaves undefined, or returns null.
+     */
+    using Resolver = std::function<void*(const std::string& name)>;
+
+private:
+    uint8_t* base = nullptr;
+    std::size_t mapped = 0;
+    std::vector<std::string> names;
+    std::vector<void*> addresses;
+
+    JitImage() = default;
+
+public:
+    JitImage(const JitImage&) = delete;
+    JitImage& operator=(const JitImage&) = delete;
+    JitImage(JitImage&& other) noexcept;
+    JitImage& operator=(JitImage&& other) noexcept;
+    ~JitImage();
+
+    /**
+     * Map the code and data of module into memory and link it.
+     *
+     * @param resolve resolver for undefined symbols; by default they are looked up in the
+     * running process with dlsym.
+     * @return the loaded image, or an error naming a symbol that could not be resolved or
+     * a reference that could not be relocated.
+     */
+    static Util::Expected<JitImage> load(const ElfWriter& module,
+                                         const Resolver& resolve = nullptr);
+
+    /**
+     * @return the address of a symbol of the module, or null if there is none. Undefined
+     * symbols give the address they were resolved to.
+     */
+    void* symbol(const std::string& name) const;
+    /**
+     * @return the address of function name, cast to the function pointer type Fn.
+     */
+    template <typename Fn> Fn* function(const std::string& name) const;
+
+    /**
+     * Call the module's int main(int, char**).
+     *
+     * @return the exit status returned by main, or an error if there is no main.
+     */
+    Util::Expected<int> runMain(int argc, char** argv) const;
+};
+
+////////////////////////////////////
+// template function implementations
+////////////////////////////////////
+template <typename Fn> Fn* JitImage::function(const std::string& name) const {
+    return reinterpret_cast<Fn*>(symbol(name));
+}
+
+} // namespace Codegen
+
+#endif // JIT_H
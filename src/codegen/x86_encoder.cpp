@@ -0,0 +1,359 @@
+#include "x86_encoder.h"
+
+#include "debug_macros.h"
+
+using namespace std;
+
+namespace Codegen {
+
+namespace {
+
+const char* const REG_NAMES[] = {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+                                 "r8",  "r9",  "r10", "r11", "r12", "r13", "r14", "r15"};
+const char* const REG32_NAMES[] = {
+    "eax", "ecx", "edx",  "ebx",  "esp",  "ebp",  "esi",  "edi",
+    "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"};
+// byte registers as addressed with a REX prefix, which setcc always uses for 4-7
+const char* const REG8_NAMES[] = {
+    "al",  "cl",  "dl",   "bl",   "spl",  "bpl",  "sil",  "dil",
+    "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"};
+const char* const COND_NAMES[] = {"o", "no", "b",  "ae", "e", "ne", "be", "a",
+                                  "s", "ns", "p", "np", "l", "ge", "le", "g"};
+
+unsigned num(Reg reg) {
+    return static_cast<unsigned>(reg);
+}
+
+string name(Reg reg) {
+    return REG_NAMES[num(reg)];
+}
+
+string name(Mem mem) {
+    string str = "qword ptr [" + name(mem.base);
+    if (mem.disp > 0) {
+        str += " + " + to_string(mem.disp);
+    } else if (mem.disp < 0) {
+        str += " - " + to_string(-static_cast<int64_t>(mem.disp));
+    }
+    return str + "]";
+}
+
+const char* name(AluOp op) {
+    switch (op) {
+        case AluOp::ADD:
+            return "add";
+        case AluOp::OR:
+            return "or";
+        case AluOp::AND:
+            return "and";
+        case AluOp::SUB:
+            return "sub";
+        case AluOp::XOR:
+            return "xor";
+        case AluOp::CMP:
+            return "cmp";
+    }
+    return "?";
+}
+
+const char* name(ShiftOp op) {
+    switch (op) {
+        case ShiftOp::SHL:
+            return "shl";
+        case ShiftOp::SHR:
+            return "shr";
+        case ShiftOp::SAR:
+            return "sar";
+    }
+    return "?";
+}
+
+} // namespace
+
+X86Encoder::X86Encoder(bool listing, ArrayRef<std::string> symbolNames)
+    : listingEn{listing}, symbolNames{symbolNames} {
+}
+
+std::size_t X86Encoder::size() const noexcept {
+    return out.bytes.size();
+}
+
+void X86Encoder::byte(uint8_t val) {
+    out.bytes.push_back(val);
+}
+
+void X86Encoder::imm32(int32_t val) {
+    for (int i = 0; i < 4; ++i) {
+        byte(static_cast<uint8_t>(static_cast<uint32_t>(val) >> (8 * i)));
+    }
+}
+
+void X86Encoder::imm64(int64_t val) {
+    for (int i = 0; i < 8; ++i) {
+        byte(static_cast<uint8_t>(static_cast<uint64_t>(val) >> (8 * i)));
+    }
+}
+
+void X86Encoder::rex(bool w, unsigned reg, unsigned rm, bool force) {
+    uint8_t prefix = 0x40 | (w ? 8 : 0) | ((reg >> 3) << 2) | (rm >> 3);
+    if (prefix != 0x40 || force) {
+        byte(prefix);
+    }
+}
+
+void X86Encoder::modrmReg(unsigned reg, Reg rm) {
+    byte(0xc0 | ((reg & 7) << 3) | (num(rm) & 7));
+}
+
+void X86Encoder::modrmMem(unsigned reg, Mem mem) {
+    unsigned base = num(mem.base) & 7;
+    // rbp/r13 as base can't use the no-displacement form, which means rip-relative
+    unsigned mod = 2;
+    if (mem.disp == 0 && base != 5) {
+        mod = 0;
+    } else if (mem.disp >= INT8_MIN && mem.disp <= INT8_MAX) {
+        mod = 1;
+    }
+    byte((mod << 6) | ((reg & 7) << 3) | base);
+    if (base == 4) {
+        // rsp/r12 as base need a SIB byte
+        byte(0x24);
+    }
+    if (mod == 1) {
+        byte(static_cast<uint8_t>(mem.disp));
+    } else if (mod == 2) {
+        imm32(mem.disp);
+    }
+}
+
+void X86Encoder::list(const std::string& text) {
+    if (listingEn) {
+        out.listing << "    " << text << '\n';
+    }
+}
+
+std::string X86Encoder::symbolName(uint32_t id) const {
+    return id < symbolNames.size() ? symbolNames[id] : "sym" + to_string(id);
+}
+
+X86Encoder::Label X86Encoder::newLabel() {
+    labels.push_back(UNBOUND);
+    return static_cast<Label>(labels.size() - 1);
+}
+
+void X86Encoder::bind(Label label) {
+    BOUND_CHK_LT(label, labels.size());
+    labels[label] = static_cast<uint32_t>(size());
+    if (listingEn) {
+        out.listing << ".L" << to_string(label) << ":\n";
+    }
+}
+
+void X86Encoder::mov(Reg dst, Reg src) {
+    rex(true, num(src), num(dst));
+    byte(0x89);
+    modrmReg(num(src), dst);
+    list("mov " + name(dst) + ", " + name(src));
+}
+
+void X86Encoder::movImm(Reg dst, int64_t val) {
+    if (val >= 0 && val <= UINT32_MAX) {
+        // writing the 32-bit register zero extends
+        rex(false, 0, num(dst));
+        byte(0xb8 + (num(dst) & 7));
+        imm32(static_cast<int32_t>(static_cast<uint32_t>(val)));
+    } else if (val >= INT32_MIN && val <= INT32_MAX) {
+        rex(true, 0, num(dst));
+        byte(0xc7);
+        modrmReg(0, dst);
+        imm32(static_cast<int32_t>(val));
+    } else {
+        rex(true, 0, num(dst));
+        byte(0xb8 + (num(dst) & 7));
+        imm64(val);
+    }
+    list("mov " + name(dst) + ", " + to_string(val));
+}
+
+void X86Encoder::load(Reg dst, Mem src) {
+    rex(true, num(dst), num(src.base));
+    byte(0x8b);
+    modrmMem(num(dst), src);
+    list("mov " + name(dst) + ", " + name(src));
+}
+
+void X86Encoder::store(Mem dst, Reg src) {
+    rex(true, num(src), num(dst.base));
+    byte(0x89);
+    modrmMem(num(src), dst);
+    list("mov " + name(dst) + ", " + name(src));
+}
+
+void X86Encoder::lea(Reg dst, Mem src) {
+    rex(true, num(dst), num(src.base));
+    byte(0x8d);
+    modrmMem(num(dst), src);
+    list("lea " + name(dst) + ", " + name(src));
+}
+
+void X86Encoder::leaSym(Reg dst, uint32_t symbol, int32_t addend) {
+    rex(true, num(dst), 0);
+    byte(0x8d);
+    // mod 00, rm 101: rip-relative disp32
+    byte(((num(dst) & 7) << 3) | 5);
+    // the displacement is relative to the end of the instruction, 4 bytes on
+    out.relocs.push_back({static_cast<uint32_t>(size()), symbol, RelocKind::PC32,
+                          static_cast<int64_t>(addend) - 4});
+    imm32(0);
+    list("lea " + name(dst) + ", [rip + " + symbolName(symbol) + "]");
+}
+
+void X86Encoder::alu(AluOp op, Reg dst, Reg src) {
+    rex(true, num(src), num(dst));
+    // the r/m, reg form of each operation is at 8 * extension + 1
+    byte(static_cast<uint8_t>(op) * 8 + 1);
+    modrmReg(num(src), dst);
+    list(string(name(op)) + " " + name(dst) + ", " + name(src));
+}
+
+void X86Encoder::aluImm(AluOp op, Reg dst, int32_t imm) {
+    rex(true, 0, num(dst));
+    if (imm >= INT8_MIN && imm <= INT8_MAX) {
+        byte(0x83);
+        modrmReg(static_cast<unsigned>(op), dst);
+        byte(static_cast<uint8_t>(imm));
+    } else {
+        byte(0x81);
+        modrmReg(static_cast<unsigned>(op), dst);
+        imm32(imm);
+    }
+    list(string(name(op)) + " " + name(dst) + ", " + to_string(imm));
+}
+
+void X86Encoder::imul(Reg dst, Reg src) {
+    rex(true, num(dst), num(src));
+    byte(0x0f);
+    byte(0xaf);
+    modrmReg(num(dst), src);
+    list("imul " + name(dst) + ", " + name(src));
+}
+
+void X86Encoder::shiftCl(ShiftOp op, Reg dst) {
+    rex(true, 0, num(dst));
+    byte(0xd3);
+    modrmReg(static_cast<unsigned>(op), dst);
+    list(string(name(op)) + " " + name(dst) + ", cl");
+}
+
+void X86Encoder::test(Reg a, Reg b) {
+    rex(true, num(b), num(a));
+    byte(0x85);
+    modrmReg(num(b), a);
+    list("test " + name(a) + ", " + name(b));
+}
+
+void X86Encoder::setcc(Cond cond, Reg dst) {
+    // without a REX prefix, byte registers 4-7 would be ah, ch, dh and bh
+    rex(false, 0, num(dst), num(dst) >= 4);
+    byte(0x0f);
+    byte(0x90 + static_cast<uint8_t>(cond));
+    modrmReg(0, dst);
+    // movzx dst32, dst8
+    rex(false, num(dst), num(dst), num(dst) >= 4);
+    byte(0x0f);
+    byte(0xb6);
+    modrmReg(num(dst), dst);
+    list(string("set") + COND_NAMES[static_cast<unsigned>(cond)] + " " +
+         REG8_NAMES[num(dst)]);
+    list(string("movzx ") + REG32_NAMES[num(dst)] + ", " + REG8_NAMES[num(dst)]);
+}
+
+void X86Encoder::cqo() {
+    byte(0x48);
+    byte(0x99);
+    list("cqo");
+}
+
+void X86Encoder::idiv(Reg src) {
+    rex(true, 0, num(src));
+    byte(0xf7);
+    modrmReg(7, src);
+    list("idiv " + name(src));
+}
+
+void X86Encoder::neg(Reg dst) {
+    rex(true, 0, num(dst));
+    byte(0xf7);
+    modrmReg(3, dst);
+    list("neg " + name(dst));
+}
+
+void X86Encoder::push(Reg src) {
+    rex(false, 0, num(src));
+    byte(0x50 + (num(src) & 7));
+    list("push " + name(src));
+}
+
+void X86Encoder::pop(Reg dst) {
+    rex(false, 0, num(dst));
+    byte(0x58 + (num(dst) & 7));
+    list("pop " + name(dst));
+}
+
+void X86Encoder::call(Reg target) {
+    rex(false, 0, num(target));
+    byte(0xff);
+    modrmReg(2, target);
+    list("call " + name(target));
+}
+
+void X86Encoder::callSym(uint32_t symbol) {
+    byte(0xe8);
+    out.relocs.push_back(
+        {static_cast<uint32_t>(size()), symbol, RelocKind::PLT32, -4});
+    imm32(0);
+    list("call " + symbolName(symbol));
+}
+
+void X86Encoder::jmp(Label target) {
+    BOUND_CHK_LT(target, labels.size());
+    byte(0xe9);
+    fixups.push_back({static_cast<uint32_t>(size()), target});
+    imm32(0);
+    list("jmp .L" + to_string(target));
+}
+
+void X86Encoder::jcc(Cond cond, Label target) {
+    BOUND_CHK_LT(target, labels.size());
+    byte(0x0f);
+    byte(0x80 + static_cast<uint8_t>(cond));
+    fixups.push_back({static_cast<uint32_t>(size()), target});
+    imm32(0);
+    list(string("j") + COND_NAMES[static_cast<unsigned>(cond)] + " .L" +
+         to_string(target));
+}
+
+void X86Encoder::ret() {
+    byte(0xc3);
+    list("ret");
+}
+
+FunctionCode X86Encoder::finish() {
+    for (const Fixup& fixup : fixups) {
+        uint32_t target = labels[fixup.label];
+        ENSURE(target != UNBOUND);
+        // relative to the end of the rel32 field, which ends every jump
+        int32_t rel = static_cast<int32_t>(target - (fixup.offset + 4));
+        for (int i = 0; i < 4; ++i) {
+            out.bytes[fixup.offset + i] =
+                static_cast<uint8_t>(static_cast<uint32_t>(rel) >> (8 * i));
+        }
+    }
+    labels.clear();
+    fixups.clear();
+    FunctionCode code = move(out);
+    out = FunctionCode();
+    return code;
+}
+
+} // namespace Codegen
@@ -0,0 +1,272 @@
+/**
+ * Direct x86-64 machine code encoding.
+ *
+ * An X86Encoder emits the instructions of one function into its own buffer, so functions
+ * can be encoded on separate threads (see encodeParallel) and concatenated by the object
+ * writer afterwards. References to other functions and data are left as relocations
+ * against symbol ids handed out by the object writer before encoding starts. Jumps
+ * within the function go to labels and are always encoded with 32-bit displacements.
+ */
+#ifndef X86_ENCODER_H
+#define X86_ENCODER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fds/arrayref.h"
+#include "fds/rope.h"
+#include "util/timetrace.h"
+
+namespace Codegen {
+
+enum class Reg : uint8_t
+{
+    RAX,
+    RCX,
+    RDX,
+    RBX,
+    RSP,
+    RBP,
+    RSI,
+    RDI,
+    R8,
+    R9,
+    R10,
+    R11,
+    R12,
+    R13,
+    R14,
+    R15,
+};
+
+/**
+ * Condition codes, numbered as in the Jcc/SETcc opcodes.
+ */
+enum class Cond : uint8_t
+{
+    O,
+    NO,
+    B,
+    AE,
+    E,
+    NE,
+    BE,
+    A,
+    S,
+    NS,
+    P,
+    NP,
+    L,
+    GE,
+    LE,
+    G,
+};
+
+/**
+ * Two operand integer instructions, numbered by their opcode extension.
+ */
+enum class AluOp : uint8_t
+{
+    ADD = 0,
+    OR = 1,
+    AND = 4,
+    SUB = 5,
+    XOR = 6,
+    CMP = 7,
+};
+
+enum class ShiftOp : uint8_t
+{
+    SHL = 4,
+    SHR = 5,
+    SAR = 7,
+};
+
+/**
+ * A [base + disp] memory operand.
+ */
+struct Mem {
+    Reg base;
+    int32_t disp;
+};
+
+enum class RelocKind : uint8_t
+{
+    // 32-bit pc-relative reference to data
+    PC32,
+    // 32-bit pc-relative call, which the linker may route through the PLT
+    PLT32,
+    // absolute 64-bit address
+    ABS64,
+};
+
+/**
+ * A reference from the encoded bytes to a symbol that the object writer or linker
+ * resolves.
+ */
+struct Reloc {
+    // offset of the field to patch, relative to the start of the function (or data blob)
+    uint32_t offset;
+    // symbol id from the object writer
+    uint32_t symbol;
+    RelocKind kind;
+    int64_t addend;
+};
+
+/**
+ * The finished machine code of one function.
+ */
+struct FunctionCode {
+    std::vector<uint8_t> bytes;
+    std::vector<Reloc> relocs;
+    // textual assembly of the function, if the encoder was asked for it
+    Rope listing;
+};
+
+class X86Encoder {
+public:
+    using Label = uint32_t;
+
+private:
+    // label offsets, or UNBOUND
+    static constexpr uint32_t UNBOUND = ~static_cast<uint32_t>(0);
+
+    struct Fixup {
+        // offset of the rel32 field
+        uint32_t offset;
+        Label label;
+    };
+
+    FunctionCode out;
+    std::vector<uint32_t> labels;
+    std::vector<Fixup> fixups;
+    bool listingEn;
+    ArrayRef<std::string> symbolNames;
+
+    void byte(uint8_t val);
+    void imm32(int32_t val);
+    void imm64(int64_t val);
+    void rex(bool w, unsigned reg, unsigned rm, bool force = false);
+    void modrmReg(unsigned reg, Reg rm);
+    void modrmMem(unsigned reg, Mem mem);
+    void list(const std::string& text);
+    std::string symbolName(uint32_t id) const;
+
+public:
+    /**
+     * @param listing also produce Intel syntax assembly text of every instruction, for
+     * debugging the encoder and the code generator.
+     * @param symbolNames names the listing uses for symbol ids; ids without a name are
+     * shown as symN. The names are only read, so encoders may share them.
+     */
+    explicit X86Encoder(bool listing = false, ArrayRef<std::string> symbolNames = {});
+
+    std::size_t size() const noexcept;
+
+    Label newLabel();
+    /**
+     * Place label at the current position.
+     */
+    void bind(Label label);
+
+    void mov(Reg dst, Reg src);
+    /**
+     * Load a 64-bit immediate, using the shortest encoding for its value.
+     */
+    void movImm(Reg dst, int64_t val);
+    void load(Reg dst, Mem src);
+    void store(Mem dst, Reg src);
+    void lea(Reg dst, Mem src);
+    /**
+     * Load the address of a symbol, rip-relative.
+     */
+    void leaSym(Reg dst, uint32_t symbol, int32_t addend = 0);
+    void alu(AluOp op, Reg dst, Reg src);
+    void aluImm(AluOp op, Reg dst, int32_t imm);
+    void imul(Reg dst, Reg src);
+    void shiftCl(ShiftOp op, Reg dst);
+    void test(Reg a, Reg b);
+    /**
+     * Set dst to 1 if cond holds and 0 otherwise.
+     */
+    void setcc(Cond cond, Reg dst);
+    // sign extend rax into rdx:rax and divide it by src
+    void cqo();
+    void idiv(Reg src);
+    void neg(Reg dst);
+    void push(Reg src);
+    void pop(Reg dst);
+    void call(Reg target);
+    void callSym(uint32_t symbol);
+    void jmp(Label target);
+    void jcc(Cond cond, Label target);
+    void ret();
+
+    /**
+     * Resolve jumps to labels and hand out the code. All labels jumped to must have been
+     * bound. The encoder is empty afterwards.
+     */
+    FunctionCode finish();
+};
+
+/**
+ * Encode functions on a pool of threads, each with its own encoder.
+ *
+ * @tparam EncodeFn callable as encode(index, encoder). It is called concurrently and
+ * must not throw.
+ * @param count number of functions.
+ * @param listing whether the encoders produce assembly listings.
+ * @param symbolNames names of the symbol ids in the listings.
+ * @param threads maximum number of threads to use (0 picks the hardware concurrency).
+ * @return the code of every function, in index order.
+ */
+template <typename EncodeFn>
+std::vector<FunctionCode> encodeParallel(std::size_t count, EncodeFn encode,
+                                         bool listing = false,
+                                         ArrayRef<std::string> symbolNames = {},
+                                         unsigned threads = 0);
+
+////////////////////////////////////
+// template function implementations
+////////////////////////////////////
+template <typename EncodeFn>
+std::vector<FunctionCode> encodeParallel(std::size_t count, EncodeFn encode, bool listing,
+                                         ArrayRef<std::string> symbolNames,
+                                         unsigned threads) {
+    TIME_SCOPE("encode");
+    std::vector<FunctionCode> code(count);
+    std::atomic<std::size_t> next{0};
+
+    auto worker = [&]() {
+        TIME_SCOPE("encode_worker");
+        std::size_t idx;
+        while ((idx = next++) < count) {
+            X86Encoder enc(listing, symbolNames);
+            encode(idx, enc);
+            code[idx] = enc.finish();
+        }
+    };
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::size_t numThreads = std::min<std::size_t>(threads, count);
+    std::vector<std::thread> pool;
+    for (std::size_t i = 1; i < numThreads; ++i) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+    return code;
+}
+
+} // namespace Codegen
+
+#endif // X86_ENCODER_H
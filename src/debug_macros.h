@@ -50,7 +50,17 @@ public:
 #include <sstream>
 #endif
 
-#define UNUSED(x) ((void*)(x))
+// failed checks throw an AssertionError, or print the message and abort when exceptions
+// are disabled (-fno-exceptions)
+#ifdef __cpp_exceptions
+#define DEBUG_FAIL(msg) throw Debug::AssertionError(msg)
+#else
+#include <cstdlib>
+#include <iostream>
+#define DEBUG_FAIL(msg) (std::cerr << (msg) << std::endl, std::abort())
+#endif
+
+#define UNUSED(x) ((void)(x))
 
 #ifdef DEBUG_ENA_PRINT
 #include <iostream>
@@ -68,7 +78,7 @@ public:
             ss << "bound check failed at " << __FILE__ << ":" << __LINE__ << std::endl   \
                << "Index '" << (index) << "' >= bound '" << (bound) << "'.";             \
             DEBUG_PRINT(ss.str());                                                       \
-            throw Debug::AssertionError(ss.str());                                       \
+            DEBUG_FAIL(ss.str());                                                        \
         }                                                                                \
     } while (0)
 #define BOUND_CHK_LTE(index, bound)                                                      \
@@ -78,7 +88,7 @@ public:
             ss << "bound check failed at " << __FILE__ << ":" << __LINE__ << std::endl   \
                << "Index '" << (index) << "' > bound '" << (bound) << "'.";              \
             DEBUG_PRINT(ss.str());                                                       \
-            throw Debug::AssertionError(ss.str());                                       \
+            DEBUG_FAIL(ss.str());                                                        \
         }                                                                                \
     } while (0)
 #define BOUND_CHK_GT(index, bound)                                                       \
@@ -88,7 +98,7 @@ public:
             ss << "bound check failed at " << __FILE__ << ":" << __LINE__ << std::endl   \
                << "Index '" << (index) << "' <= bound '" << (bound) << "'.";             \
             DEBUG_PRINT(ss.str());                                                       \
-            throw Debug::AssertionError(ss.str());                                       \
+            DEBUG_FAIL(ss.str());                                                        \
         }                                                                                \
     } while (0)
 #define BOUND_CHK_GTE(index, bound)                                                      \
@@ -98,7 +108,7 @@ public:
             ss << "bound check failed at " << __FILE__ << ":" << __LINE__ << std::endl   \
                << "Index '" << (index) << "' < bound '" << (bound) << "'.";              \
             DEBUG_PRINT(ss.str());                                                       \
-            throw Debug::AssertionError(ss.str());                                       \
+            DEBUG_FAIL(ss.str());                                                        \
         }                                                                                \
     } while (0)
 #else // DBG_ENA_BOUNDS_CHECK
@@ -117,7 +127,7 @@ public:
             ss << "ENSURE condition '" << #expr << "' failed at " << __FILE__ << ":"     \
                << __LINE__;                                                              \
             DEBUG_PRINT(ss.str());                                                       \
-            throw Debug::AssertionError(ss.str());                                       \
+            DEBUG_FAIL(ss.str());                                                        \
         }                                                                                \
     } while (0)
 #else // DBG_ENA_ENSURE
@@ -1 +1,201 @@
- 
+#ifndef ARRAYREF_H
+#define ARRAYREF_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+
+#include "debug_macros.h"
+#include "fds/span.h"
+
+/**
+ * A non-owning, read-only view of a contiguous run of elements. Use it in place of
+ * `const std::vector<T>&` parameters and return types so that callers can pass any
+ * contiguous storage (a vector, an array, a slice of either or a single element) without
+ * building a temporary vector. Copying an ArrayRef copies two words; the elements must
+ * outlive it.
+ *
+ * Like Span, element access is bounds checked only when DEBUG_ENA_BOUNDS_CHECK is set.
+ *
+ * @tparam T element type.
+ */
+template <typename T> class ArrayRef {
+private:
+    const T* ptr;
+    std::size_t len;
+
+public:
+    using value_type = T;
+    using iterator = const T*;
+
+    ArrayRef() noexcept;
+    ArrayRef(const T& elem) noexcept;
+    ArrayRef(const T* data, std::size_t size) noexcept;
+    ArrayRef(const T* begin, const T* end) noexcept;
+    template <typename A> ArrayRef(const std::vector<T, A>& vec) noexcept;
+    template <std::size_t N> ArrayRef(const std::array<T, N>& arr) noexcept;
+    template <std::size_t N> ArrayRef(const T (&arr)[N]) noexcept;
+    /**
+     * View of a braced list. The list only lives until the end of the full expression,
+     * so this is only safe for arguments, never for ArrayRef variables.
+     */
+    ArrayRef(const std::initializer_list<T>& list) noexcept;
+    ArrayRef(Span<T> span) noexcept;
+
+    const T* data() const noexcept;
+    std::size_t size() const noexcept;
+    bool empty() const noexcept;
+    iterator begin() const noexcept;
+    iterator end() const noexcept;
+
+    const T& operator[](std::size_t idx) const;
+    const T& front() const;
+    const T& back() const;
+
+    /**
+     * View of count elements starting at start.
+     */
+    ArrayRef slice(std::size_t start, std::size_t count) const;
+    /**
+     * View of all elements from start onwards.
+     */
+    ArrayRef slice(std::size_t start) const;
+    ArrayRef dropFront(std::size_t count = 1) const;
+    ArrayRef dropBack(std::size_t count = 1) const;
+    ArrayRef takeFront(std::size_t count) const;
+    ArrayRef takeBack(std::size_t count) const;
+
+    /**
+     * Element-wise comparison.
+     */
+    bool equals(ArrayRef other) const;
+    /**
+     * Copy the elements into an owning vector.
+     */
+    std::vector<T> vec() const;
+};
+
+////////////////////////////////////
+// template function implementations
+////////////////////////////////////
+template <typename T> inline ArrayRef<T>::ArrayRef() noexcept : ptr{nullptr}, len{0} {
+}
+
+template <typename T>
+inline ArrayRef<T>::ArrayRef(const T& elem) noexcept : ptr{&elem}, len{1} {
+}
+
+template <typename T>
+inline ArrayRef<T>::ArrayRef(const T* data, std::size_t size) noexcept
+    : ptr{data}, len{size} {
+}
+
+template <typename T>
+inline ArrayRef<T>::ArrayRef(const T* begin, const T* end) noexcept
+    : ptr{begin}, len{static_cast<std::size_t>(end - begin)} {
+}
+
+template <typename T>
+template <typename A>
+inline ArrayRef<T>::ArrayRef(const std::vector<T, A>& vec) noexcept
+    : ptr{vec.data()}, len{vec.size()} {
+}
+
+template <typename T>
+template <std::size_t N>
+inline ArrayRef<T>::ArrayRef(const std::array<T, N>& arr) noexcept
+    : ptr{arr.data()}, len{N} {
+}
+
+template <typename T>
+template <std::size_t N>
+inline ArrayRef<T>::ArrayRef(const T (&arr)[N]) noexcept : ptr{arr}, len{N} {
+}
+
+template <typename T>
+inline ArrayRef<T>::ArrayRef(const std::initializer_list<T>& list) noexcept
+    : ptr{list.begin()}, len{list.size()} {
+}
+
+template <typename T>
+inline ArrayRef<T>::ArrayRef(Span<T> span) noexcept : ptr{span.data()}, len{span.size()} {
+}
+
+template <typename T> inline const T* ArrayRef<T>::data() const noexcept {
+    return ptr;
+}
+
+template <typename T> inline std::size_t ArrayRef<T>::size() const noexcept {
+    return len;
+}
+
+template <typename T> inline bool ArrayRef<T>::empty() const noexcept {
+    return len == 0;
+}
+
+template <typename T>
+inline typename ArrayRef<T>::iterator ArrayRef<T>::begin() const noexcept {
+    return ptr;
+}
+
+template <typename T>
+inline typename ArrayRef<T>::iterator ArrayRef<T>::end() const noexcept {
+    return ptr + len;
+}
+
+template <typename T> inline const T& ArrayRef<T>::operator[](std::size_t idx) const {
+    BOUND_CHK_LT(idx, len);
+    return ptr[idx];
+}
+
+template <typename T> inline const T& ArrayRef<T>::front() const {
+    BOUND_CHK_GT(len, 0u);
+    return ptr[0];
+}
+
+template <typename T> inline const T& ArrayRef<T>::back() const {
+    BOUND_CHK_GT(len, 0u);
+    return ptr[len - 1];
+}
+
+template <typename T>
+inline ArrayRef<T> ArrayRef<T>::slice(std::size_t start, std::size_t count) const {
+    BOUND_CHK_LTE(start, len);
+    BOUND_CHK_LTE(count, len - start);
+    return ArrayRef(ptr + start, count);
+}
+
+template <typename T> inline ArrayRef<T> ArrayRef<T>::slice(std::size_t start) const {
+    BOUND_CHK_LTE(start, len);
+    return ArrayRef(ptr + start, len - start);
+}
+
+template <typename T> inline ArrayRef<T> ArrayRef<T>::dropFront(std::size_t count) const {
+    return slice(count);
+}
+
+template <typename T> inline ArrayRef<T> ArrayRef<T>::dropBack(std::size_t count) const {
+    BOUND_CHK_LTE(count, len);
+    return ArrayRef(ptr, len - count);
+}
+
+template <typename T> inline ArrayRef<T> ArrayRef<T>::takeFront(std::size_t count) const {
+    return slice(0, count);
+}
+
+template <typename T> inline ArrayRef<T> ArrayRef<T>::takeBack(std::size_t count) const {
+    BOUND_CHK_LTE(count, len);
+    return ArrayRef(ptr + len - count, count);
+}
+
+template <typename T> bool ArrayRef<T>::equals(ArrayRef other) const {
+    return len == other.len && std::equal(begin(), end(), other.begin());
+}
+
+template <typename T> std::vector<T> ArrayRef<T>::vec() const {
+    return std::vector<T>(begin(), end());
+}
+
+#endif // ARRAYREF_H
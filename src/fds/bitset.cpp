@@ -3,21 +3,29 @@
 #include <cstring>
 #include <stdexcept>
 
+#include "util/error.h"
+#include "util/memstats.h"
+
 #define UDIV_CEIL(a, b) ((a / b) + (a % b != 0))
 
+static const Util::MemStats::Counter BITSET_MEM = Util::MemStats::counter("Bitset");
+
 Bitset::Bitset(std::size_t bits) : bits{bits} {
     numElems = UDIV_CEIL(bits, 64);
     data = new uint64_t[numElems];
     memset(data, 0, sizeof(uint64_t) * numElems);
+    Util::MemStats::alloc(BITSET_MEM, numElems * sizeof(uint64_t));
 }
 
 Bitset::~Bitset() {
+    Util::MemStats::release(BITSET_MEM, numElems * sizeof(uint64_t));
     delete[] data;
 }
 
 Bitset::Bitset(const Bitset& field) : numElems{field.numElems}, bits{field.bits} {
     data = new uint64_t[numElems];
     std::memcpy(data, field.data, field.numElems * sizeof(uint64_t));
+    Util::MemStats::alloc(BITSET_MEM, numElems * sizeof(uint64_t));
 }
 
 Bitset::Bitset(Bitset&& field) noexcept : numElems{field.numElems}, bits{field.bits} {
@@ -32,7 +40,8 @@ Bitset& Bitset::operator=(Bitset&& field) noexcept {
     // self-assignment check
     if (this == &field)
         return *this;
-    delete data;
+    Util::MemStats::release(BITSET_MEM, numElems * sizeof(uint64_t));
+    delete[] data;
     numElems = field.numElems;
     bits = field.bits;
     data = field.data;
@@ -81,31 +90,57 @@ Bitset Bitset::operator~() const {
     return newField;
 }
 
-Bitset& Bitset::operator&=(const Bitset& b) {
+static Util::Unexpected<Util::Error> sizeMismatch() {
+    return Util::Unexpected(Util::Error("Bitsets must match for binary operator"));
+}
+
+Util::Expected<void> Bitset::tryAnd(const Bitset& b) {
     if (numElems != b.numElems || bits != b.bits) {
-        throw std::length_error("Bitsets must match for binary operator");
+        return sizeMismatch();
     }
     for (size_t i = 0; i < numElems; ++i) {
         data[i] = data[i] & b.data[i];
     }
-    return *this;
+    return {};
 }
-Bitset& Bitset::operator|=(const Bitset& b) {
+Util::Expected<void> Bitset::tryOr(const Bitset& b) {
     if (numElems != b.numElems || bits != b.bits) {
-        throw std::length_error("Bitsets must match for binary operator");
+        return sizeMismatch();
     }
     for (size_t i = 0; i < numElems; ++i) {
         data[i] = data[i] | b.data[i];
     }
-    return *this;
+    return {};
 }
-Bitset& Bitset::operator^=(const Bitset& b) {
+Util::Expected<void> Bitset::tryXor(const Bitset& b) {
     if (numElems != b.numElems || bits != b.bits) {
-        throw std::length_error("Bitsets must match for binary operator");
+        return sizeMismatch();
     }
     for (size_t i = 0; i < numElems; ++i) {
         data[i] = data[i] ^ b.data[i];
     }
+    return {};
+}
+
+Bitset& Bitset::operator&=(const Bitset& b) {
+    Util::Expected<void> res = tryAnd(b);
+    if (!res) {
+        Util::throwOrAbort(std::length_error(res.error().message()));
+    }
+    return *this;
+}
+Bitset& Bitset::operator|=(const Bitset& b) {
+    Util::Expected<void> res = tryOr(b);
+    if (!res) {
+        Util::throwOrAbort(std::length_error(res.error().message()));
+    }
+    return *this;
+}
+Bitset& Bitset::operator^=(const Bitset& b) {
+    Util::Expected<void> res = tryXor(b);
+    if (!res) {
+        Util::throwOrAbort(std::length_error(res.error().message()));
+    }
     return *this;
 }
 
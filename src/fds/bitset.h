@@ -3,6 +3,8 @@
 
 #include <cstdint>
 
+#include "util/expected.h"
+
 class Bitset {
 private:
     class Reference;
@@ -27,6 +29,13 @@ public:
     Bitset& operator&=(const Bitset& b);
     Bitset& operator|=(const Bitset& b);
     Bitset& operator^=(const Bitset& b);
+    /**
+     * Non-throwing versions of &=, |= and ^=. On a size mismatch the bitset is left
+     * unchanged and an error is returned, where the operators throw std::length_error.
+     */
+    Util::Expected<void> tryAnd(const Bitset& b);
+    Util::Expected<void> tryOr(const Bitset& b);
+    Util::Expected<void> tryXor(const Bitset& b);
 
     bool operator[](std::size_t bit) const;
     Reference operator[](std::size_t bit);
@@ -1 +1,136 @@
- 
+#ifndef DENSEGRAPH_H
+#define DENSEGRAPH_H
+
+#include <cstddef>
+#include <vector>
+
+#include "debug_macros.h"
+#include "fds/arrayref.h"
+#include "fds/isvector.h"
+
+/**
+ * A directed multigraph over densely numbered nodes. Node ids are handed out in
+ * insertion order starting at zero, so they can be used directly to index side tables
+ * (e.g. a Bitset of visited nodes). Both successor and predecessor edge lists are kept so
+ * that forward and backward walks are equally cheap.
+ *
+ * Nodes and edges cannot be removed; passes that need to drop parts of a graph should
+ * build a new one.
+ *
+ * @tparam NodeT data stored per node.
+ * @tparam EdgeT data stored per edge.
+ */
+template <typename NodeT, typename EdgeT> class DenseGraph {
+public:
+    using NodeId = std::size_t;
+    using EdgeId = std::size_t;
+
+    struct Edge {
+        NodeId src;
+        NodeId dst;
+        EdgeT data;
+    };
+
+private:
+    std::vector<NodeT> nodes;
+    std::vector<Edge> edges;
+    // most nodes have one or two edges each way, which then need no heap allocation
+    std::vector<SmallVector<EdgeId, 2>> succs;
+    std::vector<SmallVector<EdgeId, 2>> preds;
+
+public:
+    NodeId addNode(NodeT data);
+    EdgeId addEdge(NodeId src, NodeId dst, EdgeT data);
+
+    NodeT& node(NodeId id);
+    const NodeT& node(NodeId id) const;
+    Edge& edge(EdgeId id);
+    const Edge& edge(EdgeId id) const;
+
+    /**
+     * Outgoing edges of a node, in insertion order.
+     */
+    ArrayRef<EdgeId> succEdges(NodeId id) const;
+    /**
+     * Incoming edges of a node, in insertion order.
+     */
+    ArrayRef<EdgeId> predEdges(NodeId id) const;
+
+    std::size_t numNodes() const noexcept;
+    std::size_t numEdges() const noexcept;
+};
+
+///////////////////////////////////////////
+// template function implementations
+///////////////////////////////////////////
+template <typename NodeT, typename EdgeT>
+typename DenseGraph<NodeT, EdgeT>::NodeId DenseGraph<NodeT, EdgeT>::addNode(NodeT data) {
+    nodes.emplace_back(std::move(data));
+    succs.emplace_back();
+    preds.emplace_back();
+    return nodes.size() - 1;
+}
+
+template <typename NodeT, typename EdgeT>
+typename DenseGraph<NodeT, EdgeT>::EdgeId
+DenseGraph<NodeT, EdgeT>::addEdge(NodeId src, NodeId dst, EdgeT data) {
+    BOUND_CHK_LT(src, nodes.size());
+    BOUND_CHK_LT(dst, nodes.size());
+    EdgeId id = edges.size();
+    edges.push_back({src, dst, std::move(data)});
+    succs[src].push_back(id);
+    preds[dst].push_back(id);
+    return id;
+}
+
+template <typename NodeT, typename EdgeT>
+inline NodeT& DenseGraph<NodeT, EdgeT>::node(NodeId id) {
+    BOUND_CHK_LT(id, nodes.size());
+    return nodes[id];
+}
+
+template <typename NodeT, typename EdgeT>
+inline const NodeT& DenseGraph<NodeT, EdgeT>::node(NodeId id) const {
+    BOUND_CHK_LT(id, nodes.size());
+    return nodes[id];
+}
+
+template <typename NodeT, typename EdgeT>
+inline typename DenseGraph<NodeT, EdgeT>::Edge&
+DenseGraph<NodeT, EdgeT>::edge(EdgeId id) {
+    BOUND_CHK_LT(id, edges.size());
+    return edges[id];
+}
+
+template <typename NodeT, typename EdgeT>
+inline const typename DenseGraph<NodeT, EdgeT>::Edge&
+DenseGraph<NodeT, EdgeT>::edge(EdgeId id) const {
+    BOUND_CHK_LT(id, edges.size());
+    return edges[id];
+}
+
+template <typename NodeT, typename EdgeT>
+inline ArrayRef<typename DenseGraph<NodeT, EdgeT>::EdgeId>
+DenseGraph<NodeT, EdgeT>::succEdges(NodeId id) const {
+    BOUND_CHK_LT(id, nodes.size());
+    return succs[id];
+}
+
+template <typename NodeT, typename EdgeT>
+inline ArrayRef<typename DenseGraph<NodeT, EdgeT>::EdgeId>
+DenseGraph<NodeT, EdgeT>::predEdges(NodeId id) const {
+    BOUND_CHK_LT(id, nodes.size());
+    return preds[id];
+}
+
+template <typename NodeT, typename EdgeT>
+inline std::size_t DenseGraph<NodeT, EdgeT>::numNodes() const noexcept {
+    return nodes.size();
+}
+
+template <typename NodeT, typename EdgeT>
+inline std::size_t DenseGraph<NodeT, EdgeT>::numEdges() const noexcept {
+    return edges.size();
+}
+
+#endif // DENSEGRAPH_H
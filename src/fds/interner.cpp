@@ -0,0 +1,89 @@
+#include "interner.h"
+
+#include <cstring>
+
+#include "util/memstats.h"
+
+static const Util::MemStats::Counter INTERNER_MEM =
+    Util::MemStats::counter("StringInterner");
+
+StringInterner::StringInterner() : blockUsed{0}, blockCap{0}, arenaBytes{0} {
+}
+
+StringInterner::~StringInterner() {
+    Util::MemStats::release(INTERNER_MEM, arenaBytes);
+}
+
+StringInterner::StringInterner(StringInterner&& other) noexcept
+    : ids{std::move(other.ids)},
+      strings{std::move(other.strings)},
+      blocks{std::move(other.blocks)},
+      largeStrings{std::move(other.largeStrings)},
+      blockUsed{other.blockUsed},
+      blockCap{other.blockCap},
+      arenaBytes{other.arenaBytes} {
+    other.blockUsed = 0;
+    other.blockCap = 0;
+    other.arenaBytes = 0;
+}
+
+StringInterner& StringInterner::operator=(StringInterner&& other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+    Util::MemStats::release(INTERNER_MEM, arenaBytes);
+    ids = std::move(other.ids);
+    strings = std::move(other.strings);
+    blocks = std::move(other.blocks);
+    largeStrings = std::move(other.largeStrings);
+    blockUsed = other.blockUsed;
+    blockCap = other.blockCap;
+    arenaBytes = other.arenaBytes;
+    other.ids.clear();
+    other.strings.clear();
+    other.blocks.clear();
+    other.largeStrings.clear();
+    other.blockUsed = 0;
+    other.blockCap = 0;
+    other.arenaBytes = 0;
+    return *this;
+}
+
+std::string_view StringInterner::store(std::string_view str) {
+    if (str.empty()) {
+        return {};
+    }
+    if (str.size() > BLOCK_SIZE / 4) {
+        // large strings get an allocation of their own so the current block isn't wasted
+        std::unique_ptr<char[]> own(new char[str.size()]);
+        Util::MemStats::alloc(INTERNER_MEM, str.size());
+        arenaBytes += str.size();
+        std::memcpy(own.get(), str.data(), str.size());
+        std::string_view stored(own.get(), str.size());
+        largeStrings.push_back(std::move(own));
+        return stored;
+    }
+    if (str.size() > blockCap - blockUsed) {
+        blocks.emplace_back(new char[BLOCK_SIZE]);
+        Util::MemStats::alloc(INTERNER_MEM, BLOCK_SIZE);
+        arenaBytes += BLOCK_SIZE;
+        blockUsed = 0;
+        blockCap = BLOCK_SIZE;
+    }
+    char* dst = blocks.back().get() + blockUsed;
+    std::memcpy(dst, str.data(), str.size());
+    blockUsed += str.size();
+    return {dst, str.size()};
+}
+
+StringInterner::Id StringInterner::intern(std::string_view str) {
+    auto it = ids.find(str);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    std::string_view stored = store(str);
+    Id id = static_cast<Id>(strings.size());
+    strings.push_back(stored);
+    ids.emplace(stored, id);
+    return id;
+}
@@ -0,0 +1,61 @@
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Maps strings to small dense integer ids, so that identifiers can be compared and hashed
+ * as integers after lexing. Interned strings are copied into large arena blocks and are
+ * never freed or moved, so views returned by str() stay valid for the lifetime of the
+ * interner.
+ */
+class StringInterner {
+public:
+    using Id = uint32_t;
+
+private:
+    static constexpr std::size_t BLOCK_SIZE = 64 * 1024;
+
+    std::unordered_map<std::string_view, Id> ids;
+    std::vector<std::string_view> strings;
+    // arena blocks; the current one is at the back
+    std::vector<std::unique_ptr<char[]>> blocks;
+    // strings too large for a block, each in an allocation of its own
+    std::vector<std::unique_ptr<char[]>> largeStrings;
+    std::size_t blockUsed;
+    std::size_t blockCap;
+    // total size of all blocks, for memory accounting
+    std::size_t arenaBytes;
+
+    std::string_view store(std::string_view str);
+
+public:
+    StringInterner();
+    ~StringInterner();
+    // interned views point into the arena, so copying is not supported
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+    StringInterner(StringInterner&& other) noexcept;
+    StringInterner& operator=(StringInterner&& other) noexcept;
+
+    /**
+     * Intern a string, returning the existing id if it has been seen before.
+     */
+    Id intern(std::string_view str);
+    std::string_view str(Id id) const;
+    std::size_t size() const noexcept;
+};
+
+inline std::string_view StringInterner::str(Id id) const {
+    return strings[id];
+}
+
+inline std::size_t StringInterner::size() const noexcept {
+    return strings.size();
+}
+
+#endif // INTERNER_H
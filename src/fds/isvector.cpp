@@ -0,0 +1,48 @@
+#include "isvector.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include "util/error.h"
+
+std::size_t SmallVectorBase::newCapacity(std::size_t minCap) const {
+    constexpr std::size_t MAX_CAP = UINT32_MAX;
+    if (minCap > MAX_CAP) {
+        Util::throwOrAbort(std::length_error("SmallVector capacity overflow"));
+    }
+    // grow geometrically so that repeated push_back stays amortized O(1)
+    std::size_t newCap = 2 * static_cast<std::size_t>(cap) + 1;
+    return std::min(std::max(newCap, minCap), MAX_CAP);
+}
+
+void SmallVectorBase::growPod(void* firstEl, std::size_t minCap, std::size_t elemSize) {
+    std::size_t newCap = newCapacity(minCap);
+    void* newElts;
+    if (beginX == firstEl) {
+        newElts = std::malloc(newCap * elemSize);
+        if (newElts) {
+            std::memcpy(newElts, beginX, sz * elemSize);
+        }
+    } else {
+        newElts = std::realloc(beginX, newCap * elemSize);
+    }
+    if (!newElts) {
+        Util::throwOrAbort(std::bad_alloc());
+    }
+    beginX = newElts;
+    cap = static_cast<uint32_t>(newCap);
+}
+
+void* SmallVectorBase::mallocForGrow(std::size_t minCap, std::size_t elemSize,
+                                     std::size_t& newCap) {
+    newCap = newCapacity(minCap);
+    void* newElts = std::malloc(newCap * elemSize);
+    if (!newElts) {
+        Util::throwOrAbort(std::bad_alloc());
+    }
+    return newElts;
+}
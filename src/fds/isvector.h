@@ -1 +1,578 @@
- 
+#ifndef ISVECTOR_H
+#define ISVECTOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "debug_macros.h"
+#include "fds/arrayref.h"
+#include "fds/span.h"
+
+/**
+ * Size-independent part of SmallVector: the buffer pointer, the size and the capacity.
+ * Sizes are 32 bits so the header fits in two words.
+ */
+class SmallVectorBase {
+protected:
+    void* beginX;
+    uint32_t sz;
+    uint32_t cap;
+
+    SmallVectorBase(void* firstEl, std::size_t inlineCap) noexcept;
+
+    /**
+     * Capacity to grow to so that at least minCap elements fit. Throws std::length_error
+     * if that exceeds the 32-bit size limit.
+     */
+    std::size_t newCapacity(std::size_t minCap) const;
+    /**
+     * Grow the buffer of a trivially copyable element type with realloc (or malloc and
+     * memcpy when leaving the inline buffer).
+     */
+    void growPod(void* firstEl, std::size_t minCap, std::size_t elemSize);
+    /**
+     * Allocate a new buffer for a non-trivial element type. The caller moves the
+     * elements over.
+     */
+    void* mallocForGrow(std::size_t minCap, std::size_t elemSize, std::size_t& newCap);
+
+public:
+    std::size_t size() const noexcept;
+    std::size_t capacity() const noexcept;
+    bool empty() const noexcept;
+};
+
+// used to find where the inline elements start, right after the header
+template <typename T> struct SmallVectorAlignAndSize {
+    alignas(SmallVectorBase) char base[sizeof(SmallVectorBase)];
+    alignas(T) char firstEl[sizeof(T)];
+};
+
+/**
+ * A vector that keeps up to N elements inline and only falls back to the heap when it
+ * grows past them. Use it for lists that are almost always tiny (operands, phi inputs,
+ * successors, worklists), where a std::vector would cost one heap allocation per object.
+ *
+ * Everything except construction lives in SmallVectorImpl<T>, which does not depend on
+ * N. Functions that take or fill such a list should accept a SmallVectorImpl<T>& so that
+ * callers can pick their own inline size. Element types that are trivially copyable are
+ * grown with realloc/memcpy instead of element-wise moves.
+ *
+ * Growing the vector invalidates pointers and iterators into it, as with std::vector.
+ * Unlike std::vector, moving a vector whose elements are inline moves the elements, so
+ * pointers into the source are not carried over.
+ *
+ * @tparam T element type.
+ */
+template <typename T> class SmallVectorImpl : public SmallVectorBase {
+private:
+    static constexpr bool IS_POD = std::is_trivially_copyable_v<T>;
+
+    void* firstEl() const noexcept;
+    bool isSmall() const noexcept;
+    void grow(std::size_t minCap);
+    static void destroyRange(T* first, T* last) noexcept;
+
+protected:
+    explicit SmallVectorImpl(unsigned inlineCap) noexcept;
+    ~SmallVectorImpl();
+
+    /**
+     * Take over the contents of other, stealing its heap buffer if it has one. A robbed
+     * vector is left empty with capacity zero, since its inline size is not known here;
+     * SmallVector restores it when it knows N.
+     */
+    void moveFrom(SmallVectorImpl& other);
+
+public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    SmallVectorImpl(const SmallVectorImpl&) = delete;
+
+    SmallVectorImpl& operator=(const SmallVectorImpl& other);
+    SmallVectorImpl& operator=(SmallVectorImpl&& other);
+
+    T* data() noexcept;
+    const T* data() const noexcept;
+    iterator begin() noexcept;
+    iterator end() noexcept;
+    const_iterator begin() const noexcept;
+    const_iterator end() const noexcept;
+
+    T& operator[](std::size_t idx);
+    const T& operator[](std::size_t idx) const;
+    T& front();
+    const T& front() const;
+    T& back();
+    const T& back() const;
+
+    void push_back(const T& elem);
+    void push_back(T&& elem);
+    template <typename... Args> T& emplace_back(Args&&... args);
+    void pop_back();
+    /**
+     * Remove the last element and return it.
+     */
+    T pop_back_val();
+
+    template <typename It,
+              typename = typename std::iterator_traits<It>::iterator_category>
+    void append(It first, It last);
+    void append(std::size_t count, const T& elem);
+    void append(std::initializer_list<T> list);
+
+    iterator insert(iterator pos, T elem);
+    iterator erase(const_iterator pos);
+    iterator erase(const_iterator first, const_iterator last);
+
+    void reserve(std::size_t minCap);
+    void resize(std::size_t count);
+    void resize(std::size_t count, const T& elem);
+    void clear() noexcept;
+
+    bool operator==(const SmallVectorImpl& other) const;
+    bool operator!=(const SmallVectorImpl& other) const;
+
+    operator ArrayRef<T>() const noexcept;
+    operator Span<T>() noexcept;
+};
+
+template <typename T, unsigned N> struct SmallVectorStorage {
+    alignas(T) char inlineElts[N * sizeof(T)];
+};
+
+/**
+ * SmallVectorImpl with storage for N inline elements.
+ *
+ * @tparam T element type.
+ * @tparam N number of elements stored without a heap allocation.
+ */
+template <typename T, unsigned N>
+class SmallVector : public SmallVectorImpl<T>, SmallVectorStorage<T, N> {
+    static_assert(N > 0, "SmallVector needs at least one inline element");
+
+public:
+    SmallVector() noexcept;
+    explicit SmallVector(std::size_t count, const T& elem = T());
+    template <typename It,
+              typename = typename std::iterator_traits<It>::iterator_category>
+    SmallVector(It first, It last);
+    SmallVector(std::initializer_list<T> list);
+    explicit SmallVector(ArrayRef<T> elems);
+    SmallVector(const SmallVector& other);
+    SmallVector(SmallVector&& other) noexcept(std::is_nothrow_move_constructible_v<T>);
+    SmallVector(SmallVectorImpl<T>&& other);
+    ~SmallVector() = default;
+
+    SmallVector& operator=(const SmallVector& other);
+    SmallVector& operator=(SmallVector&& other);
+    SmallVector& operator=(SmallVectorImpl<T>&& other);
+    SmallVector& operator=(std::initializer_list<T> list);
+};
+
+///////////////////////////////////////////
+// SmallVectorBase inline implementations
+///////////////////////////////////////////
+inline SmallVectorBase::SmallVectorBase(void* firstEl, std::size_t inlineCap) noexcept
+    : beginX{firstEl}, sz{0}, cap{static_cast<uint32_t>(inlineCap)} {
+}
+
+inline std::size_t SmallVectorBase::size() const noexcept {
+    return sz;
+}
+
+inline std::size_t SmallVectorBase::capacity() const noexcept {
+    return cap;
+}
+
+inline bool SmallVectorBase::empty() const noexcept {
+    return sz == 0;
+}
+
+///////////////////////////////////////////
+// template function implementations
+///////////////////////////////////////////
+template <typename T>
+inline SmallVectorImpl<T>::SmallVectorImpl(unsigned inlineCap) noexcept
+    : SmallVectorBase(firstEl(), inlineCap) {
+}
+
+template <typename T> SmallVectorImpl<T>::~SmallVectorImpl() {
+    destroyRange(begin(), end());
+    if (!isSmall()) {
+        std::free(beginX);
+    }
+}
+
+template <typename T> inline void* SmallVectorImpl<T>::firstEl() const noexcept {
+    // the inline storage of SmallVector<T, N> directly follows this object
+    return const_cast<char*>(reinterpret_cast<const char*>(this)) +
+           offsetof(SmallVectorAlignAndSize<T>, firstEl);
+}
+
+template <typename T> inline bool SmallVectorImpl<T>::isSmall() const noexcept {
+    return beginX == firstEl();
+}
+
+template <typename T> void SmallVectorImpl<T>::grow(std::size_t minCap) {
+    if constexpr (IS_POD) {
+        growPod(firstEl(), minCap, sizeof(T));
+    } else {
+        std::size_t newCap;
+        T* newElts = static_cast<T*>(mallocForGrow(minCap, sizeof(T), newCap));
+        std::uninitialized_move(begin(), end(), newElts);
+        destroyRange(begin(), end());
+        if (!isSmall()) {
+            std::free(beginX);
+        }
+        beginX = newElts;
+        cap = static_cast<uint32_t>(newCap);
+    }
+}
+
+template <typename T>
+inline void SmallVectorImpl<T>::destroyRange(T* first, T* last) noexcept {
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+        for (; first != last; ++first) {
+            first->~T();
+        }
+    } else {
+        UNUSED(first);
+        UNUSED(last);
+    }
+}
+
+template <typename T> void SmallVectorImpl<T>::moveFrom(SmallVectorImpl& other) {
+    if (!other.isSmall()) {
+        destroyRange(begin(), end());
+        if (!isSmall()) {
+            std::free(beginX);
+        }
+        beginX = other.beginX;
+        sz = other.sz;
+        cap = other.cap;
+        other.beginX = other.firstEl();
+        other.sz = 0;
+        other.cap = 0;
+        return;
+    }
+    // inline elements have to be moved one by one
+    clear();
+    reserve(other.sz);
+    std::uninitialized_move(other.begin(), other.end(), begin());
+    sz = other.sz;
+    other.clear();
+}
+
+template <typename T>
+SmallVectorImpl<T>& SmallVectorImpl<T>::operator=(const SmallVectorImpl& other) {
+    if (this != &other) {
+        clear();
+        append(other.begin(), other.end());
+    }
+    return *this;
+}
+
+template <typename T>
+SmallVectorImpl<T>& SmallVectorImpl<T>::operator=(SmallVectorImpl&& other) {
+    if (this != &other) {
+        moveFrom(other);
+    }
+    return *this;
+}
+
+template <typename T> inline T* SmallVectorImpl<T>::data() noexcept {
+    return static_cast<T*>(beginX);
+}
+
+template <typename T> inline const T* SmallVectorImpl<T>::data() const noexcept {
+    return static_cast<const T*>(beginX);
+}
+
+template <typename T>
+inline typename SmallVectorImpl<T>::iterator SmallVectorImpl<T>::begin() noexcept {
+    return data();
+}
+
+template <typename T>
+inline typename SmallVectorImpl<T>::iterator SmallVectorImpl<T>::end() noexcept {
+    return data() + sz;
+}
+
+template <typename T>
+inline typename SmallVectorImpl<T>::const_iterator
+SmallVectorImpl<T>::begin() const noexcept {
+    return data();
+}
+
+template <typename T>
+inline typename SmallVectorImpl<T>::const_iterator
+SmallVectorImpl<T>::end() const noexcept {
+    return data() + sz;
+}
+
+template <typename T> inline T& SmallVectorImpl<T>::operator[](std::size_t idx) {
+    BOUND_CHK_LT(idx, sz);
+    return data()[idx];
+}
+
+template <typename T>
+inline const T& SmallVectorImpl<T>::operator[](std::size_t idx) const {
+    BOUND_CHK_LT(idx, sz);
+    return data()[idx];
+}
+
+template <typename T> inline T& SmallVectorImpl<T>::front() {
+    BOUND_CHK_GT(sz, 0u);
+    return data()[0];
+}
+
+template <typename T> inline const T& SmallVectorImpl<T>::front() const {
+    BOUND_CHK_GT(sz, 0u);
+    return data()[0];
+}
+
+template <typename T> inline T& SmallVectorImpl<T>::back() {
+    BOUND_CHK_GT(sz, 0u);
+    return data()[sz - 1];
+}
+
+template <typename T> inline const T& SmallVectorImpl<T>::back() const {
+    BOUND_CHK_GT(sz, 0u);
+    return data()[sz - 1];
+}
+
+template <typename T> inline void SmallVectorImpl<T>::push_back(const T& elem) {
+    emplace_back(elem);
+}
+
+template <typename T> inline void SmallVectorImpl<T>::push_back(T&& elem) {
+    emplace_back(std::move(elem));
+}
+
+template <typename T>
+template <typename... Args>
+inline T& SmallVectorImpl<T>::emplace_back(Args&&... args) {
+    if (sz < cap) {
+        T* slot = ::new (static_cast<void*>(end())) T(std::forward<Args>(args)...);
+        ++sz;
+        return *slot;
+    }
+    // the arguments may refer to elements of this vector, so build the new element
+    // before growing frees them
+    T tmp(std::forward<Args>(args)...);
+    grow(sz + 1);
+    T* slot = ::new (static_cast<void*>(end())) T(std::move(tmp));
+    ++sz;
+    return *slot;
+}
+
+template <typename T> inline void SmallVectorImpl<T>::pop_back() {
+    BOUND_CHK_GT(sz, 0u);
+    --sz;
+    destroyRange(end(), end() + 1);
+}
+
+template <typename T> inline T SmallVectorImpl<T>::pop_back_val() {
+    T val = std::move(back());
+    pop_back();
+    return val;
+}
+
+template <typename T>
+template <typename It, typename>
+void SmallVectorImpl<T>::append(It first, It last) {
+    using Category = typename std::iterator_traits<It>::iterator_category;
+    if constexpr (std::is_base_of_v<std::forward_iterator_tag, Category>) {
+        std::size_t count = std::distance(first, last);
+        reserve(sz + count);
+        std::uninitialized_copy(first, last, end());
+        sz += static_cast<uint32_t>(count);
+    } else {
+        for (; first != last; ++first) {
+            emplace_back(*first);
+        }
+    }
+}
+
+template <typename T> void SmallVectorImpl<T>::append(std::size_t count, const T& elem) {
+    if (sz + count > cap) {
+        // elem may live in this vector
+        T tmp(elem);
+        reserve(sz + count);
+        std::uninitialized_fill_n(end(), count, tmp);
+    } else {
+        std::uninitialized_fill_n(end(), count, elem);
+    }
+    sz += static_cast<uint32_t>(count);
+}
+
+template <typename T>
+inline void SmallVectorImpl<T>::append(std::initializer_list<T> list) {
+    append(list.begin(), list.end());
+}
+
+template <typename T>
+typename SmallVectorImpl<T>::iterator SmallVectorImpl<T>::insert(iterator pos, T elem) {
+    std::size_t idx = pos - begin();
+    BOUND_CHK_LTE(idx, sz);
+    emplace_back(std::move(elem));
+    std::rotate(begin() + idx, end() - 1, end());
+    return begin() + idx;
+}
+
+template <typename T>
+inline typename SmallVectorImpl<T>::iterator
+SmallVectorImpl<T>::erase(const_iterator pos) {
+    return erase(pos, pos + 1);
+}
+
+template <typename T>
+typename SmallVectorImpl<T>::iterator SmallVectorImpl<T>::erase(const_iterator first,
+                                                                const_iterator last) {
+    iterator from = begin() + (first - begin());
+    iterator to = begin() + (last - begin());
+    BOUND_CHK_LTE(static_cast<std::size_t>(to - begin()), sz);
+    iterator newEnd = std::move(to, end(), from);
+    destroyRange(newEnd, end());
+    sz = static_cast<uint32_t>(newEnd - begin());
+    return from;
+}
+
+template <typename T> inline void SmallVectorImpl<T>::reserve(std::size_t minCap) {
+    if (minCap > cap) {
+        grow(minCap);
+    }
+}
+
+template <typename T> void SmallVectorImpl<T>::resize(std::size_t count) {
+    if (count < sz) {
+        destroyRange(begin() + count, end());
+    } else if (count > sz) {
+        reserve(count);
+        for (T* it = end(); it != begin() + count; ++it) {
+            ::new (static_cast<void*>(it)) T();
+        }
+    }
+    sz = static_cast<uint32_t>(count);
+}
+
+template <typename T> void SmallVectorImpl<T>::resize(std::size_t count, const T& elem) {
+    if (count < sz) {
+        destroyRange(begin() + count, end());
+        sz = static_cast<uint32_t>(count);
+    } else {
+        append(count - sz, elem);
+    }
+}
+
+template <typename T> inline void SmallVectorImpl<T>::clear() noexcept {
+    destroyRange(begin(), end());
+    sz = 0;
+}
+
+template <typename T>
+bool SmallVectorImpl<T>::operator==(const SmallVectorImpl& other) const {
+    return sz == other.sz && std::equal(begin(), end(), other.begin());
+}
+
+template <typename T>
+inline bool SmallVectorImpl<T>::operator!=(const SmallVectorImpl& other) const {
+    return !(*this == other);
+}
+
+template <typename T> inline SmallVectorImpl<T>::operator ArrayRef<T>() const noexcept {
+    return ArrayRef<T>(data(), sz);
+}
+
+template <typename T> inline SmallVectorImpl<T>::operator Span<T>() noexcept {
+    return Span<T>(data(), sz);
+}
+
+template <typename T, unsigned N>
+inline SmallVector<T, N>::SmallVector() noexcept : SmallVectorImpl<T>(N) {
+}
+
+template <typename T, unsigned N>
+SmallVector<T, N>::SmallVector(std::size_t count, const T& elem) : SmallVectorImpl<T>(N) {
+    this->append(count, elem);
+}
+
+template <typename T, unsigned N>
+template <typename It, typename>
+SmallVector<T, N>::SmallVector(It first, It last) : SmallVectorImpl<T>(N) {
+    this->append(first, last);
+}
+
+template <typename T, unsigned N>
+SmallVector<T, N>::SmallVector(std::initializer_list<T> list) : SmallVectorImpl<T>(N) {
+    this->append(list.begin(), list.end());
+}
+
+template <typename T, unsigned N>
+SmallVector<T, N>::SmallVector(ArrayRef<T> elems) : SmallVectorImpl<T>(N) {
+    this->append(elems.begin(), elems.end());
+}
+
+template <typename T, unsigned N>
+SmallVector<T, N>::SmallVector(const SmallVector& other) : SmallVectorImpl<T>(N) {
+    this->append(other.begin(), other.end());
+}
+
+template <typename T, unsigned N>
+SmallVector<T, N>::SmallVector(SmallVector&& other) noexcept(
+    std::is_nothrow_move_constructible_v<T>)
+    : SmallVectorImpl<T>(N) {
+    // other has N inline elements too, so moving from it never allocates
+    this->moveFrom(other);
+    if (other.cap == 0) {
+        other.cap = N;
+    }
+}
+
+template <typename T, unsigned N>
+SmallVector<T, N>::SmallVector(SmallVectorImpl<T>&& other) : SmallVectorImpl<T>(N) {
+    SmallVectorImpl<T>::operator=(std::move(other));
+}
+
+template <typename T, unsigned N>
+SmallVector<T, N>& SmallVector<T, N>::operator=(const SmallVector& other) {
+    SmallVectorImpl<T>::operator=(other);
+    return *this;
+}
+
+template <typename T, unsigned N>
+SmallVector<T, N>& SmallVector<T, N>::operator=(SmallVector&& other) {
+    if (this != &other) {
+        this->moveFrom(other);
+        if (other.cap == 0) {
+            other.cap = N;
+        }
+    }
+    return *this;
+}
+
+template <typename T, unsigned N>
+SmallVector<T, N>& SmallVector<T, N>::operator=(SmallVectorImpl<T>&& other) {
+    SmallVectorImpl<T>::operator=(std::move(other));
+    return *this;
+}
+
+template <typename T, unsigned N>
+SmallVector<T, N>& SmallVector<T, N>::operator=(std::initializer_list<T> list) {
+    this->clear();
+    this->append(list.begin(), list.end());
+    return *this;
+}
+
+#endif // ISVECTOR_H
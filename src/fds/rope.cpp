@@ -0,0 +1,233 @@
+#include "rope.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "util/error.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+Rope::Rope(Rope&& other) noexcept
+    : head{other.head}, tail{other.tail}, total{other.total}, numChunks{other.numChunks},
+      nextCap{other.nextCap} {
+    other.head = other.tail = nullptr;
+    other.total = other.numChunks = 0;
+    other.nextCap = MIN_CHUNK_SIZE;
+}
+
+Rope& Rope::operator=(Rope&& other) noexcept {
+    if (this != &other) {
+        clear();
+        head = other.head;
+        tail = other.tail;
+        total = other.total;
+        numChunks = other.numChunks;
+        nextCap = other.nextCap;
+        other.head = other.tail = nullptr;
+        other.total = other.numChunks = 0;
+        other.nextCap = MIN_CHUNK_SIZE;
+    }
+    return *this;
+}
+
+Rope::~Rope() {
+    clear();
+}
+
+void Rope::clear() noexcept {
+    Chunk* chunk = head;
+    while (chunk) {
+        Chunk* next = chunk->next;
+        std::free(chunk);
+        chunk = next;
+    }
+    head = tail = nullptr;
+    total = numChunks = 0;
+    nextCap = MIN_CHUNK_SIZE;
+}
+
+char* Rope::storage(Chunk* chunk) noexcept {
+    return reinterpret_cast<char*>(chunk + 1);
+}
+
+void Rope::link(Chunk* chunk) noexcept {
+    chunk->next = nullptr;
+    if (tail) {
+        tail->next = chunk;
+    } else {
+        head = chunk;
+    }
+    tail = chunk;
+    ++numChunks;
+}
+
+char* Rope::reserve(std::size_t want, std::size_t& avail) {
+    if (!tail || tail->size == tail->cap) {
+        // one allocation for the header and the storage
+        std::size_t cap = std::max(want, nextCap);
+        nextCap = std::min(nextCap * 2, CHUNK_SIZE);
+        Chunk* chunk = static_cast<Chunk*>(std::malloc(sizeof(Chunk) + cap));
+        if (!chunk) {
+            Util::throwOrAbort(std::bad_alloc());
+        }
+        chunk->data = storage(chunk);
+        chunk->size = 0;
+        chunk->cap = cap;
+        link(chunk);
+    }
+    avail = tail->cap - tail->size;
+    return storage(tail) + tail->size;
+}
+
+void Rope::append(const void* data, std::size_t len) {
+    const char* src = static_cast<const char*>(data);
+    while (len > 0) {
+        std::size_t avail;
+        char* dst = reserve(len, avail);
+        std::size_t n = std::min(avail, len);
+        std::memcpy(dst, src, n);
+        tail->size += n;
+        total += n;
+        src += n;
+        len -= n;
+    }
+}
+
+void Rope::push_back(char c) {
+    std::size_t avail;
+    *reserve(1, avail) = c;
+    ++tail->size;
+    ++total;
+}
+
+void Rope::fill(char c, std::size_t len) {
+    while (len > 0) {
+        std::size_t avail;
+        char* dst = reserve(len, avail);
+        std::size_t n = std::min(avail, len);
+        std::memset(dst, c, n);
+        tail->size += n;
+        total += n;
+        len -= n;
+    }
+}
+
+void Rope::appendRef(const void* data, std::size_t len) {
+    if (len < MIN_REF_SIZE) {
+        append(data, len);
+        return;
+    }
+    Chunk* chunk = static_cast<Chunk*>(std::malloc(sizeof(Chunk)));
+    if (!chunk) {
+        Util::throwOrAbort(std::bad_alloc());
+    }
+    chunk->data = static_cast<const char*>(data);
+    chunk->size = len;
+    // full, so the next append starts a new owned chunk
+    chunk->cap = len;
+    link(chunk);
+    total += len;
+}
+
+void Rope::appendRef(const Rope& other) {
+    other.forEachChunk(
+        [this](const char* data, std::size_t len) { appendRef(data, len); });
+}
+
+void Rope::splice(Rope&& other) noexcept {
+    if (!other.head || this == &other) {
+        return;
+    }
+    if (tail) {
+        tail->next = other.head;
+    } else {
+        head = other.head;
+    }
+    tail = other.tail;
+    total += other.total;
+    numChunks += other.numChunks;
+    nextCap = std::max(nextCap, other.nextCap);
+    other.head = other.tail = nullptr;
+    other.total = other.numChunks = 0;
+    other.nextCap = MIN_CHUNK_SIZE;
+}
+
+void Rope::copyTo(void* out) const noexcept {
+    char* dst = static_cast<char*>(out);
+    forEachChunk([&](const char* data, std::size_t len) {
+        std::memcpy(dst, data, len);
+        dst += len;
+    });
+}
+
+std::string Rope::str() const {
+    std::string text(total, '\0');
+    copyTo(&text[0]);
+    return text;
+}
+
+bool Rope::writeTo(int fd, std::string& error) const {
+    iovec iov[IOV_MAX];
+    const Chunk* chunk = head;
+    // bytes of chunk already written by a previous short write
+    std::size_t skip = 0;
+    while (chunk) {
+        int cnt = 0;
+        std::size_t off = skip;
+        for (const Chunk* it = chunk; it && cnt < IOV_MAX; it = it->next, off = 0) {
+            if (it->size > off) {
+                iov[cnt].iov_base = const_cast<char*>(it->data + off);
+                iov[cnt].iov_len = it->size - off;
+                ++cnt;
+            }
+        }
+        if (cnt == 0) {
+            break;
+        }
+        ssize_t n = writev(fd, iov, cnt);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            error = n < 0 ? std::strerror(errno) : "short write";
+            return false;
+        }
+        // a short write may end in the middle of a chunk
+        std::size_t left = static_cast<std::size_t>(n);
+        while (chunk && left >= chunk->size - skip) {
+            left -= chunk->size - skip;
+            skip = 0;
+            chunk = chunk->next;
+        }
+        skip += left;
+    }
+    return true;
+}
+
+bool Rope::writeFile(const std::string& path, std::string& error) const {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool ok = fd >= 0;
+    if (!ok) {
+        error = std::strerror(errno);
+    } else {
+        ok = writeTo(fd, error);
+        if (close(fd) != 0 && ok) {
+            error = std::strerror(errno);
+            ok = false;
+        }
+    }
+    if (!ok) {
+        error = "Unable to write '" + path + "': " + error + ".";
+    }
+    return ok;
+}
@@ -1 +1,159 @@
- 
+#ifndef ROPE_H
+#define ROPE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "fds/arrayref.h"
+
+/**
+ * An output buffer made of a linked list of chunks, for text and binary output that is
+ * produced in pieces and written out once.
+ *
+ * Appending never moves what was appended before: a full chunk is simply followed by a
+ * new one. Ropes filled independently, e.g. one per function on worker threads, are
+ * joined in O(1) by splicing their chunk lists, and the result is written to a file
+ * descriptor with writev() without ever being concatenated.
+ *
+ * Besides owned chunks, a rope can refer to memory owned by someone else (appendRef), so
+ * large blobs such as encoded function bodies are written straight from where they live.
+ * Such memory must outlive the rope and stay unchanged.
+ *
+ * A rope is not thread safe; each thread must fill its own.
+ */
+class Rope {
+private:
+    // owned chunks start at MIN_CHUNK_SIZE and double up to CHUNK_SIZE, so that the many
+    // small ropes (e.g. one listing per function) stay small while large ones still get
+    // few chunks
+    static constexpr std::size_t MIN_CHUNK_SIZE = 256;
+    static constexpr std::size_t CHUNK_SIZE = 16 * 1024;
+    // referenced pieces smaller than this are copied instead, so that an iovec is not
+    // spent on a few bytes
+    static constexpr std::size_t MIN_REF_SIZE = 256;
+
+    struct Chunk {
+        Chunk* next;
+        const char* data;
+        std::size_t size;
+        // bytes of storage after the header; referenced memory counts as full
+        std::size_t cap;
+    };
+
+    Chunk* head = nullptr;
+    Chunk* tail = nullptr;
+    std::size_t total = 0;
+    std::size_t numChunks = 0;
+    // capacity of the next owned chunk
+    std::size_t nextCap = MIN_CHUNK_SIZE;
+
+    static char* storage(Chunk* chunk) noexcept;
+    void link(Chunk* chunk) noexcept;
+    /**
+     * @return space for at least one byte at the end of the last chunk, and its size.
+     */
+    char* reserve(std::size_t want, std::size_t& avail);
+
+public:
+    Rope() noexcept = default;
+    Rope(const Rope&) = delete;
+    Rope& operator=(const Rope&) = delete;
+    Rope(Rope&& other) noexcept;
+    Rope& operator=(Rope&& other) noexcept;
+    ~Rope();
+
+    std::size_t size() const noexcept;
+    bool empty() const noexcept;
+    std::size_t chunkCount() const noexcept;
+    void clear() noexcept;
+
+    /**
+     * Copy data to the end of the rope.
+     */
+    void append(const void* data, std::size_t len);
+    void append(std::string_view str);
+    void append(ArrayRef<uint8_t> bytes);
+    void push_back(char c);
+    /**
+     * Append len copies of c, e.g. for padding.
+     */
+    void fill(char c, std::size_t len);
+    /**
+     * Append data without copying it, unless it is small. data must outlive the rope.
+     */
+    void appendRef(const void* data, std::size_t len);
+    /**
+     * Append the contents of other without copying its chunks, except small ones. other
+     * must outlive this rope and not be appended to or cleared meanwhile.
+     */
+    void appendRef(const Rope& other);
+    /**
+     * Move the chunks of other to the end of this rope, leaving other empty.
+     */
+    void splice(Rope&& other) noexcept;
+
+    Rope& operator<<(std::string_view str);
+    Rope& operator<<(char c);
+
+    /**
+     * Call fn(data, len) on each chunk in order.
+     */
+    template <typename Fn> void forEachChunk(Fn fn) const;
+
+    /**
+     * Copy the contents to out, which must hold size() bytes.
+     */
+    void copyTo(void* out) const noexcept;
+    std::string str() const;
+
+    /**
+     * Write the contents to fd with as few writev() calls as possible.
+     */
+    bool writeTo(int fd, std::string& error) const;
+    bool writeFile(const std::string& path, std::string& error) const;
+};
+
+////////////////////////////////////
+// template function implementations
+////////////////////////////////////
+inline std::size_t Rope::size() const noexcept {
+    return total;
+}
+
+inline bool Rope::empty() const noexcept {
+    return total == 0;
+}
+
+inline std::size_t Rope::chunkCount() const noexcept {
+    return numChunks;
+}
+
+inline void Rope::append(std::string_view str) {
+    append(str.data(), str.size());
+}
+
+inline void Rope::append(ArrayRef<uint8_t> bytes) {
+    append(bytes.data(), bytes.size());
+}
+
+inline Rope& Rope::operator<<(std::string_view str) {
+    append(str.data(), str.size());
+    return *this;
+}
+
+inline Rope& Rope::operator<<(char c) {
+    push_back(c);
+    return *this;
+}
+
+template <typename Fn> void Rope::forEachChunk(Fn fn) const {
+    for (const Chunk* chunk = head; chunk; chunk = chunk->next) {
+        if (chunk->size) {
+            fn(chunk->data, chunk->size);
+        }
+    }
+}
+
+#endif // ROPE_H
@@ -1 +1,155 @@
- 
+#ifndef SPAN_H
+#define SPAN_H
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include "debug_macros.h"
+
+/**
+ * A non-owning view of a contiguous run of mutable elements, for APIs that modify (or
+ * move from) elements in place without caring what container they live in. Copying a
+ * Span copies two words; the elements must outlive it.
+ *
+ * Element access is bounds checked when DEBUG_ENA_BOUNDS_CHECK is set, and unchecked
+ * otherwise. For read-only access use ArrayRef, which a Span converts to implicitly.
+ *
+ * @tparam T element type.
+ */
+template <typename T> class Span {
+private:
+    T* ptr;
+    std::size_t len;
+
+public:
+    using value_type = T;
+    using iterator = T*;
+
+    Span() noexcept;
+    Span(T* data, std::size_t size) noexcept;
+    Span(T* begin, T* end) noexcept;
+    template <typename A> Span(std::vector<T, A>& vec) noexcept;
+    template <std::size_t N> Span(std::array<T, N>& arr) noexcept;
+    template <std::size_t N> Span(T (&arr)[N]) noexcept;
+
+    T* data() const noexcept;
+    std::size_t size() const noexcept;
+    bool empty() const noexcept;
+    iterator begin() const noexcept;
+    iterator end() const noexcept;
+
+    T& operator[](std::size_t idx) const;
+    T& front() const;
+    T& back() const;
+
+    /**
+     * View of count elements starting at start.
+     */
+    Span slice(std::size_t start, std::size_t count) const;
+    /**
+     * View of all elements from start onwards.
+     */
+    Span slice(std::size_t start) const;
+    Span dropFront(std::size_t count = 1) const;
+    Span dropBack(std::size_t count = 1) const;
+    Span takeFront(std::size_t count) const;
+    Span takeBack(std::size_t count) const;
+};
+
+////////////////////////////////////
+// template function implementations
+////////////////////////////////////
+template <typename T> inline Span<T>::Span() noexcept : ptr{nullptr}, len{0} {
+}
+
+template <typename T>
+inline Span<T>::Span(T* data, std::size_t size) noexcept : ptr{data}, len{size} {
+}
+
+template <typename T>
+inline Span<T>::Span(T* begin, T* end) noexcept
+    : ptr{begin}, len{static_cast<std::size_t>(end - begin)} {
+}
+
+template <typename T>
+template <typename A>
+inline Span<T>::Span(std::vector<T, A>& vec) noexcept : ptr{vec.data()}, len{vec.size()} {
+}
+
+template <typename T>
+template <std::size_t N>
+inline Span<T>::Span(std::array<T, N>& arr) noexcept : ptr{arr.data()}, len{N} {
+}
+
+template <typename T>
+template <std::size_t N>
+inline Span<T>::Span(T (&arr)[N]) noexcept : ptr{arr}, len{N} {
+}
+
+template <typename T> inline T* Span<T>::data() const noexcept {
+    return ptr;
+}
+
+template <typename T> inline std::size_t Span<T>::size() const noexcept {
+    return len;
+}
+
+template <typename T> inline bool Span<T>::empty() const noexcept {
+    return len == 0;
+}
+
+template <typename T> inline typename Span<T>::iterator Span<T>::begin() const noexcept {
+    return ptr;
+}
+
+template <typename T> inline typename Span<T>::iterator Span<T>::end() const noexcept {
+    return ptr + len;
+}
+
+template <typename T> inline T& Span<T>::operator[](std::size_t idx) const {
+    BOUND_CHK_LT(idx, len);
+    return ptr[idx];
+}
+
+template <typename T> inline T& Span<T>::front() const {
+    BOUND_CHK_GT(len, 0u);
+    return ptr[0];
+}
+
+template <typename T> inline T& Span<T>::back() const {
+    BOUND_CHK_GT(len, 0u);
+    return ptr[len - 1];
+}
+
+template <typename T>
+inline Span<T> Span<T>::slice(std::size_t start, std::size_t count) const {
+    BOUND_CHK_LTE(start, len);
+    BOUND_CHK_LTE(count, len - start);
+    return Span(ptr + start, count);
+}
+
+template <typename T> inline Span<T> Span<T>::slice(std::size_t start) const {
+    BOUND_CHK_LTE(start, len);
+    return Span(ptr + start, len - start);
+}
+
+template <typename T> inline Span<T> Span<T>::dropFront(std::size_t count) const {
+    return slice(count);
+}
+
+template <typename T> inline Span<T> Span<T>::dropBack(std::size_t count) const {
+    BOUND_CHK_LTE(count, len);
+    return Span(ptr, len - count);
+}
+
+template <typename T> inline Span<T> Span<T>::takeFront(std::size_t count) const {
+    return slice(0, count);
+}
+
+template <typename T> inline Span<T> Span<T>::takeBack(std::size_t count) const {
+    BOUND_CHK_LTE(count, len);
+    return Span(ptr + len - count, count);
+}
+
+#endif // SPAN_H
@@ -0,0 +1,390 @@
+#include "include_cache.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace Frontend {
+
+//////////////////////////////////////////////
+// Include guard detection
+//////////////////////////////////////////////
+namespace {
+
+/**
+ * Minimal scanner over raw source text that understands just enough of the C lexical
+ * grammar (comments, literals, line splices) to find directives reliably.
+ */
+class GuardScanner {
+private:
+    const string& src;
+    size_t pos;
+
+    bool at(const char* str) const { return src.compare(pos, strlen(str), str) == 0; }
+
+public:
+    explicit GuardScanner(const string& src) : src{src}, pos{0} {}
+
+    bool eof() const { return pos >= src.size(); }
+
+    /**
+     * Skip spaces, tabs, comments and line splices, plus newlines if crossLines is set.
+     * Block comments are always skipped whole, even if they span lines.
+     */
+    void skipSpace(bool crossLines) {
+        while (!eof()) {
+            char c = src[pos];
+            if (c == ' ' || c == '\t' || c == '\f' || c == '\v' || c == '\r' ||
+                (crossLines && c == '\n')) {
+                ++pos;
+            } else if (at("\\\n")) {
+                pos += 2;
+            } else if (at("/*")) {
+                size_t end = src.find("*/", pos + 2);
+                pos = end == string::npos ? src.size() : end + 2;
+            } else if (at("//")) {
+                // a line comment ends the line, but leave the newline itself alone
+                while (!eof() && src[pos] != '\n') {
+                    pos += at("\\\n") ? 2 : 1;
+                }
+            } else {
+                return;
+            }
+        }
+    }
+
+    string identifier() {
+        size_t start = pos;
+        while (!eof() &&
+               (isalnum(static_cast<unsigned char>(src[pos])) || src[pos] == '_')) {
+            ++pos;
+        }
+        return src.substr(start, pos - start);
+    }
+
+    bool consume(char c) {
+        if (!eof() && src[pos] == c) {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * True if only whitespace and comments remain on the current line.
+     */
+    bool lineEmpty() {
+        skipSpace(false);
+        return eof() || src[pos] == '\n';
+    }
+
+    /**
+     * Advance to the start of the next line, stepping over literals and comments so that
+     * their contents are never mistaken for directives.
+     */
+    void nextLine() {
+        while (!eof()) {
+            char c = src[pos];
+            if (c == '\n') {
+                ++pos;
+                return;
+            } else if (c == '"' || c == '\'') {
+                ++pos;
+                while (!eof() && src[pos] != c && src[pos] != '\n') {
+                    pos += src[pos] == '\\' ? 2 : 1;
+                }
+                // an unterminated literal ends at the newline, which ends the line
+                if (!eof() && src[pos] == c) {
+                    ++pos;
+                }
+            } else if (at("/*") || at("//") || at("\\\n")) {
+                skipSpace(false);
+            } else {
+                ++pos;
+            }
+        }
+    }
+
+    /**
+     * Skip leading whitespace of a line and read the directive name if the line is a
+     * directive.
+     *
+     * @return the directive name, or an empty string for non-directive lines.
+     */
+    string directive() {
+        skipSpace(false);
+        if (!consume('#')) {
+            return "";
+        }
+        skipSpace(false);
+        string name = identifier();
+        // a null directive still counts as a directive
+        return name.empty() ? "#" : name;
+    }
+};
+
+/**
+ * Parse the condition of an '#if' as '!defined(X)' or '!defined X'.
+ */
+string parseNotDefined(GuardScanner& scan) {
+    scan.skipSpace(false);
+    if (!scan.consume('!')) {
+        return "";
+    }
+    scan.skipSpace(false);
+    if (scan.identifier() != "defined") {
+        return "";
+    }
+    scan.skipSpace(false);
+    bool paren = scan.consume('(');
+    scan.skipSpace(false);
+    string name = scan.identifier();
+    scan.skipSpace(false);
+    if (paren && !scan.consume(')')) {
+        return "";
+    }
+    return name;
+}
+
+/**
+ * @return the stamp of the file at path, or a stamp with size -1 if it can't be stat'ed.
+ */
+FileStamp stampOf(const struct stat& info) {
+    FileStamp stamp;
+    stamp.dev = static_cast<uint64_t>(info.st_dev);
+    stamp.ino = static_cast<uint64_t>(info.st_ino);
+    stamp.size = static_cast<int64_t>(info.st_size);
+    stamp.mtimeNs =
+        static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+    return stamp;
+}
+
+FileStamp stampOf(const string& path) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return FileStamp();
+    }
+    return stampOf(info);
+}
+
+} // namespace
+
+string detectIncludeGuard(const string& src) {
+    GuardScanner scan(src);
+    scan.skipSpace(true);
+
+    // opening '#ifndef X' or '#if !defined(X)'
+    string guard;
+    string dir = scan.directive();
+    if (dir == "ifndef") {
+        scan.skipSpace(false);
+        guard = scan.identifier();
+    } else if (dir == "if") {
+        guard = parseNotDefined(scan);
+    }
+    if (guard.empty() || !scan.lineEmpty()) {
+        return "";
+    }
+    scan.nextLine();
+
+    // '#define X' must be the next thing in the file
+    scan.skipSpace(true);
+    if (scan.directive() != "define") {
+        return "";
+    }
+    scan.skipSpace(false);
+    if (scan.identifier() != guard) {
+        return "";
+    }
+    scan.nextLine();
+
+    // the matching '#endif' must close the file
+    long depth = 0;
+    while (!scan.eof()) {
+        dir = scan.directive();
+        if (dir == "if" || dir == "ifdef" || dir == "ifndef") {
+            ++depth;
+        } else if (depth == 0 && (dir == "else" || dir == "elif")) {
+            return "";
+        } else if (dir == "endif") {
+            if (depth == 0) {
+                scan.nextLine();
+                scan.skipSpace(true);
+                return scan.eof() ? guard : "";
+            }
+            --depth;
+        }
+        scan.nextLine();
+    }
+    return "";
+}
+
+//////////////////////////////////////////////
+// IncludeCache implementation
+//////////////////////////////////////////////
+bool FileStamp::operator==(const FileStamp& other) const noexcept {
+    return dev == other.dev && ino == other.ino && size == other.size &&
+           mtimeNs == other.mtimeNs;
+}
+
+IncludeCache& IncludeCache::global() {
+    static IncludeCache cache;
+    return cache;
+}
+
+shared_ptr<const SourceFile> IncludeCache::load(const std::string& path,
+                                                std::string& error) {
+    {
+        lock_guard<mutex> guard(lock);
+        auto it = files.find(path);
+        if (it != files.end()) {
+            return it->second;
+        }
+    }
+
+    error_code ec;
+    string canonical = fs::weakly_canonical(path, ec).string();
+    if (ec) {
+        canonical = path;
+    }
+    {
+        // the same file may already be cached under another spelling
+        lock_guard<mutex> guard(lock);
+        auto it = files.find(canonical);
+        if (it != files.end()) {
+            files.emplace(path, it->second);
+            return it->second;
+        }
+    }
+
+    // read outside the lock; if two threads race on the same file the first insert wins.
+    // The stamp is taken first, so a write racing with the read makes the entry stale.
+    struct stat info;
+    if (stat(canonical.c_str(), &info) != 0) {
+        error = "Unable to open '" + path + "'.";
+        return nullptr;
+    }
+    // ifstream happily opens a directory, and reading it would cache an empty header
+    if (!S_ISREG(info.st_mode)) {
+        error = "Unable to open '" + path + "': not a regular file.";
+        return nullptr;
+    }
+    FileStamp stamp = stampOf(info);
+    ifstream in(canonical, ios::binary);
+    if (!in) {
+        error = "Unable to open '" + path + "'.";
+        return nullptr;
+    }
+    auto file = make_shared<SourceFile>();
+    file->path = canonical;
+    file->contents.resize(static_cast<size_t>(info.st_size));
+    // a short read is either an I/O error or a file truncated under us; filebuf reports
+    // both as EOF, and neither may be cached. Growth past the stat size is caught by
+    // the stamp on the next revalidate().
+    in.read(&file->contents[0], static_cast<streamsize>(file->contents.size()));
+    if (in.gcount() != static_cast<streamsize>(file->contents.size())) {
+        error = "Unable to read '" + path + "'.";
+        return nullptr;
+    }
+    file->guard = detectIncludeGuard(file->contents);
+    file->stamp = stamp;
+
+    lock_guard<mutex> guard(lock);
+    auto inserted = files.emplace(canonical, move(file)).first->second;
+    files.emplace(path, inserted);
+    return inserted;
+}
+
+size_t IncludeCache::revalidate() {
+    vector<shared_ptr<const SourceFile>> cached;
+    {
+        lock_guard<mutex> guard(lock);
+        for (const auto& entry : files) {
+            // every spelling of a file maps to its canonical entry
+            if (entry.first == entry.second->path) {
+                cached.push_back(entry.second);
+            }
+        }
+    }
+    // stat outside the lock; files in use by a running compile stay alive through their
+    // shared_ptr even when dropped here
+    vector<const SourceFile*> stale;
+    for (const shared_ptr<const SourceFile>& file : cached) {
+        FileStamp now = stampOf(file->path);
+        if (now.size < 0 || now != file->stamp) {
+            stale.push_back(file.get());
+        }
+    }
+    if (stale.empty()) {
+        return 0;
+    }
+    sort(stale.begin(), stale.end());
+    lock_guard<mutex> guard(lock);
+    for (auto it = files.begin(); it != files.end();) {
+        if (binary_search(stale.begin(), stale.end(), it->second.get())) {
+            it = files.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return stale.size();
+}
+
+void IncludeCache::clear() {
+    lock_guard<mutex> guard(lock);
+    files.clear();
+}
+
+//////////////////////////////////////////////
+// IncludeResolver implementation
+//////////////////////////////////////////////
+IncludeResolver::IncludeResolver(std::vector<std::string> userDirs,
+                                 std::vector<std::string> systemDirs)
+    : searchDirs{move(userDirs)} {
+    searchDirs.insert(searchDirs.end(), make_move_iterator(systemDirs.begin()),
+                      make_move_iterator(systemDirs.end()));
+}
+
+bool IncludeResolver::resolve(const std::string& name, const std::string& includerDir,
+                              bool angled, std::string& path) {
+    // "" includes depend on the includer's directory, <> includes don't
+    string key = angled ? "<" + name : includerDir + '\0' + name;
+    auto it = memo.find(key);
+    if (it != memo.end()) {
+        path = it->second;
+        return !path.empty();
+    }
+
+    string found;
+    error_code ec;
+    if (!name.empty() && name[0] == '/') {
+        if (fs::is_regular_file(name, ec)) {
+            found = name;
+        }
+    } else {
+        if (!angled) {
+            fs::path candidate = fs::path(includerDir) / name;
+            if (fs::is_regular_file(candidate, ec)) {
+                found = candidate.string();
+            }
+        }
+        for (size_t i = 0; found.empty() && i < searchDirs.size(); ++i) {
+            fs::path candidate = fs::path(searchDirs[i]) / name;
+            if (fs::is_regular_file(candidate, ec)) {
+                found = candidate.string();
+            }
+        }
+    }
+    memo.emplace(move(key), found);
+    path = found;
+    return !found.empty();
+}
+
+} // namespace Frontend
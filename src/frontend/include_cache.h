@@ -0,0 +1,162 @@
+/**
+ * Header loading support for the preprocessor.
+ *
+ * Headers are read from disk at most once per process and shared between every
+ * translation unit (and every thread) that includes them. When a header is first loaded
+ * it is checked for the multiple-include guard idiom, so that later includes of a guarded
+ * header whose guard macro is already defined can be skipped without touching the file
+ * again.
+ */
+#ifndef INCLUDE_CACHE_H
+#define INCLUDE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Frontend {
+
+/**
+ * What identifies the version of a file on disk: if any of it changes, the file has been
+ * replaced or modified since it was read.
+ */
+struct FileStamp {
+    uint64_t dev = 0;
+    uint64_t ino = 0;
+    int64_t size = -1;
+    int64_t mtimeNs = 0;
+
+    bool operator==(const FileStamp& other) const noexcept;
+    bool operator!=(const FileStamp& other) const noexcept { return !(*this == other); }
+};
+
+/**
+ * An immutable, loaded source file.
+ */
+struct SourceFile {
+    // canonical path, used as the identity of the file
+    std::string path;
+    std::string contents;
+    // name of the include guard macro, or empty if the file is not guarded
+    std::string guard;
+    // taken just before the contents were read
+    FileStamp stamp;
+};
+
+/**
+ * Detect the multiple-include optimization pattern:
+ *
+ *     #ifndef X            (or #if !defined(X))
+ *     #define X
+ *     ...
+ *     #endif
+ *
+ * where the outer conditional has no #else/#elif and nothing but whitespace and comments
+ * appears before the #ifndef or after the #endif.
+ *
+ * @param src contents of a source file.
+ * @return the guard macro name, or an empty string if the file is not guarded.
+ */
+std::string detectIncludeGuard(const std::string& src);
+
+/**
+ * Process-wide cache of loaded source files. All methods are thread safe.
+ */
+class IncludeCache {
+private:
+    std::mutex lock;
+    std::unordered_map<std::string, std::shared_ptr<const SourceFile>> files;
+
+public:
+    static IncludeCache& global();
+
+    /**
+     * Load a file, reading it from disk only on first use.
+     *
+     * @param path path of the file to load. Paths are canonicalized on first use, so
+     * different spellings of the same file share an entry.
+     * @param error set to a description of the problem on failure.
+     * @return the loaded file, or nullptr on failure.
+     */
+    std::shared_ptr<const SourceFile> load(const std::string& path, std::string& error);
+
+    /**
+     * Check whether including a file would be a no-op without reopening it, i.e. the
+     * file has been loaded before, it has an include guard, and isDefined reports the
+     * guard macro as defined.
+     *
+     * @tparam Pred callable taking the guard macro name and returning bool.
+     */
+    template <typename Pred> bool canSkip(const std::string& path, Pred isDefined);
+
+    /**
+     * Drop the cached files that changed on disk (or disappeared) since they were read,
+     * so the next load reads them again. Long running processes such as the compile
+     * server call this before each compile; loads never check the disk themselves.
+     *
+     * @return the number of files dropped.
+     */
+    std::size_t revalidate();
+
+    /**
+     * Drop all cached files.
+     */
+    void clear();
+};
+
+/**
+ * Maps #include names to file paths for one translation unit. Lookups are memoized, so
+ * each distinct (directory, name) pair is searched for on disk only once, including
+ * failed lookups.
+ */
+class IncludeResolver {
+private:
+    std::vector<std::string> searchDirs;
+    std::unordered_map<std::string, std::string> memo;
+
+
+public:
+    /**
+     * @param userDirs directories given with -I, searched for both "" and <> includes.
+     * @param systemDirs system directories, searched after userDirs.
+     */
+    IncludeResolver(std::vector<std::string> userDirs,
+                    std::vector<std::string> systemDirs);
+
+    /**
+     * Resolve an include.
+     *
+     * @param name file name as written in the #include directive.
+     * @param includerDir directory of the including file, searched first for "" includes.
+     * @param angled true for <> includes.
+     * @param path set to the path of the file if found.
+     * @return true if the file was found.
+     */
+    bool resolve(const std::string& name, const std::string& includerDir, bool angled,
+                 std::string& path);
+};
+
+////////////////////////////////////
+// template function implementations
+////////////////////////////////////
+template <typename Pred>
+bool IncludeCache::canSkip(const std::string& path, Pred isDefined) {
+    std::shared_ptr<const SourceFile> file;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = files.find(path);
+        if (it == files.end()) {
+            return false;
+        }
+        file = it->second;
+    }
+    return !file->guard.empty() && isDefined(file->guard);
+}
+
+} // namespace Frontend
+
+#endif // INCLUDE_CACHE_H
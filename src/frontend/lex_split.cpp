@@ -0,0 +1,178 @@
+#include "lex_split.h"
+
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+namespace Frontend {
+
+namespace {
+
+enum class ScanState
+{
+    CODE,
+    STRING,
+    CHAR,
+    LINE_COMMENT,
+    BLOCK_COMMENT,
+};
+
+constexpr uint64_t ONES = 0x0101010101010101ULL;
+constexpr uint64_t LOW7 = 0x7F7F7F7F7F7F7F7FULL;
+
+/**
+ * Set of bytes that end a run of uninteresting characters. Newlines are always part of
+ * the set so that line numbers never need to be counted inside a skipped run.
+ */
+struct StopSet {
+    uint64_t pats[5];
+    int count;
+    bool table[256];
+
+    StopSet(const char* chars) : pats{}, count{0}, table{} {
+        for (; *chars; ++chars) {
+            unsigned char c = static_cast<unsigned char>(*chars);
+            pats[count++] = ONES * c;
+            table[c] = true;
+        }
+    }
+};
+
+// 0x80 in exactly those bytes of v that are zero
+inline uint64_t zeroBytes(uint64_t v) {
+    uint64_t t = (v & LOW7) + LOW7;
+    return ~(t | v | LOW7);
+}
+
+/**
+ * Return the first byte in [p, end) that is in the stop set, or end.
+ */
+inline const char* skipTo(const char* p, const char* end, const StopSet& stops) {
+    while (end - p >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        uint64_t hits = 0;
+        for (int i = 0; i < stops.count; ++i) {
+            hits |= zeroBytes(word ^ stops.pats[i]);
+        }
+        if (hits) {
+            // loads are little endian, so the lowest set bit is the first match
+            return p + __builtin_ctzll(hits) / 8;
+        }
+        p += 8;
+    }
+    while (p < end && !stops.table[static_cast<unsigned char>(*p)]) {
+        ++p;
+    }
+    return p;
+}
+
+} // namespace
+
+vector<SplitPoint> findSplitPoints(const char* data, size_t len, size_t chunkSize) {
+    static const StopSet codeStops("\"'/\\\n");
+    static const StopSet stringStops("\"\\\n");
+    static const StopSet charStops("'\\\n");
+    static const StopSet lineCommentStops("\\\n");
+    static const StopSet blockCommentStops("*\n");
+
+    vector<SplitPoint> splits;
+    const char* p = data;
+    const char* end = data + len;
+    size_t line = 1;
+    size_t nextSplit = chunkSize;
+    ScanState state = ScanState::CODE;
+
+    while (p < end) {
+        switch (state) {
+            case ScanState::CODE:
+                p = skipTo(p, end, codeStops);
+                if (p == end) {
+                    break;
+                }
+                if (*p == '\n') {
+                    ++line;
+                    ++p;
+                    size_t offset = static_cast<size_t>(p - data);
+                    if (offset >= nextSplit && p < end) {
+                        splits.push_back({offset, line});
+                        nextSplit = offset + chunkSize;
+                    }
+                } else if (*p == '"') {
+                    state = ScanState::STRING;
+                    ++p;
+                } else if (*p == '\'') {
+                    state = ScanState::CHAR;
+                    ++p;
+                } else if (*p == '/' && p + 1 < end && p[1] == '/') {
+                    state = ScanState::LINE_COMMENT;
+                    p += 2;
+                } else if (*p == '/' && p + 1 < end && p[1] == '*') {
+                    state = ScanState::BLOCK_COMMENT;
+                    p += 2;
+                } else if (*p == '\\' && p + 1 < end && p[1] == '\n') {
+                    // line splice: the next line continues this one, so it is not a split
+                    ++line;
+                    p += 2;
+                } else {
+                    ++p;
+                }
+                break;
+            case ScanState::STRING:
+            case ScanState::CHAR:
+                p = skipTo(p, end, state == ScanState::STRING ? stringStops : charStops);
+                if (p == end) {
+                    break;
+                }
+                if (*p == '\\') {
+                    if (p + 1 < end && p[1] == '\n') {
+                        ++line;
+                    }
+                    // a backslash at the very end escapes nothing
+                    p += p + 1 < end ? 2 : 1;
+                } else if (*p == '\n') {
+                    // unterminated literal; the lexer reports it and resumes on this line
+                    state = ScanState::CODE;
+                } else {
+                    state = ScanState::CODE;
+                    ++p;
+                }
+                break;
+            case ScanState::LINE_COMMENT:
+                p = skipTo(p, end, lineCommentStops);
+                if (p == end) {
+                    break;
+                }
+                if (*p == '\\') {
+                    if (p + 1 < end && p[1] == '\n') {
+                        ++line;
+                    }
+                    // a backslash at the very end escapes nothing
+                    p += p + 1 < end ? 2 : 1;
+                } else {
+                    // leave the newline for the CODE state so it can become a split
+                    state = ScanState::CODE;
+                }
+                break;
+            case ScanState::BLOCK_COMMENT:
+                p = skipTo(p, end, blockCommentStops);
+                if (p == end) {
+                    break;
+                }
+                if (*p == '\n') {
+                    ++line;
+                    ++p;
+                } else if (p + 1 < end && p[1] == '/') {
+                    state = ScanState::CODE;
+                    p += 2;
+                } else {
+                    ++p;
+                }
+                break;
+        }
+    }
+    return splits;
+}
+
+} // namespace Frontend
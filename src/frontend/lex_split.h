@@ -0,0 +1,121 @@
+/**
+ * Support for tokenizing large source files in parallel.
+ *
+ * A quick pre-scan finds line starts where the lexer is guaranteed to be in its initial
+ * state (outside comments, literals and spliced lines). Chunks between those points can
+ * then be tokenized independently and the token buffers concatenated in order.
+ */
+#ifndef LEX_SPLIT_H
+#define LEX_SPLIT_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+#include "fds/arrayref.h"
+#include "util/timetrace.h"
+
+namespace Frontend {
+
+/**
+ * A safe place to start a new lexer.
+ */
+struct SplitPoint {
+    // byte offset of the first character of the line
+    std::size_t offset;
+    // 1-based line number of that line, for seeding the chunk's location tracking
+    std::size_t line;
+};
+
+/**
+ * Find split points roughly chunkSize bytes apart. Each returned point is the first line
+ * start at or after the previous point plus chunkSize that the lexer can safely start
+ * at. The scan skips runs of uninteresting bytes eight at a time.
+ *
+ * @param data source text.
+ * @param len length of the source text.
+ * @param chunkSize target distance between split points, must be non-zero.
+ * @return split points in increasing order; the chunk before the first point starts at
+ * offset 0 on line 1.
+ */
+std::vector<SplitPoint> findSplitPoints(const char* data, std::size_t len,
+                                        std::size_t chunkSize);
+
+/**
+ * Tokenize chunks of a source file in parallel and stitch the results in source order.
+ * The calling thread and up to threads - 1 freshly started ones take chunks off a shared
+ * counter until none are left.
+ *
+ * @tparam Tok token type.
+ * @tparam LexFn callable as lexChunk(begin, end, firstLine, tokens), which appends the
+ * tokens of [begin, end) to tokens. It is called concurrently and must not throw.
+ * @param data source text.
+ * @param len length of the source text.
+ * @param splits split points from findSplitPoints.
+ * @param lexChunk chunk tokenizer.
+ * @param threads maximum number of threads to use (0 picks the hardware concurrency).
+ * @return all tokens of the file, in order.
+ */
+template <typename Tok, typename LexFn>
+std::vector<Tok> lexParallel(const char* data, std::size_t len,
+                             ArrayRef<SplitPoint> splits, LexFn lexChunk,
+                             unsigned threads = 0);
+
+////////////////////////////////////
+// template function implementations
+////////////////////////////////////
+template <typename Tok, typename LexFn>
+std::vector<Tok> lexParallel(const char* data, std::size_t len,
+                             ArrayRef<SplitPoint> splits, LexFn lexChunk,
+                             unsigned threads) {
+    TIME_SCOPE("lex");
+    std::size_t numChunks = splits.size() + 1;
+    std::vector<std::vector<Tok>> buffers(numChunks);
+    std::atomic<std::size_t> nextChunk{0};
+
+    auto worker = [&]() {
+        // one event per thread, so the trace shows how well the chunks spread
+        TIME_SCOPE("lex_worker");
+        std::size_t chunk;
+        while ((chunk = nextChunk++) < numChunks) {
+            std::size_t begin = chunk == 0 ? 0 : splits[chunk - 1].offset;
+            std::size_t end = chunk == splits.size() ? len : splits[chunk].offset;
+            std::size_t line = chunk == 0 ? 1 : splits[chunk - 1].line;
+            lexChunk(data + begin, data + end, line, buffers[chunk]);
+        }
+    };
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::size_t numThreads = std::min<std::size_t>(threads, numChunks);
+    std::vector<std::thread> pool;
+    for (std::size_t i = 1; i < numThreads; ++i) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+
+    if (numChunks == 1) {
+        return std::move(buffers[0]);
+    }
+    std::size_t total = 0;
+    for (const std::vector<Tok>& buf : buffers) {
+        total += buf.size();
+    }
+    std::vector<Tok> tokens;
+    tokens.reserve(total);
+    for (std::vector<Tok>& buf : buffers) {
+        std::move(buf.begin(), buf.end(), std::back_inserter(tokens));
+    }
+    return tokens;
+}
+
+} // namespace Frontend
+
+#endif // LEX_SPLIT_H
@@ -0,0 +1,189 @@
+#ifndef SYMTAB_H
+#define SYMTAB_H
+
+#include <cstdint>
+#include <vector>
+
+#include "debug_macros.h"
+#include "fds/interner.h"
+
+namespace Frontend {
+
+/**
+ * Symbol table for C block scopes, keyed by interned identifier.
+ *
+ * All scopes share one flat open addressing table that maps a name to its innermost
+ * binding. Every binding records the binding it shadows, so each name has a chain of
+ * bindings from innermost to outermost scope. Bindings are appended to a single undo log
+ * in declaration order, and a scope is just a position in that log: popping a scope
+ * truncates the log and restores one chain head per binding, with no hashing, erasing
+ * or freeing. Entering a scope does no allocation at all.
+ *
+ * @tparam T data bound to a name (e.g. a declaration pointer).
+ */
+template <typename T> class SymbolTable {
+public:
+    using Name = StringInterner::Id;
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    static constexpr Name EMPTY_KEY = UINT32_MAX;
+
+    struct Slot {
+        Name name;
+        // index of the innermost binding in the undo log, or NONE if the name is unbound
+        uint32_t head;
+    };
+
+    struct Binding {
+        Name name;
+        // binding this one shadows
+        uint32_t shadowed;
+        uint32_t depth;
+        T value;
+    };
+
+    std::vector<Slot> slots;
+    std::size_t usedSlots;
+    std::vector<Binding> log;
+    std::vector<uint32_t> scopeStarts;
+
+    Slot& findSlot(Name name);
+    const Slot* findSlot(Name name) const;
+    void grow();
+
+public:
+    SymbolTable();
+
+    void pushScope();
+    /**
+     * Leave the innermost scope, unbinding every name declared in it.
+     */
+    void popScope();
+    /**
+     * Number of open scopes. The file scope opened by the constructor counts as one.
+     */
+    std::size_t depth() const noexcept;
+
+    /**
+     * Bind a name in the innermost scope.
+     *
+     * @return false if the name is already bound in the innermost scope.
+     */
+    bool insert(Name name, T value);
+    /**
+     * Find the innermost binding of a name.
+     *
+     * @return the bound value, or nullptr if the name is not in scope.
+     */
+    T* lookup(Name name);
+    const T* lookup(Name name) const;
+    /**
+     * Find a binding of a name in the innermost scope only.
+     */
+    T* lookupLocal(Name name);
+};
+
+////////////////////////////////////
+// template function implementations
+////////////////////////////////////
+template <typename T>
+SymbolTable<T>::SymbolTable() : slots(64, {EMPTY_KEY, NONE}), usedSlots{0} {
+    scopeStarts.push_back(0);
+}
+
+template <typename T>
+typename SymbolTable<T>::Slot& SymbolTable<T>::findSlot(Name name) {
+    // Fibonacci hashing spreads the dense interner ids over the table; linear probing
+    // keeps the probe sequence in cache.
+    std::size_t mask = slots.size() - 1;
+    std::size_t idx = ((name * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    while (slots[idx].name != name && slots[idx].name != EMPTY_KEY) {
+        idx = (idx + 1) & mask;
+    }
+    return slots[idx];
+}
+
+template <typename T>
+const typename SymbolTable<T>::Slot* SymbolTable<T>::findSlot(Name name) const {
+    std::size_t mask = slots.size() - 1;
+    std::size_t idx = ((name * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    while (slots[idx].name != EMPTY_KEY) {
+        if (slots[idx].name == name) {
+            return &slots[idx];
+        }
+        idx = (idx + 1) & mask;
+    }
+    return nullptr;
+}
+
+template <typename T> void SymbolTable<T>::grow() {
+    // Slots are never deleted (an unbound name just has an empty chain), so a rehash
+    // only needs to reinsert the occupied slots.
+    std::vector<Slot> old(slots.size() * 2, {EMPTY_KEY, NONE});
+    old.swap(slots);
+    for (const Slot& slot : old) {
+        if (slot.name != EMPTY_KEY) {
+            findSlot(slot.name) = slot;
+        }
+    }
+}
+
+template <typename T> inline void SymbolTable<T>::pushScope() {
+    scopeStarts.push_back(static_cast<uint32_t>(log.size()));
+}
+
+template <typename T> void SymbolTable<T>::popScope() {
+    ENSURE(scopeStarts.size() > 1);
+    uint32_t start = scopeStarts.back();
+    scopeStarts.pop_back();
+    for (std::size_t i = log.size(); i-- > start;) {
+        findSlot(log[i].name).head = log[i].shadowed;
+    }
+    log.erase(log.begin() + start, log.end());
+}
+
+template <typename T> inline std::size_t SymbolTable<T>::depth() const noexcept {
+    return scopeStarts.size();
+}
+
+template <typename T> bool SymbolTable<T>::insert(Name name, T value) {
+    ENSURE(name != EMPTY_KEY);
+    // keep the load factor at or below 1/2
+    if ((usedSlots + 1) * 2 > slots.size()) {
+        grow();
+    }
+    Slot& slot = findSlot(name);
+    if (slot.name == EMPTY_KEY) {
+        slot.name = name;
+        ++usedSlots;
+    } else if (slot.head != NONE && log[slot.head].depth == scopeStarts.size()) {
+        return false;
+    }
+    uint32_t depth = static_cast<uint32_t>(scopeStarts.size());
+    log.push_back({name, slot.head, depth, std::move(value)});
+    slot.head = static_cast<uint32_t>(log.size() - 1);
+    return true;
+}
+
+template <typename T> T* SymbolTable<T>::lookup(Name name) {
+    Slot& slot = findSlot(name);
+    return slot.head == NONE ? nullptr : &log[slot.head].value;
+}
+
+template <typename T> const T* SymbolTable<T>::lookup(Name name) const {
+    const Slot* slot = findSlot(name);
+    return !slot || slot->head == NONE ? nullptr : &log[slot->head].value;
+}
+
+template <typename T> T* SymbolTable<T>::lookupLocal(Name name) {
+    Slot& slot = findSlot(name);
+    if (slot.head == NONE || log[slot.head].depth != scopeStarts.size()) {
+        return nullptr;
+    }
+    return &log[slot.head].value;
+}
+
+} // namespace Frontend
+
+#endif // SYMTAB_H
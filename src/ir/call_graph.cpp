@@ -0,0 +1,81 @@
+#include "call_graph.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+namespace IR {
+
+CallGraph::FuncId CallGraph::addFunction(std::string name, std::size_t instrCount,
+                                         bool external) {
+    return graph.addNode({move(name), instrCount, external});
+}
+
+CallGraph::SiteId CallGraph::addCall(FuncId caller, FuncId callee, unsigned constArgs,
+                                     double freq) {
+    return graph.addEdge(caller, callee, {constArgs, freq});
+}
+
+vector<vector<CallGraph::FuncId>> CallGraph::bottomUpSCCs() const {
+    // Iterative Tarjan. Tarjan emits a component only once every component reachable
+    // from it has been emitted, which is exactly the bottom-up order we want.
+    constexpr size_t UNVISITED = numeric_limits<size_t>::max();
+    size_t n = graph.numNodes();
+    vector<size_t> index(n, UNVISITED);
+    vector<size_t> lowlink(n, 0);
+    vector<bool> onStack(n, false);
+    vector<FuncId> stack;
+    // explicit DFS stack of (node, next successor edge position)
+    vector<pair<FuncId, size_t>> dfs;
+    vector<vector<FuncId>> sccs;
+    size_t nextIndex = 0;
+
+    for (FuncId root = 0; root < n; ++root) {
+        if (index[root] != UNVISITED) {
+            continue;
+        }
+        dfs.emplace_back(root, 0);
+        index[root] = lowlink[root] = nextIndex++;
+        stack.push_back(root);
+        onStack[root] = true;
+
+        while (!dfs.empty()) {
+            FuncId v = dfs.back().first;
+            size_t& pos = dfs.back().second;
+            ArrayRef<SiteId> out = graph.succEdges(v);
+            if (pos < out.size()) {
+                FuncId w = graph.edge(out[pos++]).dst;
+                if (index[w] == UNVISITED) {
+                    index[w] = lowlink[w] = nextIndex++;
+                    stack.push_back(w);
+                    onStack[w] = true;
+                    dfs.emplace_back(w, 0);
+                } else if (onStack[w]) {
+                    lowlink[v] = min(lowlink[v], index[w]);
+                }
+                continue;
+            }
+            // all successors done, v is finished
+            dfs.pop_back();
+            if (!dfs.empty()) {
+                FuncId parent = dfs.back().first;
+                lowlink[parent] = min(lowlink[parent], lowlink[v]);
+            }
+            if (lowlink[v] == index[v]) {
+                vector<FuncId> scc;
+                FuncId w;
+                do {
+                    w = stack.back();
+                    stack.pop_back();
+                    onStack[w] = false;
+                    scc.push_back(w);
+                } while (w != v);
+                sccs.emplace_back(move(scc));
+            }
+        }
+    }
+    return sccs;
+}
+
+} // namespace IR
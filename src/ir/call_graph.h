@@ -1 +1,74 @@
- 
+#ifndef CALL_GRAPH_H
+#define CALL_GRAPH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "fds/densegraph.h"
+
+namespace IR {
+
+/**
+ * Per-function data tracked by the call graph.
+ */
+struct FunctionNode {
+    std::string name;
+    // number of IR instructions in the function body (0 for external declarations)
+    std::size_t instrCount;
+    // true if the body is not available in this TU and can never be inlined
+    bool external;
+};
+
+/**
+ * Per-call-site data tracked by the call graph. Each call instruction gets its own edge,
+ * so a caller that calls the same callee twice has two parallel edges.
+ */
+struct CallSite {
+    // number of arguments at this site that are compile time constants
+    unsigned constArgs;
+    // expected executions of this site per invocation of the caller. Static estimates are
+    // used until profile data is available.
+    double freq;
+};
+
+/**
+ * Module level call graph. Nodes are functions and edges are call sites.
+ */
+class CallGraph {
+public:
+    using FuncId = DenseGraph<FunctionNode, CallSite>::NodeId;
+    using SiteId = DenseGraph<FunctionNode, CallSite>::EdgeId;
+
+private:
+    DenseGraph<FunctionNode, CallSite> graph;
+
+public:
+    FuncId addFunction(std::string name, std::size_t instrCount, bool external = false);
+    SiteId addCall(FuncId caller, FuncId callee, unsigned constArgs = 0,
+                   double freq = 1.0);
+
+    /**
+     * Compute the strongly connected components of the graph in bottom-up order, i.e.
+     * every component is listed before any component that calls into it. Functions in the
+     * same component are mutually recursive (or a single self-recursive function).
+     *
+     * Runs in O(V + E) and does not recurse, so it is safe on very deep call chains.
+     */
+    std::vector<std::vector<FuncId>> bottomUpSCCs() const;
+
+    const DenseGraph<FunctionNode, CallSite>& getGraph() const noexcept;
+    DenseGraph<FunctionNode, CallSite>& getGraph() noexcept;
+};
+
+inline const DenseGraph<FunctionNode, CallSite>& CallGraph::getGraph() const noexcept {
+    return graph;
+}
+
+inline DenseGraph<FunctionNode, CallSite>& CallGraph::getGraph() noexcept {
+    return graph;
+}
+
+} // namespace IR
+
+#endif // CALL_GRAPH_H
@@ -1 +1,140 @@
- 
+#ifndef CONTROL_GRAPH_H
+#define CONTROL_GRAPH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "fds/densegraph.h"
+
+namespace IR {
+
+/**
+ * Per-block data tracked by the control graph.
+ */
+struct BlockNode {
+    std::string label;
+    // execution count from the profile, only meaningful if the graph has a profile
+    uint64_t count;
+};
+
+/**
+ * Per-edge data tracked by the control graph.
+ */
+struct ControlEdge {
+    // static estimate of the probability of taking this edge out of its source block.
+    // Negative means unknown, in which case successors are assumed equally likely.
+    double prob;
+    // execution count from the profile, only meaningful if the graph has a profile
+    uint64_t count;
+};
+
+/**
+ * Control flow graph of a single function. Blocks with no successors are exits.
+ */
+class ControlGraph {
+public:
+    using BlockId = DenseGraph<BlockNode, ControlEdge>::NodeId;
+    using EdgeId = DenseGraph<BlockNode, ControlEdge>::EdgeId;
+
+private:
+    DenseGraph<BlockNode, ControlEdge> graph;
+    BlockId entry;
+    bool profiled;
+
+public:
+    ControlGraph();
+
+    BlockId addBlock(std::string label);
+    EdgeId addEdge(BlockId src, BlockId dst, double prob = -1.0);
+
+    BlockId getEntry() const noexcept;
+    void setEntry(BlockId block) noexcept;
+    std::vector<BlockId> exits() const;
+
+    /**
+     * Probability of taking an edge, falling back to a uniform split over the source
+     * block's successors if no estimate was given.
+     */
+    double edgeProb(EdgeId edge) const;
+
+    /**
+     * Execution frequency of a block relative to the function entry. Uses profile counts
+     * if available and returns 1.0 otherwise.
+     */
+    double blockFreq(BlockId block) const;
+
+    bool hasProfile() const noexcept;
+    void setHasProfile(bool val) noexcept;
+
+    const DenseGraph<BlockNode, ControlEdge>& getGraph() const noexcept;
+    DenseGraph<BlockNode, ControlEdge>& getGraph() noexcept;
+};
+
+///////////////////////////////////////////
+// Implement inline accessors
+///////////////////////////////////////////
+inline ControlGraph::ControlGraph() : entry{0}, profiled{false} {
+}
+
+inline ControlGraph::BlockId ControlGraph::addBlock(std::string label) {
+    return graph.addNode({std::move(label), 0});
+}
+
+inline ControlGraph::EdgeId ControlGraph::addEdge(BlockId src, BlockId dst, double prob) {
+    return graph.addEdge(src, dst, {prob, 0});
+}
+
+inline ControlGraph::BlockId ControlGraph::getEntry() const noexcept {
+    return entry;
+}
+
+inline void ControlGraph::setEntry(BlockId block) noexcept {
+    entry = block;
+}
+
+inline std::vector<ControlGraph::BlockId> ControlGraph::exits() const {
+    std::vector<BlockId> out;
+    for (BlockId b = 0; b < graph.numNodes(); ++b) {
+        if (graph.succEdges(b).empty()) {
+            out.push_back(b);
+        }
+    }
+    return out;
+}
+
+inline double ControlGraph::edgeProb(EdgeId edge) const {
+    const auto& e = graph.edge(edge);
+    if (e.data.prob >= 0.0) {
+        return e.data.prob;
+    }
+    return 1.0 / static_cast<double>(graph.succEdges(e.src).size());
+}
+
+inline double ControlGraph::blockFreq(BlockId block) const {
+    uint64_t entryCount = graph.node(entry).count;
+    if (!profiled || entryCount == 0) {
+        return 1.0;
+    }
+    return static_cast<double>(graph.node(block).count) / static_cast<double>(entryCount);
+}
+
+inline bool ControlGraph::hasProfile() const noexcept {
+    return profiled;
+}
+
+inline void ControlGraph::setHasProfile(bool val) noexcept {
+    profiled = val;
+}
+
+inline const DenseGraph<BlockNode, ControlEdge>& ControlGraph::getGraph() const noexcept {
+    return graph;
+}
+
+inline DenseGraph<BlockNode, ControlEdge>& ControlGraph::getGraph() noexcept {
+    return graph;
+}
+
+} // namespace IR
+
+#endif // CONTROL_GRAPH_H
@@ -0,0 +1,107 @@
+#include "inliner.h"
+
+#include "util/timetrace.h"
+
+using namespace std;
+
+namespace IR {
+
+Inliner::Inliner(InlineParams params) : params{params} {
+}
+
+long Inliner::siteCost(std::size_t calleeSize, const CallSite& site) const {
+    return static_cast<long>(calleeSize) - params.callOverhead -
+           static_cast<long>(site.constArgs) * params.constArgBonus;
+}
+
+long Inliner::siteThreshold(const CallSite& site) const {
+    if (site.freq <= params.coldFreq) {
+        // only inline cold sites if doing so makes the caller smaller
+        return 0;
+    }
+    if (site.freq >= params.hotFreq) {
+        return params.threshold * params.hotMultiplier;
+    }
+    return params.threshold;
+}
+
+vector<InlineDecision> Inliner::run(CallGraph& cg) {
+    TIME_SCOPE("inline");
+    DenseGraph<FunctionNode, CallSite>& g = cg.getGraph();
+    stats = InlineStats();
+
+    long moduleSize = 0;
+    for (CallGraph::FuncId f = 0; f < g.numNodes(); ++f) {
+        if (!g.node(f).external) {
+            moduleSize += static_cast<long>(g.node(f).instrCount);
+        }
+    }
+    stats.moduleSizeBefore = static_cast<size_t>(moduleSize);
+    const long growthPct = static_cast<long>(params.maxModuleGrowthPct);
+    const long moduleCap = moduleSize * growthPct / 100;
+    const long callerCap = static_cast<long>(params.maxCallerSize);
+
+    vector<vector<CallGraph::FuncId>> sccs = cg.bottomUpSCCs();
+    vector<size_t> sccOf(g.numNodes());
+    for (size_t i = 0; i < sccs.size(); ++i) {
+        for (CallGraph::FuncId f : sccs[i]) {
+            sccOf[f] = i;
+        }
+    }
+
+    vector<InlineDecision> decisions;
+    for (const vector<CallGraph::FuncId>& scc : sccs) {
+        for (CallGraph::FuncId caller : scc) {
+            if (g.node(caller).external) {
+                continue;
+            }
+            for (CallGraph::SiteId site : g.succEdges(caller)) {
+                const auto& edge = g.edge(site);
+                const FunctionNode& callee = g.node(edge.dst);
+                ++stats.sitesConsidered;
+
+                if (callee.external) {
+                    ++stats.rejectedExternal;
+                    continue;
+                }
+                if (sccOf[edge.dst] == sccOf[caller]) {
+                    ++stats.rejectedRecursive;
+                    continue;
+                }
+                if (decisions.size() >= params.maxInlines) {
+                    ++stats.rejectedBudget;
+                    continue;
+                }
+                long cost = siteCost(callee.instrCount, edge.data);
+                if (cost > siteThreshold(edge.data)) {
+                    ++stats.rejectedCost;
+                    continue;
+                }
+                // the callee body is copied into the caller and the call goes away; the
+                // callee itself stays as it may have other callers
+                long growth = static_cast<long>(callee.instrCount) - params.callOverhead;
+                long callerSize = static_cast<long>(g.node(caller).instrCount);
+                if (growth > 0 && callerSize + growth > callerCap) {
+                    ++stats.rejectedCallerSize;
+                    continue;
+                }
+                if (growth > 0 && moduleSize + growth > moduleCap) {
+                    ++stats.rejectedModuleSize;
+                    continue;
+                }
+
+                // a caller can't shrink below empty, and the module shrinks by no more
+                // than the caller did
+                long newSize = callerSize + growth > 0 ? callerSize + growth : 0;
+                g.node(caller).instrCount = static_cast<size_t>(newSize);
+                moduleSize += newSize - callerSize;
+                decisions.push_back({caller, edge.dst, site, cost});
+            }
+        }
+    }
+    stats.inlined = decisions.size();
+    stats.moduleSizeAfter = static_cast<size_t>(moduleSize);
+    return decisions;
+}
+
+} // namespace IR
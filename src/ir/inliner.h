@@ -0,0 +1,109 @@
+#ifndef INLINER_H
+#define INLINER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "ir/call_graph.h"
+
+namespace IR {
+
+/**
+ * Tunables for the inline cost model. Sizes are measured in IR instructions.
+ */
+struct InlineParams {
+    // instructions saved by removing the call, return and argument shuffling
+    long callOverhead = 5;
+    // instructions we expect to fold away per constant argument
+    long constArgBonus = 8;
+    // a site is inlined if its adjusted cost is at or below this threshold
+    long threshold = 40;
+    // sites executed at least this often per caller invocation are considered hot
+    double hotFreq = 8.0;
+    // threshold multiplier applied to hot sites
+    long hotMultiplier = 4;
+    // sites with a frequency at or below this are cold and only inlined if that shrinks
+    // the caller
+    double coldFreq = 0.05;
+    // no caller may grow beyond this many instructions through inlining
+    std::size_t maxCallerSize = 4000;
+    // total module size may not grow beyond this percentage of its original size
+    std::size_t maxModuleGrowthPct = 150;
+    // hard cap on the number of sites inlined, to bound compile time
+    std::size_t maxInlines = 100000;
+};
+
+/**
+ * A single accepted inlining decision.
+ */
+struct InlineDecision {
+    CallGraph::FuncId caller;
+    CallGraph::FuncId callee;
+    CallGraph::SiteId site;
+    long cost;
+};
+
+/**
+ * Summary counters for the stats output.
+ */
+struct InlineStats {
+    std::size_t sitesConsidered = 0;
+    std::size_t inlined = 0;
+    std::size_t rejectedCost = 0;
+    std::size_t rejectedCallerSize = 0;
+    std::size_t rejectedModuleSize = 0;
+    std::size_t rejectedRecursive = 0;
+    std::size_t rejectedExternal = 0;
+    std::size_t rejectedBudget = 0;
+    std::size_t moduleSizeBefore = 0;
+    std::size_t moduleSizeAfter = 0;
+};
+
+/**
+ * Bottom-up inliner driven by a size/benefit cost model.
+ *
+ * Functions are visited callee first (see CallGraph::bottomUpSCCs), so the size used
+ * for a callee already includes everything inlined into it. Calls within a recursive
+ * component are never inlined.
+ */
+class Inliner {
+private:
+    InlineParams params;
+    InlineStats stats;
+
+public:
+    explicit Inliner(InlineParams params = {});
+
+    /**
+     * Cost of inlining callee at a site. Lower is better, and a negative cost means that
+     * inlining is expected to shrink the caller.
+     *
+     * @param calleeSize current instruction count of the callee.
+     * @param site the call site being considered.
+     * @return the adjusted cost of the site.
+     */
+    long siteCost(std::size_t calleeSize, const CallSite& site) const;
+    /**
+     * Threshold a site's cost is compared against, scaled by the site frequency.
+     */
+    long siteThreshold(const CallSite& site) const;
+
+    /**
+     * Decide which call sites to inline. The instruction counts in the graph are updated
+     * to reflect the post-inlining sizes.
+     *
+     * @param cg call graph of the module.
+     * @return accepted decisions in the order they must be applied.
+     */
+    std::vector<InlineDecision> run(CallGraph& cg);
+
+    const InlineStats& getStats() const noexcept;
+};
+
+inline const InlineStats& Inliner::getStats() const noexcept {
+    return stats;
+}
+
+} // namespace IR
+
+#endif // INLINER_H
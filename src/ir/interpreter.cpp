@@ -0,0 +1,495 @@
+#include "interpreter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "debug_macros.h"
+
+// labels as values turn the dispatch into one indirect jump per instruction, each at its
+// own site, which branch predictors handle far better than the shared jump of a switch
+#if defined(__GNUC__)
+#define THREADED_DISPATCH 1
+#endif
+
+using namespace std;
+
+namespace IR {
+
+namespace {
+
+bool isBinary(BcOp op) {
+    return (op >= BcOp::ADD && op <= BcOp::SAR) || (op >= BcOp::EQ && op <= BcOp::ULE);
+}
+
+bool isJump(BcOp op) {
+    return op == BcOp::JMP || op == BcOp::JNZ || op == BcOp::JZ;
+}
+
+// arithmetic wraps around, as it does in the generated code
+int64_t wrap(uint64_t val) {
+    return static_cast<int64_t>(val);
+}
+
+} // namespace
+
+BcBuilder::BcBuilder(std::string name, uint16_t numParams) {
+    out.name = move(name);
+    out.numParams = numParams;
+    out.numRegs = numParams;
+}
+
+void BcBuilder::emit(BcOp op, Reg a, Reg b, Reg c, int32_t imm) {
+    out.code.push_back({op, a, b, c, imm});
+}
+
+BcBuilder::Reg BcBuilder::newReg() {
+    ENSURE(out.numRegs < UINT16_MAX);
+    return out.numRegs++;
+}
+
+BcBuilder::Reg BcBuilder::param(uint16_t idx) const {
+    BOUND_CHK_LT(idx, out.numParams);
+    return idx;
+}
+
+BcBuilder::Label BcBuilder::newLabel() {
+    labels.push_back(UNBOUND);
+    return static_cast<Label>(labels.size() - 1);
+}
+
+void BcBuilder::bind(Label label) {
+    BOUND_CHK_LT(label, labels.size());
+    labels[label] = static_cast<uint32_t>(out.code.size());
+}
+
+void BcBuilder::mov(Reg dst, Reg src) {
+    emit(BcOp::MOV, dst, src, 0, 0);
+}
+
+void BcBuilder::movImm(Reg dst, int64_t val) {
+    if (val >= INT32_MIN && val <= INT32_MAX) {
+        emit(BcOp::MOVI, dst, 0, 0, static_cast<int32_t>(val));
+    } else {
+        out.consts.push_back(val);
+        emit(BcOp::MOVK, dst, 0, 0, static_cast<int32_t>(out.consts.size() - 1));
+    }
+}
+
+void BcBuilder::binary(BcOp op, Reg dst, Reg lhs, Reg rhs) {
+    ENSURE(isBinary(op));
+    emit(op, dst, lhs, rhs, 0);
+}
+
+void BcBuilder::addImm(Reg dst, Reg src, int32_t imm) {
+    emit(BcOp::ADDI, dst, src, 0, imm);
+}
+
+void BcBuilder::unary(BcOp op, Reg dst, Reg src) {
+    ENSURE(op == BcOp::NEG || op == BcOp::NOT);
+    emit(op, dst, src, 0, 0);
+}
+
+void BcBuilder::jmp(Label target) {
+    BOUND_CHK_LT(target, labels.size());
+    fixups.push_back(static_cast<uint32_t>(out.code.size()));
+    emit(BcOp::JMP, 0, 0, 0, static_cast<int32_t>(target));
+}
+
+void BcBuilder::jnz(Reg cond, Label target) {
+    BOUND_CHK_LT(target, labels.size());
+    fixups.push_back(static_cast<uint32_t>(out.code.size()));
+    emit(BcOp::JNZ, cond, 0, 0, static_cast<int32_t>(target));
+}
+
+void BcBuilder::jz(Reg cond, Label target) {
+    BOUND_CHK_LT(target, labels.size());
+    fixups.push_back(static_cast<uint32_t>(out.code.size()));
+    emit(BcOp::JZ, cond, 0, 0, static_cast<int32_t>(target));
+}
+
+void BcBuilder::load(Reg dst, Reg addr, int32_t offset) {
+    emit(BcOp::LOAD, dst, addr, 0, offset);
+}
+
+void BcBuilder::loadByte(Reg dst, Reg addr, int32_t offset) {
+    emit(BcOp::LOADB, dst, addr, 0, offset);
+}
+
+void BcBuilder::store(Reg src, Reg addr, int32_t offset) {
+    emit(BcOp::STORE, src, addr, 0, offset);
+}
+
+void BcBuilder::storeByte(Reg src, Reg addr, int32_t offset) {
+    emit(BcOp::STOREB, src, addr, 0, offset);
+}
+
+void BcBuilder::call(Reg dst, uint32_t func, Reg firstArg, uint16_t numArgs) {
+    emit(BcOp::CALL, dst, firstArg, numArgs, static_cast<int32_t>(func));
+}
+
+void BcBuilder::ret(Reg val) {
+    emit(BcOp::RET, val, 0, 0, 0);
+}
+
+BcFunction BcBuilder::finish() {
+    for (uint32_t idx : fixups) {
+        uint32_t target = labels[static_cast<uint32_t>(out.code[idx].imm)];
+        ENSURE(target != UNBOUND);
+        out.code[idx].imm = static_cast<int32_t>(target);
+    }
+    labels.clear();
+    fixups.clear();
+    BcFunction func = move(out);
+    out = BcFunction();
+    return func;
+}
+
+Util::Expected<Interpreter> Interpreter::create(ArrayRef<BcFunction> program,
+                                                std::size_t memorySize,
+                                                InterpreterLimits limits) {
+    auto fail = [](const BcFunction& func, const string& msg) {
+        return Util::Unexpected(Util::Error("bytecode of '" + func.name + "': " + msg));
+    };
+
+    Interpreter interp;
+    interp.limits = limits;
+    interp.mem.assign(memorySize, 0);
+    size_t total = 0;
+    for (const BcFunction& func : program) {
+        if (func.numParams > func.numRegs) {
+            return fail(func, "more parameters than registers");
+        }
+        interp.funcs.push_back({total, func.numParams, func.numRegs});
+        interp.names.push_back(func.name);
+        total += func.code.size();
+    }
+
+    // validate everything the interpreter loop relies on, so that it checks nothing
+    // but the values computed at run time
+    for (const BcFunction& func : program) {
+        if (func.code.empty() ||
+            (func.code.back().op != BcOp::RET && func.code.back().op != BcOp::JMP)) {
+            return fail(func, "control reaches the end of the code");
+        }
+        for (const BcInsn& insn : func.code) {
+            bool usesA = insn.op != BcOp::JMP;
+            bool usesB = insn.op == BcOp::MOV || isBinary(insn.op) ||
+                         (insn.op >= BcOp::ADDI && insn.op <= BcOp::NOT) ||
+                         (insn.op >= BcOp::LOAD && insn.op <= BcOp::STOREB);
+            if ((usesA && insn.a >= func.numRegs) || (usesB && insn.b >= func.numRegs) ||
+                (isBinary(insn.op) && insn.c >= func.numRegs)) {
+                return fail(func, "register out of range");
+            }
+            uint32_t imm = static_cast<uint32_t>(insn.imm);
+            if (isJump(insn.op) && imm >= func.code.size()) {
+                return fail(func, "jump target out of range");
+            }
+            if (insn.op == BcOp::MOVK && imm >= func.consts.size()) {
+                return fail(func, "constant out of range");
+            }
+            if (insn.op == BcOp::CALL) {
+                if (imm >= program.size()) {
+                    return fail(func, "callee out of range");
+                }
+                if (insn.c != program[imm].numParams ||
+                    insn.b + insn.c > func.numRegs) {
+                    return fail(func, "bad arguments for '" + program[imm].name + "'");
+                }
+            }
+        }
+    }
+
+    // decode; the code is sized up front, as jumps point into it
+    const void* const* table = nullptr;
+    interp.execute(nullptr, &table);
+    interp.code.resize(total);
+    for (size_t f = 0; f < program.size(); ++f) {
+        const BcFunction& func = program[f];
+        Decoded* out = interp.code.data() + interp.funcs[f].entry;
+        for (size_t i = 0; i < func.code.size(); ++i) {
+            const BcInsn& insn = func.code[i];
+            Decoded& dec = out[i];
+            dec.op = insn.op;
+            dec.a = insn.a;
+            dec.b = insn.b;
+            dec.c = insn.c;
+            if (insn.op == BcOp::MOVK) {
+                // constants are inlined, so MOVK is just a wide MOVI
+                dec.op = BcOp::MOVI;
+                dec.imm = func.consts[insn.imm];
+            } else if (isJump(insn.op)) {
+                dec.target = out + insn.imm;
+            } else {
+                dec.imm = insn.imm;
+            }
+            dec.handler = table ? table[static_cast<size_t>(dec.op)] : nullptr;
+        }
+    }
+    return Util::Expected<Interpreter>(move(interp));
+}
+
+Util::Expected<int64_t> Interpreter::run(uint32_t func, ArrayRef<int64_t> args) {
+    if (func >= funcs.size()) {
+        return Util::Unexpected(Util::Error("no function " + to_string(func)));
+    }
+    const FuncInfo& info = funcs[func];
+    if (args.size() != info.numParams) {
+        return Util::Unexpected(Util::Error("'" + names[func] + "' takes " +
+                                            to_string(info.numParams) + " arguments"));
+    }
+    regs.assign(max<size_t>(info.numRegs, regs.size()), 0);
+    copy(args.begin(), args.end(), regs.begin());
+    frames.clear();
+    frames.push_back({nullptr, 0, info.numRegs, 0, func});
+    return execute(code.data() + info.entry, nullptr);
+}
+
+std::vector<uint8_t>& Interpreter::memory() noexcept {
+    return mem;
+}
+
+#ifdef THREADED_DISPATCH
+#pragma GCC diagnostic push
+// labels as values and computed goto are GNU extensions
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+Util::Expected<int64_t> Interpreter::execute(const Decoded* entry,
+                                             const void* const** table) {
+#ifdef THREADED_DISPATCH
+    // indexed by BcOp; MOVK is decoded into MOVI
+    static const void* const HANDLERS[] = {
+        &&L_MOV, &&L_MOVI, &&L_MOVI, &&L_ADD,  &&L_SUB,   &&L_MUL,   &&L_DIV,    &&L_REM,
+        &&L_AND, &&L_OR,   &&L_XOR,  &&L_SHL,  &&L_SHR,   &&L_SAR,   &&L_ADDI,   &&L_NEG,
+        &&L_NOT, &&L_EQ,   &&L_NE,   &&L_LT,   &&L_LE,    &&L_ULT,   &&L_ULE,    &&L_JMP,
+        &&L_JNZ, &&L_JZ,   &&L_LOAD, &&L_LOADB, &&L_STORE, &&L_STOREB, &&L_CALL, &&L_RET,
+    };
+    static_assert(sizeof(HANDLERS) / sizeof(*HANDLERS) ==
+                      static_cast<size_t>(BcOp::RET) + 1,
+                  "a handler for every operation");
+    if (!entry) {
+        *table = HANDLERS;
+        return 0;
+    }
+#define HANDLER(name) L_##name:
+#define DISPATCH() goto* ip->handler
+#else
+    if (!entry) {
+        *table = nullptr;
+        return 0;
+    }
+#define HANDLER(name) case BcOp::name:
+#define DISPATCH() goto dispatch
+#endif
+#define BINARY(name, expr)                                                               \
+    HANDLER(name) {                                                                      \
+        int64_t lhs = r[ip->b];                                                          \
+        int64_t rhs = r[ip->c];                                                          \
+        r[ip->a] = (expr);                                                               \
+        ++ip;                                                                            \
+        DISPATCH();                                                                      \
+    }
+#define TRAP(msg)                                                                        \
+    do {                                                                                 \
+        trap = (msg);                                                                    \
+        goto trapped;                                                                    \
+    } while (0)
+// tested before the decrement, so maxSteps steps are allowed and 0 allows none
+#define STEP()                                                                           \
+    if (steps == 0) {                                                                    \
+        TRAP("step limit exceeded");                                                     \
+    }                                                                                    \
+    --steps;
+
+    const Decoded* ip = entry;
+    int64_t* r = regs.data() + frames.back().base;
+    uint8_t* m = mem.data();
+    uint64_t memSize = mem.size();
+    uint64_t steps = limits.maxSteps;
+    const char* trap = nullptr;
+    uint64_t addr;
+
+#ifdef THREADED_DISPATCH
+    DISPATCH();
+#else
+dispatch:
+    switch (ip->op) {
+#endif
+    HANDLER(MOV) {
+        r[ip->a] = r[ip->b];
+        ++ip;
+        DISPATCH();
+    }
+    HANDLER(MOVI)
+#ifndef THREADED_DISPATCH
+    HANDLER(MOVK)
+#endif
+    {
+        r[ip->a] = ip->imm;
+        ++ip;
+        DISPATCH();
+    }
+    BINARY(ADD, wrap(static_cast<uint64_t>(lhs) + static_cast<uint64_t>(rhs)))
+    BINARY(SUB, wrap(static_cast<uint64_t>(lhs) - static_cast<uint64_t>(rhs)))
+    BINARY(MUL, wrap(static_cast<uint64_t>(lhs) * static_cast<uint64_t>(rhs)))
+    HANDLER(DIV) {
+        int64_t rhs = r[ip->c];
+        if (rhs == 0) {
+            TRAP("division by zero");
+        }
+        // INT64_MIN / -1 overflows; it wraps like the negation
+        r[ip->a] = rhs == -1 ? wrap(0 - static_cast<uint64_t>(r[ip->b])) : r[ip->b] / rhs;
+        ++ip;
+        DISPATCH();
+    }
+    HANDLER(REM) {
+        int64_t rhs = r[ip->c];
+        if (rhs == 0) {
+            TRAP("division by zero");
+        }
+        r[ip->a] = rhs == -1 ? 0 : r[ip->b] % rhs;
+        ++ip;
+        DISPATCH();
+    }
+    BINARY(AND, lhs & rhs)
+    BINARY(OR, lhs | rhs)
+    BINARY(XOR, lhs ^ rhs)
+    BINARY(SHL, wrap(static_cast<uint64_t>(lhs) << (rhs & 63)))
+    BINARY(SHR, wrap(static_cast<uint64_t>(lhs) >> (rhs & 63)))
+    BINARY(SAR, lhs >> (rhs & 63))
+    HANDLER(ADDI) {
+        r[ip->a] = wrap(static_cast<uint64_t>(r[ip->b]) + static_cast<uint64_t>(ip->imm));
+        ++ip;
+        DISPATCH();
+    }
+    HANDLER(NEG) {
+        r[ip->a] = wrap(0 - static_cast<uint64_t>(r[ip->b]));
+        ++ip;
+        DISPATCH();
+    }
+    HANDLER(NOT) {
+        r[ip->a] = ~r[ip->b];
+        ++ip;
+        DISPATCH();
+    }
+    BINARY(EQ, lhs == rhs)
+    BINARY(NE, lhs != rhs)
+    BINARY(LT, lhs < rhs)
+    BINARY(LE, lhs <= rhs)
+    BINARY(ULT, static_cast<uint64_t>(lhs) < static_cast<uint64_t>(rhs))
+    BINARY(ULE, static_cast<uint64_t>(lhs) <= static_cast<uint64_t>(rhs))
+    HANDLER(JMP) {
+        STEP();
+        ip = ip->target;
+        DISPATCH();
+    }
+    HANDLER(JNZ) {
+        if (r[ip->a] != 0) {
+            STEP();
+            ip = ip->target;
+        } else {
+            ++ip;
+        }
+        DISPATCH();
+    }
+    HANDLER(JZ) {
+        if (r[ip->a] == 0) {
+            STEP();
+            ip = ip->target;
+        } else {
+            ++ip;
+        }
+        DISPATCH();
+    }
+    HANDLER(LOAD) {
+        addr = static_cast<uint64_t>(r[ip->b]) + static_cast<uint64_t>(ip->imm);
+        if (addr > memSize || memSize - addr < sizeof(int64_t)) {
+            TRAP("load out of bounds");
+        }
+        memcpy(&r[ip->a], m + addr, sizeof(int64_t));
+        ++ip;
+        DISPATCH();
+    }
+    HANDLER(LOADB) {
+        addr = static_cast<uint64_t>(r[ip->b]) + static_cast<uint64_t>(ip->imm);
+        if (addr >= memSize) {
+            TRAP("load out of bounds");
+        }
+        r[ip->a] = m[addr];
+        ++ip;
+        DISPATCH();
+    }
+    HANDLER(STORE) {
+        addr = static_cast<uint64_t>(r[ip->b]) + static_cast<uint64_t>(ip->imm);
+        if (addr > memSize || memSize - addr < sizeof(int64_t)) {
+            TRAP("store out of bounds");
+        }
+        memcpy(m + addr, &r[ip->a], sizeof(int64_t));
+        ++ip;
+        DISPATCH();
+    }
+    HANDLER(STOREB) {
+        addr = static_cast<uint64_t>(r[ip->b]) + static_cast<uint64_t>(ip->imm);
+        if (addr >= memSize) {
+            TRAP("store out of bounds");
+        }
+        m[addr] = static_cast<uint8_t>(r[ip->a]);
+        ++ip;
+        DISPATCH();
+    }
+    HANDLER(CALL) {
+        STEP();
+        if (frames.size() >= limits.maxDepth) {
+            TRAP("call stack overflow");
+        }
+        const FuncInfo& callee = funcs[ip->imm];
+        size_t base = frames.back().top;
+        size_t top = base + callee.numRegs;
+        if (regs.size() < top) {
+            // the register stack moves, so r is recomputed below
+            regs.resize(max(top, 2 * regs.size()));
+            r = regs.data() + frames.back().base;
+        }
+        int64_t* args = regs.data() + base;
+        copy(r + ip->b, r + ip->b + ip->c, args);
+        fill(args + ip->c, args + callee.numRegs, 0);
+        frames.push_back({ip + 1, base, top, ip->a,
+                          static_cast<uint32_t>(&callee - funcs.data())});
+        r = args;
+        ip = code.data() + callee.entry;
+        DISPATCH();
+    }
+    HANDLER(RET) {
+        int64_t val = r[ip->a];
+        Frame done = frames.back();
+        frames.pop_back();
+        if (frames.empty()) {
+            return val;
+        }
+        r = regs.data() + frames.back().base;
+        r[done.dst] = val;
+        ip = done.ret;
+        DISPATCH();
+    }
+#ifndef THREADED_DISPATCH
+    }
+#endif
+
+trapped:
+    string where = names[frames.back().func];
+    frames.clear();
+    return Util::Unexpected(Util::Error(string(trap) + " in '" + where + "'"));
+
+#undef HANDLER
+#undef DISPATCH
+#undef BINARY
+#undef TRAP
+#undef STEP
+}
+
+#ifdef THREADED_DISPATCH
+#pragma GCC diagnostic pop
+#endif
+
+} // namespace IR
@@ -0,0 +1,253 @@
+/**
+ * Register machine bytecode and its interpreter, for evaluating IR without generating
+ * machine code: constant folding of calls at compile time, and differential testing of
+ * optimization passes, which compares what a function computes before and after a pass.
+ *
+ * Bytecode is built per function with a BcBuilder, much like machine code with an
+ * X86Encoder. An Interpreter pre-decodes the whole program once: every instruction gets
+ * the address of its handler, jump targets become instruction pointers and 64-bit
+ * constants are inlined, so the dispatch loop is a single indirect jump per instruction
+ * (computed goto where the compiler supports it, a switch otherwise).
+ *
+ * All values are 64-bit integers. Memory is one flat, bounds checked byte array owned by
+ * the interpreter; addresses are offsets into it.
+ */
+#ifndef INTERPRETER_H
+#define INTERPRETER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "fds/arrayref.h"
+#include "util/expected.h"
+
+namespace IR {
+
+/**
+ * Bytecode operations. a, b and c are registers of the current frame, imm the immediate.
+ */
+enum class BcOp : uint8_t
+{
+    // a = b
+    MOV,
+    // a = imm
+    MOVI,
+    // a = constant imm of the function
+    MOVK,
+    // a = b op c. Division and remainder are signed and trap on a zero divisor.
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    REM,
+    AND,
+    OR,
+    XOR,
+    SHL,
+    SHR,
+    SAR,
+    // a = b + imm
+    ADDI,
+    // a = op b
+    NEG,
+    NOT,
+    // a = b cmp c ? 1 : 0; LT and LE are signed, ULT and ULE unsigned
+    EQ,
+    NE,
+    LT,
+    LE,
+    ULT,
+    ULE,
+    // goto imm
+    JMP,
+    // if a != 0 goto imm
+    JNZ,
+    // if a == 0 goto imm
+    JZ,
+    // a = 64-bit or zero extended 8-bit load from address b + imm
+    LOAD,
+    LOADB,
+    // store a to address b + imm
+    STORE,
+    STOREB,
+    // a = function imm called with the c registers starting at b
+    CALL,
+    // return a
+    RET,
+};
+
+struct BcInsn {
+    BcOp op;
+    uint16_t a;
+    uint16_t b;
+    uint16_t c;
+    int32_t imm;
+};
+
+struct BcFunction {
+    std::string name;
+    std::vector<BcInsn> code;
+    std::vector<int64_t> consts;
+    uint16_t numParams;
+    uint16_t numRegs;
+};
+
+/**
+ * Builds the bytecode of one function. The parameters arrive in registers
+ * 0 .. numParams - 1; further registers are handed out by newReg.
+ */
+class BcBuilder {
+public:
+    using Reg = uint16_t;
+    using Label = uint32_t;
+
+private:
+    static constexpr uint32_t UNBOUND = ~static_cast<uint32_t>(0);
+
+    BcFunction out;
+    std::vector<uint32_t> labels;
+    // jumps whose imm is still a label
+    std::vector<uint32_t> fixups;
+
+    void emit(BcOp op, Reg a, Reg b, Reg c, int32_t imm);
+
+public:
+    BcBuilder(std::string name, uint16_t numParams);
+
+    Reg newReg();
+    Reg param(uint16_t idx) const;
+
+    Label newLabel();
+    /**
+     * Place label at the next instruction.
+     */
+    void bind(Label label);
+
+    void mov(Reg dst, Reg src);
+    /**
+     * Load a constant, inline if it fits 32 bits and from the constant pool otherwise.
+     */
+    void movImm(Reg dst, int64_t val);
+    /**
+     * dst = lhs op rhs, for the three register operations from ADD to ULE.
+     */
+    void binary(BcOp op, Reg dst, Reg lhs, Reg rhs);
+    void addImm(Reg dst, Reg src, int32_t imm);
+    void unary(BcOp op, Reg dst, Reg src);
+    void jmp(Label target);
+    void jnz(Reg cond, Label target);
+    void jz(Reg cond, Label target);
+    void load(Reg dst, Reg addr, int32_t offset = 0);
+    void loadByte(Reg dst, Reg addr, int32_t offset = 0);
+    void store(Reg src, Reg addr, int32_t offset = 0);
+    void storeByte(Reg src, Reg addr, int32_t offset = 0);
+    /**
+     * dst = func(args...), where the arguments are numArgs consecutive registers
+     * starting at firstArg. func is the index of the callee in the program.
+     */
+    void call(Reg dst, uint32_t func, Reg firstArg, uint16_t numArgs);
+    void ret(Reg val);
+
+    /**
+     * Resolve jumps and hand out the function. All labels jumped to must have been bound.
+     */
+    BcFunction finish();
+};
+
+struct InterpreterLimits {
+    // taken jumps and calls allowed per call of run, so that evaluating a non-terminating
+    // constant expression fails instead of hanging. Straight-line code is not counted:
+    // without a jump it cannot run longer than the program is.
+    uint64_t maxSteps = UINT64_MAX;
+    uint32_t maxDepth = 4096;
+};
+
+/**
+ * Executes a program of bytecode functions, which call each other by index.
+ *
+ * The decoded program is read-only while running, but the register stack and memory
+ * belong to the interpreter, so run one interpreter per thread.
+ */
+class Interpreter {
+private:
+    // one pre-decoded instruction
+    struct Decoded {
+        // handler label (computed goto) or operation (switch)
+        const void* handler;
+        BcOp op;
+        uint16_t a;
+        uint16_t b;
+        uint16_t c;
+        union {
+            int64_t imm;
+            const Decoded* target;
+        };
+    };
+
+    struct Frame {
+        // instruction to return to
+        const Decoded* ret;
+        // the registers of the frame are regs[base .. top)
+        std::size_t base;
+        std::size_t top;
+        // caller register receiving the result
+        uint16_t dst;
+        uint32_t func;
+    };
+
+    struct FuncInfo {
+        std::size_t entry;
+        uint16_t numParams;
+        uint16_t numRegs;
+    };
+
+    std::vector<Decoded> code;
+    std::vector<FuncInfo> funcs;
+    std::vector<std::string> names;
+    std::vector<int64_t> regs;
+    std::vector<Frame> frames;
+    std::vector<uint8_t> mem;
+    InterpreterLimits limits;
+
+    /**
+     * The interpreter loop. With a null entry it only returns its handler table through
+     * table, for decoding.
+     */
+    Util::Expected<int64_t> execute(const Decoded* entry, const void* const** table);
+
+    Interpreter() = default;
+
+public:
+    // decoded jumps point into the code, which a move keeps in place
+    Interpreter(const Interpreter&) = delete;
+    Interpreter& operator=(const Interpreter&) = delete;
+    Interpreter(Interpreter&&) noexcept = default;
+    Interpreter& operator=(Interpreter&&) noexcept = default;
+
+    /**
+     * Decode a program.
+     *
+     * @param memorySize bytes of memory available to the program.
+     * @return the interpreter, or an error if a function is malformed: a register, jump
+     * target, constant or callee out of range.
+     */
+    static Util::Expected<Interpreter> create(ArrayRef<BcFunction> program,
+                                              std::size_t memorySize = 0,
+                                              InterpreterLimits limits = {});
+
+    /**
+     * Call function func.
+     *
+     * @return the value it returns, or an error if it traps: division by zero, memory
+     * access out of bounds, too deep recursion or too many steps.
+     */
+    Util::Expected<int64_t> run(uint32_t func, ArrayRef<int64_t> args);
+
+    std::vector<uint8_t>& memory() noexcept;
+};
+
+} // namespace IR
+
+#endif // INTERPRETER_H
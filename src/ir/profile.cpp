@@ -0,0 +1,386 @@
+#include "profile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <numeric>
+#include <ostream>
+
+#include "util/hash.h"
+
+using namespace std;
+
+namespace IR {
+
+static const char PROFILE_MAGIC[] = "ECCPROF";
+
+//////////////////////////////////////////////
+// Counter placement
+//////////////////////////////////////////////
+namespace {
+
+/**
+ * The control graph extended with one virtual edge per exit back to the entry. Edge ids
+ * match the ones used by CounterPlan.
+ */
+struct FlowGraph {
+    vector<ControlGraph::BlockId> src;
+    vector<ControlGraph::BlockId> dst;
+
+    FlowGraph(const ControlGraph& cfg, const vector<ControlGraph::BlockId>& exits) {
+        const auto& g = cfg.getGraph();
+        size_t total = g.numEdges() + exits.size();
+        src.reserve(total);
+        dst.reserve(total);
+        for (size_t e = 0; e < g.numEdges(); ++e) {
+            src.push_back(g.edge(e).src);
+            dst.push_back(g.edge(e).dst);
+        }
+        for (ControlGraph::BlockId exit : exits) {
+            src.push_back(exit);
+            dst.push_back(cfg.getEntry());
+        }
+    }
+
+    size_t size() const { return src.size(); }
+};
+
+size_t findRoot(vector<size_t>& parent, size_t x) {
+    while (parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+} // namespace
+
+CounterPlan planEdgeCounters(const ControlGraph& cfg) {
+    const auto& g = cfg.getGraph();
+    CounterPlan plan;
+    plan.exits = cfg.exits();
+    plan.numEdges = g.numEdges();
+    FlowGraph flow(cfg, plan.exits);
+
+    // Kruskal, heaviest edge first. Virtual edges can't carry an in-line counter so they
+    // go onto the tree before anything else.
+    vector<double> weight(flow.size());
+    for (size_t e = 0; e < flow.size(); ++e) {
+        weight[e] = e < plan.numEdges ? cfg.edgeProb(e) : 2.0;
+    }
+    vector<size_t> order(flow.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(),
+                [&](size_t a, size_t b) { return weight[a] > weight[b]; });
+
+    vector<size_t> parent(g.numNodes());
+    iota(parent.begin(), parent.end(), 0);
+    vector<bool> onTree(flow.size(), false);
+    for (size_t e : order) {
+        size_t a = findRoot(parent, flow.src[e]);
+        size_t b = findRoot(parent, flow.dst[e]);
+        if (a != b) {
+            parent[a] = b;
+            onTree[e] = true;
+        }
+    }
+    for (size_t e = 0; e < flow.size(); ++e) {
+        if (!onTree[e]) {
+            plan.counted.push_back(e);
+        }
+    }
+    return plan;
+}
+
+bool applyEdgeCounters(ControlGraph& cfg, const CounterPlan& plan,
+                       ArrayRef<uint64_t> counters, string& error) {
+    auto& g = cfg.getGraph();
+    if (plan.numEdges != g.numEdges() || counters.size() != plan.counted.size()) {
+        error = "Counter plan does not match control graph.";
+        return false;
+    }
+    FlowGraph flow(cfg, plan.exits);
+    size_t numBlocks = g.numNodes();
+
+    vector<vector<size_t>> inEdges(numBlocks);
+    vector<vector<size_t>> outEdges(numBlocks);
+    for (size_t e = 0; e < flow.size(); ++e) {
+        outEdges[flow.src[e]].push_back(e);
+        inEdges[flow.dst[e]].push_back(e);
+    }
+
+    vector<uint64_t> count(flow.size(), 0);
+    vector<bool> known(flow.size(), false);
+    for (size_t i = 0; i < counters.size(); ++i) {
+        count[plan.counted[i]] = counters[i];
+        known[plan.counted[i]] = true;
+    }
+
+    // Peel leaves off the spanning tree: any block with exactly one unknown incident
+    // edge can solve for it with inflow == outflow.
+    vector<size_t> unknown(numBlocks, 0);
+    for (size_t e = 0; e < flow.size(); ++e) {
+        if (!known[e]) {
+            ++unknown[flow.src[e]];
+            ++unknown[flow.dst[e]];
+        }
+    }
+    vector<ControlGraph::BlockId> worklist;
+    for (ControlGraph::BlockId b = 0; b < numBlocks; ++b) {
+        if (unknown[b] == 1) {
+            worklist.push_back(b);
+        }
+    }
+    size_t solved = 0;
+    size_t toSolve = flow.size() - counters.size();
+    while (!worklist.empty()) {
+        ControlGraph::BlockId b = worklist.back();
+        worklist.pop_back();
+        if (unknown[b] != 1) {
+            continue;
+        }
+        uint64_t in = 0;
+        uint64_t out = 0;
+        size_t missing = flow.size();
+        bool missingIsIn = false;
+        for (size_t e : inEdges[b]) {
+            if (known[e]) {
+                in += count[e];
+            } else {
+                missing = e;
+                missingIsIn = true;
+            }
+        }
+        for (size_t e : outEdges[b]) {
+            if (known[e]) {
+                out += count[e];
+            } else {
+                missing = e;
+                missingIsIn = false;
+            }
+        }
+        if ((missingIsIn && out < in) || (!missingIsIn && in < out)) {
+            error = "Inconsistent edge counts for block '" + g.node(b).label + "'.";
+            return false;
+        }
+        count[missing] = missingIsIn ? out - in : in - out;
+        known[missing] = true;
+        ++solved;
+        for (ControlGraph::BlockId end : {flow.src[missing], flow.dst[missing]}) {
+            if (--unknown[end] == 1) {
+                worklist.push_back(end);
+            }
+        }
+    }
+    if (solved != toSolve) {
+        error = "Edge counters do not determine all control graph edges.";
+        return false;
+    }
+
+    for (ControlGraph::BlockId b = 0; b < numBlocks; ++b) {
+        uint64_t total = 0;
+        for (size_t e : inEdges[b]) {
+            total += count[e];
+        }
+        g.node(b).count = total;
+    }
+    for (size_t e = 0; e < plan.numEdges; ++e) {
+        g.edge(e).data.count = count[e];
+    }
+    cfg.setHasProfile(true);
+    return true;
+}
+
+uint64_t cfgChecksum(const ControlGraph& cfg) {
+    // hash the shape of the graph, serialized little-endian so the checksum is the same
+    // on every host
+    const auto& g = cfg.getGraph();
+    vector<uint8_t> shape;
+    shape.reserve((3 + 2 * g.numEdges()) * sizeof(uint64_t));
+    auto put = [&shape](uint64_t val) {
+        for (int i = 0; i < 8; ++i) {
+            shape.push_back(static_cast<uint8_t>(val >> (i * 8)));
+        }
+    };
+    put(g.numNodes());
+    put(g.numEdges());
+    put(cfg.getEntry());
+    for (size_t e = 0; e < g.numEdges(); ++e) {
+        put(g.edge(e).src);
+        put(g.edge(e).dst);
+    }
+    return Util::hash64(shape.data(), shape.size());
+}
+
+//////////////////////////////////////////////
+// ProfileData implementation
+//////////////////////////////////////////////
+static void writeVarint(ostream& out, uint64_t val) {
+    while (val >= 0x80) {
+        out.put(static_cast<char>((val & 0x7f) | 0x80));
+        val >>= 7;
+    }
+    out.put(static_cast<char>(val));
+}
+
+static bool readVarint(istream& in, uint64_t& val) {
+    val = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        int byte = in.get();
+        if (byte == char_traits<char>::eof()) {
+            return false;
+        }
+        val |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Bytes left in the stream, or UINT64_MAX if it can't seek. Lengths read from the file
+// are checked against it before anything is allocated for them.
+static uint64_t bytesLeft(istream& in) {
+    streampos pos = in.tellg();
+    if (pos == streampos(-1)) {
+        return UINT64_MAX;
+    }
+    in.seekg(0, ios::end);
+    streampos end = in.tellg();
+    in.clear();
+    in.seekg(pos);
+    return end == streampos(-1) || end < pos ? UINT64_MAX
+                                              : static_cast<uint64_t>(end - pos);
+}
+
+// Whether two profiles of the same function can be summed.
+static bool compatible(const FunctionProfile& a, const FunctionProfile& b) {
+    return a.checksum == b.checksum && a.counters.size() == b.counters.size();
+}
+
+bool ProfileData::merge(FunctionProfile func) {
+    auto it = funcs.find(func.name);
+    if (it == funcs.end()) {
+        string name = func.name;
+        funcs.emplace(move(name), move(func));
+        return true;
+    }
+    FunctionProfile& existing = it->second;
+    if (!compatible(existing, func)) {
+        return false;
+    }
+    for (size_t i = 0; i < func.counters.size(); ++i) {
+        existing.counters[i] += func.counters[i];
+    }
+    return true;
+}
+
+const FunctionProfile* ProfileData::find(const std::string& name) const {
+    auto it = funcs.find(name);
+    return it == funcs.end() ? nullptr : &it->second;
+}
+
+bool ProfileData::write(std::ostream& out) const {
+    out.write(PROFILE_MAGIC, sizeof(PROFILE_MAGIC) - 1);
+    out.put(static_cast<char>(VERSION));
+    writeVarint(out, funcs.size());
+    // in name order, so the same profile always gives the same bytes
+    vector<const FunctionProfile*> sorted;
+    sorted.reserve(funcs.size());
+    for (const auto& entry : funcs) {
+        sorted.push_back(&entry.second);
+    }
+    auto byName = [](const FunctionProfile* a, const FunctionProfile* b) {
+        return a->name < b->name;
+    };
+    sort(sorted.begin(), sorted.end(), byName);
+    for (const FunctionProfile* entry : sorted) {
+        const FunctionProfile& func = *entry;
+        writeVarint(out, func.name.size());
+        out.write(func.name.data(), static_cast<streamsize>(func.name.size()));
+        writeVarint(out, func.checksum);
+        writeVarint(out, func.counters.size());
+        for (uint64_t counter : func.counters) {
+            writeVarint(out, counter);
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+bool ProfileData::read(std::istream& in, std::string& error) {
+    // parsed on the side and merged only once the whole file is good, so that a truncated
+    // or conflicting file leaves this profile as it was
+    ProfileData parsed;
+    char magic[sizeof(PROFILE_MAGIC) - 1];
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, PROFILE_MAGIC, sizeof(magic))) {
+        error = "Not a profile file.";
+        return false;
+    }
+    if (in.get() != VERSION) {
+        error = "Unsupported profile version.";
+        return false;
+    }
+    uint64_t numFuncs;
+    if (!readVarint(in, numFuncs)) {
+        error = "Truncated profile file.";
+        return false;
+    }
+    for (uint64_t i = 0; i < numFuncs; ++i) {
+        FunctionProfile func;
+        uint64_t len;
+        uint64_t numCounters;
+        if (!readVarint(in, len)) {
+            error = "Truncated profile file.";
+            return false;
+        }
+        // an unseekable stream is read in pieces, so a corrupt length can't make us
+        // allocate more than the data that actually arrives
+        if (len > bytesLeft(in)) {
+            error = "Truncated profile file.";
+            return false;
+        }
+        while (func.name.size() < len) {
+            char buf[4096];
+            size_t piece =
+                static_cast<size_t>(min<uint64_t>(sizeof(buf), len - func.name.size()));
+            if (!in.read(buf, static_cast<streamsize>(piece))) {
+                error = "Truncated profile file.";
+                return false;
+            }
+            func.name.append(buf, piece);
+        }
+        // every counter takes at least one byte
+        if (!readVarint(in, func.checksum) || !readVarint(in, numCounters) ||
+            numCounters > bytesLeft(in)) {
+            error = "Truncated profile file.";
+            return false;
+        }
+        func.counters.reserve(static_cast<size_t>(min<uint64_t>(numCounters, 4096)));
+        for (uint64_t c = 0; c < numCounters; ++c) {
+            uint64_t val;
+            if (!readVarint(in, val)) {
+                error = "Truncated profile file.";
+                return false;
+            }
+            func.counters.push_back(val);
+        }
+        string name = func.name;
+        if (!parsed.merge(move(func))) {
+            error = "Conflicting profile entries for function '" + name + "'.";
+            return false;
+        }
+    }
+    for (const auto& entry : parsed.funcs) {
+        const FunctionProfile* existing = find(entry.first);
+        if (existing && !compatible(*existing, entry.second)) {
+            error = "Conflicting profile entries for function '" + entry.first + "'.";
+            return false;
+        }
+    }
+    for (auto& entry : parsed.funcs) {
+        merge(move(entry.second));
+    }
+    return true;
+}
+
+} // namespace IR
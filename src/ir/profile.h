@@ -0,0 +1,110 @@
+/**
+ * Edge profiling support for profile guided optimization.
+ *
+ * Instrumented builds only count a minimal set of edges: the edges not on a maximum
+ * spanning tree of the control graph (extended with a virtual edge from every exit back
+ * to the entry). The remaining counts are recovered from flow conservation when the
+ * profile is consumed.
+ */
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "fds/arrayref.h"
+#include "ir/control_graph.h"
+
+namespace IR {
+
+/**
+ * Placement of the counters for one function.
+ */
+struct CounterPlan {
+    // Edges that get a counter, in counter index order. An id below numEdges is a real
+    // control graph edge, while id numEdges + i is the virtual edge leaving exits[i] and
+    // is counted when the function returns from that block.
+    std::vector<std::size_t> counted;
+    std::vector<ControlGraph::BlockId> exits;
+    std::size_t numEdges;
+
+    bool isExitCounter(std::size_t counter) const;
+};
+
+inline bool CounterPlan::isExitCounter(std::size_t counter) const {
+    return counted[counter] >= numEdges;
+}
+
+/**
+ * Choose which edges of a function to instrument. Edges with a high static probability
+ * are kept on the spanning tree so that hot paths carry as few counters as possible.
+ */
+CounterPlan planEdgeCounters(const ControlGraph& cfg);
+
+/**
+ * Annotate every block and edge of a function with execution counts recovered from the
+ * counters described by plan. Marks the graph as profiled on success.
+ *
+ * @param cfg control graph the plan was made for.
+ * @param plan counter placement returned by planEdgeCounters.
+ * @param counters counter values, one per entry in plan.counted.
+ * @param error set to a description of the problem on failure.
+ * @return true if the counts were applied.
+ */
+bool applyEdgeCounters(ControlGraph& cfg, const CounterPlan& plan,
+                       ArrayRef<uint64_t> counters, std::string& error);
+
+/**
+ * Structural hash of a control graph, used to reject profiles recorded for a different
+ * version of a function.
+ */
+uint64_t cfgChecksum(const ControlGraph& cfg);
+
+/**
+ * Raw counters recorded for one function.
+ */
+struct FunctionProfile {
+    std::string name;
+    uint64_t checksum;
+    std::vector<uint64_t> counters;
+};
+
+/**
+ * A whole program profile, as written by an instrumented binary at exit.
+ *
+ * The on-disk format is the magic "ECCPROF", a version byte and a function count,
+ * followed by each function's name, checksum and counters. All integers are LEB128
+ * varints, so small counts take a single byte.
+ */
+class ProfileData {
+private:
+    std::unordered_map<std::string, FunctionProfile> funcs;
+
+public:
+    // bumped whenever cfgChecksum or the encoding changes
+    static constexpr unsigned char VERSION = 2;
+
+    /**
+     * Add a function's counters, summing them into an existing entry for the same
+     * function (e.g. when merging several training runs).
+     *
+     * @return false if an entry exists with a different checksum or counter count.
+     */
+    bool merge(FunctionProfile func);
+    const FunctionProfile* find(const std::string& name) const;
+    std::size_t size() const noexcept;
+
+    bool write(std::ostream& out) const;
+    bool read(std::istream& in, std::string& error);
+};
+
+inline std::size_t ProfileData::size() const noexcept {
+    return funcs.size();
+}
+
+} // namespace IR
+
+#endif // PROFILE_H
@@ -0,0 +1,97 @@
+#include "error.h"
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+namespace Util {
+
+static const char* severityName(Severity severity) {
+    switch (severity) {
+        case Severity::NOTE:
+            return "note";
+        case Severity::WARNING:
+            return "warning";
+        case Severity::ERROR:
+            return "error";
+        case Severity::FATAL:
+            return "fatal error";
+    }
+    return "error";
+}
+
+DiagEngine::DiagEngine(std::size_t errorLimit)
+    : numErrors{0}, errorLimit{errorLimit}, werror{false} {
+}
+
+void DiagEngine::setWarningsAsErrors(bool val) noexcept {
+    werror = val;
+}
+
+void DiagEngine::report(Severity severity, SourceLoc loc, std::string message) {
+    if (severity == Severity::WARNING && werror) {
+        severity = Severity::ERROR;
+    }
+    bool isError = severity == Severity::ERROR || severity == Severity::FATAL;
+    if (isError) {
+        // past the limit only fatal errors get through, so the reason for stopping is
+        // still shown
+        if (tooManyErrors() && severity != Severity::FATAL) {
+            return;
+        }
+        ++numErrors;
+    } else if (tooManyErrors()) {
+        return;
+    }
+    diags.push_back({severity, loc, move(message)});
+}
+
+void DiagEngine::report(const Error& err, Severity severity) {
+    report(severity, err.loc(), err.message());
+}
+
+void DiagEngine::error(SourceLoc loc, std::string message) {
+    report(Severity::ERROR, loc, move(message));
+}
+
+void DiagEngine::warning(SourceLoc loc, std::string message) {
+    report(Severity::WARNING, loc, move(message));
+}
+
+void DiagEngine::note(SourceLoc loc, std::string message) {
+    report(Severity::NOTE, loc, move(message));
+}
+
+void DiagEngine::print(std::ostream& out) const {
+    for (const Diagnostic& diag : diags) {
+        if (!diag.loc.file.empty()) {
+            out << diag.loc.file << ':';
+            if (diag.loc.line) {
+                out << diag.loc.line << ':';
+                if (diag.loc.col) {
+                    out << diag.loc.col << ':';
+                }
+            }
+            out << ' ';
+        } else {
+            out << "ecc: ";
+        }
+        out << severityName(diag.severity) << ": " << diag.message << '\n';
+    }
+    if (tooManyErrors()) {
+        out << "ecc: fatal error: too many errors emitted, stopping now\n";
+    }
+}
+
+void fatalAbort(const char* message) {
+    cerr << "ecc: fatal error: " << message << endl;
+    abort();
+}
+
+void DiagEngine::clear() noexcept {
+    diags.clear();
+    numErrors = 0;
+}
+
+} // namespace Util
@@ -1 +1,162 @@
- 
+/**
+ * Error values and the diagnostics engine.
+ *
+ * Code on hot paths reports failures by returning an Error (usually inside an
+ * Expected<T>, see util/expected.h) rather than by throwing, so that the compiler can be
+ * built with -fno-exceptions. Errors that are meant for the user end up in a DiagEngine,
+ * which collects them with their source locations and prints them in the usual
+ * "file:line:col: error: message" form.
+ */
+#ifndef ERROR_H
+#define ERROR_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Util {
+
+/**
+ * A position in a source file. The file name is not owned, and must outlive every
+ * location that refers to it: for a file loaded through IncludeCache, hold its
+ * SourceFile for as long as the location or any Error or Diagnostic carrying it, as
+ * IncludeCache::revalidate() drops the cache's own reference to a stale file.
+ * A zero line or column means unknown.
+ */
+struct SourceLoc {
+    std::string_view file;
+    uint32_t line = 0;
+    uint32_t col = 0;
+};
+
+enum class Severity
+{
+    NOTE,
+    WARNING,
+    ERROR,
+    FATAL
+};
+
+/**
+ * A failure returned from a function. Cheap to move, and only allocates when a message
+ * is actually built.
+ */
+class Error {
+private:
+    std::string msg;
+    SourceLoc location;
+
+public:
+    explicit Error(std::string message, SourceLoc loc = {});
+
+    const std::string& message() const noexcept;
+    SourceLoc loc() const noexcept;
+};
+
+struct Diagnostic {
+    Severity severity;
+    SourceLoc loc;
+    std::string message;
+};
+
+/**
+ * Collects the diagnostics of a compilation in the order they were reported.
+ */
+class DiagEngine {
+private:
+    std::vector<Diagnostic> diags;
+    std::size_t numErrors;
+    std::size_t errorLimit;
+    bool werror;
+
+public:
+    /**
+     * @param errorLimit number of errors after which further errors are dropped and
+     * tooManyErrors() turns true (0 means no limit).
+     */
+    explicit DiagEngine(std::size_t errorLimit = 0);
+
+    /**
+     * Treat warnings as errors (-Werror).
+     */
+    void setWarningsAsErrors(bool val) noexcept;
+
+    void report(Severity severity, SourceLoc loc, std::string message);
+    void report(const Error& err, Severity severity = Severity::ERROR);
+    void error(SourceLoc loc, std::string message);
+    void warning(SourceLoc loc, std::string message);
+    void note(SourceLoc loc, std::string message);
+
+    /**
+     * @return true if any error (or fatal error) was reported.
+     */
+    bool hasErrors() const noexcept;
+    std::size_t errorCount() const noexcept;
+    /**
+     * @return true once the error limit is hit; the caller should stop compiling.
+     */
+    bool tooManyErrors() const noexcept;
+    const std::vector<Diagnostic>& diagnostics() const noexcept;
+
+    /**
+     * Print all diagnostics, one per line, in the order they were reported.
+     */
+    void print(std::ostream& out) const;
+    void clear() noexcept;
+};
+
+/**
+ * Throw ex, or print it and abort when built without exceptions. For failures that
+ * callers are not expected to handle, such as violated preconditions.
+ */
+template <typename Ex> [[noreturn]] void throwOrAbort(const Ex& ex);
+/**
+ * Print a fatal error message to stderr and abort.
+ */
+[[noreturn]] void fatalAbort(const char* message);
+
+////////////////////////////////////
+// template and inline implementations
+////////////////////////////////////
+template <typename Ex> [[noreturn]] void throwOrAbort(const Ex& ex) {
+#ifdef __cpp_exceptions
+    throw ex;
+#else
+    fatalAbort(ex.what());
+#endif
+}
+
+inline Error::Error(std::string message, SourceLoc loc)
+    : msg{std::move(message)}, location{loc} {
+}
+
+inline const std::string& Error::message() const noexcept {
+    return msg;
+}
+
+inline SourceLoc Error::loc() const noexcept {
+    return location;
+}
+
+inline bool DiagEngine::hasErrors() const noexcept {
+    return numErrors > 0;
+}
+
+inline std::size_t DiagEngine::errorCount() const noexcept {
+    return numErrors;
+}
+
+inline bool DiagEngine::tooManyErrors() const noexcept {
+    return errorLimit && numErrors >= errorLimit;
+}
+
+inline const std::vector<Diagnostic>& DiagEngine::diagnostics() const noexcept {
+    return diags;
+}
+
+} // namespace Util
+
+#endif // ERROR_H
@@ -1 +1,237 @@
- 
+/**
+ * Expected<T, E>: either a value or the error that prevented computing it.
+ *
+ * This is how fallible functions on hot paths report failure without exceptions. The
+ * error is returned by wrapping it in Unexpected:
+ *
+ *     Util::Expected<long> parseInt(const std::string& str) {
+ *         ...
+ *         if (bad) {
+ *             return Util::Unexpected(Util::Error("not a number"));
+ *         }
+ *         return val;
+ *     }
+ *
+ * Accessing the value of an Expected that holds an error (or vice versa) is a bug and is
+ * caught by ENSURE in debug builds.
+ */
+#ifndef EXPECTED_H
+#define EXPECTED_H
+
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include "debug_macros.h"
+#include "util/error.h"
+
+namespace Util {
+
+/**
+ * Wrapper marking a value as an error when constructing an Expected.
+ */
+template <typename E> class Unexpected {
+private:
+    E err;
+
+public:
+    explicit Unexpected(E error);
+
+    E& error() & noexcept;
+    const E& error() const& noexcept;
+    E&& error() && noexcept;
+};
+
+template <typename E> Unexpected(E) -> Unexpected<E>;
+
+/**
+ * @tparam T value type.
+ * @tparam E error type.
+ */
+template <typename T, typename E = Error> class Expected {
+private:
+    std::variant<T, E> storage;
+
+public:
+    Expected(const T& value);
+    Expected(T&& value);
+    template <typename G> Expected(Unexpected<G> error);
+
+    bool hasValue() const noexcept;
+    explicit operator bool() const noexcept;
+
+    T& value() &;
+    const T& value() const&;
+    T&& value() &&;
+    T& operator*() &;
+    const T& operator*() const&;
+    T&& operator*() &&;
+    T* operator->();
+    const T* operator->() const;
+    /**
+     * @return the value, or fallback if this holds an error.
+     */
+    template <typename U> T valueOr(U&& fallback) const&;
+
+    E& error() &;
+    const E& error() const&;
+    E&& error() &&;
+};
+
+/**
+ * Result of a fallible operation that produces no value.
+ */
+template <typename E> class Expected<void, E> {
+private:
+    std::optional<E> err;
+
+public:
+    Expected() noexcept;
+    template <typename G> Expected(Unexpected<G> error);
+
+    bool hasValue() const noexcept;
+    explicit operator bool() const noexcept;
+
+    E& error() &;
+    const E& error() const&;
+    E&& error() &&;
+};
+
+////////////////////////////////////
+// template function implementations
+////////////////////////////////////
+template <typename E> inline Unexpected<E>::Unexpected(E error) : err{std::move(error)} {
+}
+
+template <typename E> inline E& Unexpected<E>::error() & noexcept {
+    return err;
+}
+
+template <typename E> inline const E& Unexpected<E>::error() const& noexcept {
+    return err;
+}
+
+template <typename E> inline E&& Unexpected<E>::error() && noexcept {
+    return std::move(err);
+}
+
+template <typename T, typename E>
+inline Expected<T, E>::Expected(const T& value)
+    : storage{std::in_place_index<0>, value} {
+}
+
+template <typename T, typename E>
+inline Expected<T, E>::Expected(T&& value)
+    : storage{std::in_place_index<0>, std::move(value)} {
+}
+
+template <typename T, typename E>
+template <typename G>
+inline Expected<T, E>::Expected(Unexpected<G> error)
+    : storage{std::in_place_index<1>, std::move(error).error()} {
+}
+
+template <typename T, typename E>
+inline bool Expected<T, E>::hasValue() const noexcept {
+    return storage.index() == 0;
+}
+
+template <typename T, typename E>
+inline Expected<T, E>::operator bool() const noexcept {
+    return hasValue();
+}
+
+template <typename T, typename E> inline T& Expected<T, E>::value() & {
+    ENSURE(hasValue());
+    return *std::get_if<0>(&storage);
+}
+
+template <typename T, typename E> inline const T& Expected<T, E>::value() const& {
+    ENSURE(hasValue());
+    return *std::get_if<0>(&storage);
+}
+
+template <typename T, typename E> inline T&& Expected<T, E>::value() && {
+    ENSURE(hasValue());
+    return std::move(*std::get_if<0>(&storage));
+}
+
+template <typename T, typename E> inline T& Expected<T, E>::operator*() & {
+    return value();
+}
+
+template <typename T, typename E> inline const T& Expected<T, E>::operator*() const& {
+    return value();
+}
+
+template <typename T, typename E> inline T&& Expected<T, E>::operator*() && {
+    return std::move(*this).value();
+}
+
+template <typename T, typename E> inline T* Expected<T, E>::operator->() {
+    return &value();
+}
+
+template <typename T, typename E> inline const T* Expected<T, E>::operator->() const {
+    return &value();
+}
+
+template <typename T, typename E>
+template <typename U>
+inline T Expected<T, E>::valueOr(U&& fallback) const& {
+    if (hasValue()) {
+        return *std::get_if<0>(&storage);
+    }
+    return static_cast<T>(std::forward<U>(fallback));
+}
+
+template <typename T, typename E> inline E& Expected<T, E>::error() & {
+    ENSURE(!hasValue());
+    return *std::get_if<1>(&storage);
+}
+
+template <typename T, typename E> inline const E& Expected<T, E>::error() const& {
+    ENSURE(!hasValue());
+    return *std::get_if<1>(&storage);
+}
+
+template <typename T, typename E> inline E&& Expected<T, E>::error() && {
+    ENSURE(!hasValue());
+    return std::move(*std::get_if<1>(&storage));
+}
+
+template <typename E> inline Expected<void, E>::Expected() noexcept {
+}
+
+template <typename E>
+template <typename G>
+inline Expected<void, E>::Expected(Unexpected<G> error) : err{std::move(error).error()} {
+}
+
+template <typename E> inline bool Expected<void, E>::hasValue() const noexcept {
+    return !err.has_value();
+}
+
+template <typename E> inline Expected<void, E>::operator bool() const noexcept {
+    return hasValue();
+}
+
+template <typename E> inline E& Expected<void, E>::error() & {
+    ENSURE(!hasValue());
+    return *err;
+}
+
+template <typename E> inline const E& Expected<void, E>::error() const& {
+    ENSURE(!hasValue());
+    return *err;
+}
+
+template <typename E> inline E&& Expected<void, E>::error() && {
+    ENSURE(!hasValue());
+    return std::move(*err);
+}
+
+} // namespace Util
+
+#endif // EXPECTED_H
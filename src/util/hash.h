@@ -0,0 +1,28 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Util {
+
+/**
+ * Non-cryptographic 64 bit hash of a byte range (XXH64). Fast enough to run over whole
+ * preprocessed translation units, and stable across runs and hosts, so it can be used to
+ * build on-disk keys.
+ *
+ * @param data start of the range to hash.
+ * @param len length of the range in bytes.
+ * @param seed seed value; different seeds give independent hashes of the same data.
+ * @return the hash value.
+ */
+uint64_t hash64(const void* data, std::size_t len, uint64_t seed = 0);
+
+inline uint64_t hash64(const std::string& str, uint64_t seed = 0) {
+    return hash64(str.data(), str.size(), seed);
+}
+
+} // namespace Util
+
+#endif // HASH_H
@@ -0,0 +1,214 @@
+#include "memstats.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace Util {
+
+namespace {
+
+struct CounterData {
+    const char* name;
+    atomic<int64_t> live;
+    atomic<int64_t> peak;
+    atomic<uint64_t> allocBytes;
+    atomic<uint64_t> allocCount;
+};
+
+struct PhaseCounter {
+    uint64_t allocBytes;
+    uint64_t allocCount;
+    int64_t peak;
+    int64_t live;
+};
+
+struct Phase {
+    string name;
+    // position in begin order, so nested phases are reported after their parent
+    size_t seq;
+    size_t depth;
+    vector<PhaseCounter> counters;
+    long rssKb;
+};
+
+struct MemState {
+    mutex lock;
+    CounterData counters[MemStats::MAX_COUNTERS]{};
+    atomic<size_t> numCounters{0};
+    // open phases hold their totals at entry until they are closed
+    vector<Phase> open;
+    vector<Phase> done;
+    size_t numPhases = 0;
+};
+
+MemState& state() {
+    static MemState memState;
+    return memState;
+}
+
+void atomicMax(atomic<int64_t>& target, int64_t val) {
+    int64_t cur = target.load(memory_order_relaxed);
+    while (cur < val && !target.compare_exchange_weak(cur, val, memory_order_relaxed)) {
+    }
+}
+
+/**
+ * Fold the high-water marks since the last reset into the innermost open phase and start
+ * a new interval.
+ */
+void foldPeaks(MemState& st) {
+    size_t n = st.numCounters.load();
+    if (!st.open.empty()) {
+        // counters registered since the phase began started out at zero
+        st.open.back().counters.resize(n, {0, 0, 0, 0});
+    }
+    for (size_t i = 0; i < n; ++i) {
+        CounterData& c = st.counters[i];
+        int64_t peak = c.peak.exchange(c.live.load(memory_order_relaxed));
+        if (!st.open.empty()) {
+            PhaseCounter& pc = st.open.back().counters[i];
+            pc.peak = max(pc.peak, peak);
+        }
+    }
+}
+
+} // namespace
+
+atomic<bool> MemStats::active{false};
+
+MemStats::Counter MemStats::counter(const char* name) {
+    MemState& st = state();
+    lock_guard<mutex> guard(st.lock);
+    size_t n = st.numCounters.load();
+    for (size_t i = 0; i < n; ++i) {
+        if (strcmp(st.counters[i].name, name) == 0) {
+            return i;
+        }
+    }
+    if (n >= MAX_COUNTERS - 1) {
+        // out of counters; lump the rest together rather than failing, under a name of
+        // their own so they aren't charged to whichever counter came last
+        if (n == MAX_COUNTERS - 1) {
+            st.counters[n].name = "other";
+            st.numCounters.store(MAX_COUNTERS);
+        }
+        return MAX_COUNTERS - 1;
+    }
+    st.counters[n].name = name;
+    st.numCounters.store(n + 1);
+    return n;
+}
+
+void MemStats::enable() {
+    active.store(true, memory_order_relaxed);
+}
+
+void MemStats::doAlloc(std::size_t counter, std::size_t bytes) {
+    CounterData& c = state().counters[counter];
+    int64_t live = c.live.fetch_add(static_cast<int64_t>(bytes), memory_order_relaxed) +
+                   static_cast<int64_t>(bytes);
+    atomicMax(c.peak, live);
+    c.allocBytes.fetch_add(bytes, memory_order_relaxed);
+    c.allocCount.fetch_add(1, memory_order_relaxed);
+}
+
+void MemStats::doRelease(std::size_t counter, std::size_t bytes) {
+    CounterData& c = state().counters[counter];
+    c.live.fetch_sub(static_cast<int64_t>(bytes), memory_order_relaxed);
+}
+
+void MemStats::beginPhase(const char* name) {
+    MemState& st = state();
+    lock_guard<mutex> guard(st.lock);
+    foldPeaks(st);
+    Phase phase{name, st.numPhases++, st.open.size(), {}, 0};
+    size_t n = st.numCounters.load();
+    for (size_t i = 0; i < n; ++i) {
+        CounterData& c = st.counters[i];
+        int64_t live = c.live.load(memory_order_relaxed);
+        phase.counters.push_back({c.allocBytes.load(), c.allocCount.load(), live, live});
+    }
+    st.open.push_back(move(phase));
+}
+
+void MemStats::endPhase() {
+    MemState& st = state();
+    lock_guard<mutex> guard(st.lock);
+    if (st.open.empty()) {
+        return;
+    }
+    foldPeaks(st);
+    Phase phase = move(st.open.back());
+    st.open.pop_back();
+    size_t n = phase.counters.size();
+    for (size_t i = 0; i < n; ++i) {
+        CounterData& c = st.counters[i];
+        PhaseCounter& pc = phase.counters[i];
+        pc.allocBytes = c.allocBytes.load() - pc.allocBytes;
+        pc.allocCount = c.allocCount.load() - pc.allocCount;
+        pc.live = c.live.load();
+        if (!st.open.empty() && i < st.open.back().counters.size()) {
+            PhaseCounter& outer = st.open.back().counters[i];
+            outer.peak = max(outer.peak, pc.peak);
+        }
+    }
+    phase.rssKb = peakRssKb();
+    st.done.push_back(move(phase));
+}
+
+long MemStats::peakRssKb() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    // ru_maxrss is in KiB on Linux
+    return usage.ru_maxrss;
+}
+
+void MemStats::writeReport(std::ostream& out) {
+    MemState& st = state();
+    lock_guard<mutex> guard(st.lock);
+    auto kib = [](int64_t bytes) { return max<int64_t>(bytes, 0) / 1024.0; };
+
+    out << "===-------------------------------------------------------------===\n"
+        << "                      ecc memory report\n"
+        << "===-------------------------------------------------------------===\n"
+        << "  Peak RSS: " << peakRssKb() << " KiB\n";
+    vector<const Phase*> phases;
+    for (const Phase& phase : st.done) {
+        phases.push_back(&phase);
+    }
+    sort(phases.begin(), phases.end(),
+         [](const Phase* a, const Phase* b) { return a->seq < b->seq; });
+
+    out << fixed << setprecision(1);
+    for (const Phase* phasePtr : phases) {
+        const Phase& phase = *phasePtr;
+        out << "\n" << string(phase.depth * 2, ' ') << "Phase '" << phase.name
+            << "' (peak RSS " << phase.rssKb << " KiB)\n"
+            << "    Alloc (KiB)    Allocs   Peak (KiB)   Live (KiB)  Counter\n";
+        for (size_t i = 0; i < phase.counters.size(); ++i) {
+            const PhaseCounter& pc = phase.counters[i];
+            if (pc.allocCount == 0 && pc.peak <= 0) {
+                continue;
+            }
+            out << setw(15) << pc.allocBytes / 1024.0 << setw(10) << pc.allocCount
+                << setw(13) << kib(pc.peak) << setw(13) << kib(pc.live) << "  "
+                << st.counters[i].name << "\n";
+        }
+    }
+    out.unsetf(ios::floatfield);
+}
+
+} // namespace Util
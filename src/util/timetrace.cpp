@@ -0,0 +1,149 @@
+#include "timetrace.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace Util {
+
+namespace {
+
+struct Event {
+    string name;
+    string detail;
+    int64_t startUs;
+    int64_t durUs;
+    size_t tid;
+};
+
+struct TraceState {
+    mutex lock;
+    vector<Event> events;
+    unordered_map<thread::id, size_t> tids;
+    TimeTrace::Clock::time_point origin;
+};
+
+TraceState& state() {
+    static TraceState traceState;
+    return traceState;
+}
+
+void writeJsonString(ostream& out, string_view str) {
+    out << '"';
+    for (char c : str) {
+        switch (c) {
+            case '"':
+                out << "\\\"";
+                break;
+            case '\\':
+                out << "\\\\";
+                break;
+            case '\n':
+                out << "\\n";
+                break;
+            case '\t':
+                out << "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    out << "\\u" << hex << setw(4) << setfill('0') << static_cast<int>(c)
+                        << dec << setfill(' ');
+                } else {
+                    out << c;
+                }
+        }
+    }
+    out << '"';
+}
+
+} // namespace
+
+atomic<bool> TimeTrace::active{false};
+
+void TimeTrace::enable() {
+    TraceState& st = state();
+    lock_guard<mutex> guard(st.lock);
+    st.events.clear();
+    st.tids.clear();
+    st.origin = Clock::now();
+    active.store(true, memory_order_relaxed);
+}
+
+void TimeTrace::record(std::string_view name, std::string_view detail,
+                       Clock::time_point start, Clock::time_point end) {
+    TraceState& st = state();
+    lock_guard<mutex> guard(st.lock);
+    // small sequential thread ids read better in the viewer than hashed native ids
+    auto tid = st.tids.emplace(this_thread::get_id(), st.tids.size()).first->second;
+    st.events.push_back({string(name), string(detail),
+                         duration_cast<microseconds>(start - st.origin).count(),
+                         duration_cast<microseconds>(end - start).count(), tid});
+}
+
+void TimeTrace::writeChromeTrace(std::ostream& out) {
+    TraceState& st = state();
+    lock_guard<mutex> guard(st.lock);
+    out << "{\"traceEvents\":[";
+    for (size_t i = 0; i < st.events.size(); ++i) {
+        const Event& ev = st.events[i];
+        out << (i ? ",\n" : "\n") << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << ev.tid
+            << ",\"ts\":" << ev.startUs << ",\"dur\":" << ev.durUs << ",\"name\":";
+        writeJsonString(out, ev.name);
+        if (!ev.detail.empty()) {
+            out << ",\"args\":{\"detail\":";
+            writeJsonString(out, ev.detail);
+            out << "}";
+        }
+        out << "}";
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+void TimeTrace::writeReport(std::ostream& out) {
+    struct Total {
+        string name;
+        int64_t us;
+        size_t count;
+    };
+    TraceState& st = state();
+    vector<Total> totals;
+    int64_t wallUs;
+    {
+        lock_guard<mutex> guard(st.lock);
+        unordered_map<string_view, size_t> index;
+        for (const Event& ev : st.events) {
+            auto it = index.emplace(ev.name, totals.size()).first;
+            if (it->second == totals.size()) {
+                totals.push_back({ev.name, 0, 0});
+            }
+            totals[it->second].us += ev.durUs;
+            ++totals[it->second].count;
+        }
+        wallUs = duration_cast<microseconds>(Clock::now() - st.origin).count();
+    }
+    sort(totals.begin(), totals.end(),
+         [](const Total& a, const Total& b) { return a.us > b.us; });
+
+    // nested scopes are counted in full by every enclosing scope, so the percentages
+    // are of wall time and need not add up to 100
+    out << "===-------------------------------------------------------------===\n"
+        << "                      ecc time report\n"
+        << "===-------------------------------------------------------------===\n"
+        << "  Total wall time: " << fixed << setprecision(4) << wallUs / 1e6 << " s\n\n"
+        << "     Time (s)    % wall     Count  Name\n";
+    for (const Total& total : totals) {
+        double pct = wallUs ? 100.0 * static_cast<double>(total.us) / wallUs : 0.0;
+        out << setw(13) << setprecision(4) << total.us / 1e6 << setw(9) << setprecision(1)
+            << pct << "%" << setw(10) << total.count << "  " << total.name << "\n";
+    }
+    out.unsetf(ios::floatfield);
+}
+
+} // namespace Util
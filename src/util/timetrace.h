@@ -0,0 +1,106 @@
+/**
+ * Compile time profiling.
+ *
+ * Phases of the compiler are wrapped in TIME_SCOPE markers. When tracing is enabled every
+ * scope records a complete event, and the events can be written out as Chrome trace-event
+ * JSON (viewable in chrome://tracing or Perfetto) or summarized as a per-phase table.
+ * When tracing is disabled a scope costs one load and one well predicted branch.
+ */
+#ifndef TIMETRACE_H
+#define TIMETRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+namespace Util {
+
+class TimeTrace {
+private:
+    // read by every scope on every thread; a relaxed load is enough, since events
+    // themselves are published under the trace lock
+    static std::atomic<bool> active;
+
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Start recording. Events recorded before a previous enable() are discarded.
+     */
+    static void enable();
+    static bool enabled() noexcept;
+
+    /**
+     * Record a finished event. Thread safe.
+     *
+     * @param name event name; events with the same name are aggregated in the report.
+     * @param detail extra information shown in the trace viewer (e.g. function name).
+     * @param start time the event began.
+     * @param end time the event ended.
+     */
+    static void record(std::string_view name, std::string_view detail,
+                       Clock::time_point start, Clock::time_point end);
+
+    /**
+     * Write all events as Chrome trace-event JSON.
+     */
+    static void writeChromeTrace(std::ostream& out);
+    /**
+     * Write a table of total time and count per event name, slowest first.
+     */
+    static void writeReport(std::ostream& out);
+};
+
+/**
+ * RAII timer recording a single event over its lifetime.
+ */
+class TimeScope {
+private:
+    const char* name;
+    std::string detail;
+    TimeTrace::Clock::time_point start;
+    bool live;
+
+public:
+    explicit TimeScope(const char* name);
+    TimeScope(const char* name, std::string_view detail);
+    ~TimeScope();
+    TimeScope(const TimeScope&) = delete;
+    TimeScope& operator=(const TimeScope&) = delete;
+};
+
+inline bool TimeTrace::enabled() noexcept {
+    return active.load(std::memory_order_relaxed);
+}
+
+inline TimeScope::TimeScope(const char* name) : name{name}, live{TimeTrace::enabled()} {
+    if (live) {
+        start = TimeTrace::Clock::now();
+    }
+}
+
+inline TimeScope::TimeScope(const char* name, std::string_view detail)
+    : name{name}, live{TimeTrace::enabled()} {
+    if (live) {
+        this->detail = detail;
+        start = TimeTrace::Clock::now();
+    }
+}
+
+inline TimeScope::~TimeScope() {
+    if (live) {
+        TimeTrace::record(name, detail, start, TimeTrace::Clock::now());
+    }
+}
+
+} // namespace Util
+
+#define TIME_SCOPE_CAT_(a, b) a##b
+#define TIME_SCOPE_CAT(a, b) TIME_SCOPE_CAT_(a, b)
+// Time the rest of the enclosing block, e.g. TIME_SCOPE("isel", fn.name()).
+#define TIME_SCOPE(...) Util::TimeScope TIME_SCOPE_CAT(timeScope_, __LINE__)(__VA_ARGS__)
+
+#endif // TIMETRACE_H
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "cli/argparse.h"
+
+using namespace std;
+using ArgParse::ArgumentParser;
+
+namespace {
+
+struct Expansion {
+    bool ok;
+    string error;
+    vector<string> args;
+};
+
+Expansion expand(vector<const char*> args) {
+    vector<unique_ptr<char[]>> buffers;
+    Util::Expected<void> res = ArgumentParser::expandResponseFiles(args, buffers);
+    Expansion out{static_cast<bool>(res), "", {}};
+    if (!res) {
+        out.error = res.error().message();
+    }
+    out.args.assign(args.begin(), args.end());
+    return out;
+}
+
+string writeTemp(const string& name, const string& contents) {
+    string path = "/tmp/ecc-check-" + to_string(getpid()) + "-" + name;
+    ofstream(path, ios::binary) << contents;
+    return path;
+}
+
+} // namespace
+
+TEST_CASE("cli/response_file_split") {
+    string path = writeTemp("split.rsp", "  -O2\t-c\n\nmain.c  -o out.o\n");
+    string at = "@" + path;
+    Expansion res = expand({"-v", at.c_str(), "tail"});
+    CHECK(res.ok);
+    vector<string> want{"-v", "-O2", "-c", "main.c", "-o", "out.o", "tail"};
+    CHECK(res.args == want);
+    remove(path.c_str());
+}
+
+TEST_CASE("cli/response_file_quoting") {
+    string path = writeTemp("quote.rsp", "'a b' \"c 'd'\" e\\ f \"g\\\"h\" '' i'j'k");
+    string at = "@" + path;
+    Expansion res = expand({at.c_str()});
+    CHECK(res.ok);
+    CHECK((res.args == vector<string>{"a b", "c 'd'", "e f", "g\"h", "", "ijk"}));
+    remove(path.c_str());
+}
+
+TEST_CASE("cli/response_file_nested") {
+    string inner = writeTemp("inner.rsp", "x y");
+    string outer = writeTemp("outer.rsp", "a @" + inner + " b");
+    string at = "@" + outer;
+    Expansion res = expand({at.c_str()});
+    CHECK((res.args == vector<string>{"a", "x", "y", "b"}));
+    string self = writeTemp("self.rsp", "");
+    ofstream(self) << "@" << self;
+    at = "@" + self;
+    res = expand({at.c_str()});
+    CHECK(!res.ok && res.error.find("nested too deeply") != string::npos);
+    remove(inner.c_str());
+    remove(outer.c_str());
+    remove(self.c_str());
+}
+
+TEST_CASE("cli/response_file_special") {
+    // a missing file is kept as a plain argument, as in GCC
+    Expansion res = expand({"@/nonexistent/ecc.rsp"});
+    CHECK((res.ok && res.args == vector<string>{"@/nonexistent/ecc.rsp"}));
+    // a directory is an error rather than an allocation of its reported size
+    res = expand({"@/tmp"});
+    CHECK(!res.ok && res.error.find("is a directory") != string::npos);
+    // pipes have no size and are read to their end
+    int fds[2];
+    CHECK(pipe(fds) == 0);
+    CHECK(write(fds[1], "p 'q r'", 7) == 7);
+    close(fds[1]);
+    string at = "@/dev/fd/" + to_string(fds[0]);
+    res = expand({at.c_str()});
+    CHECK((res.ok && res.args == vector<string>{"p", "q r"}));
+    close(fds[0]);
+}
+
+namespace {
+
+Util::Expected<ArgParse::Args> parse(ArgumentParser& parser, vector<string> words) {
+    vector<char*> argv;
+    for (string& word : words) {
+        argv.push_back(&word[0]);
+    }
+    return parser.parseArgs(static_cast<int>(argv.size()), argv.data());
+}
+
+} // namespace
+
+TEST_CASE("cli/argparse_prefix_chars") {
+    // options added under the old prefix characters never match, and don't break tables
+    ArgumentParser parser;
+    parser.addHelp(false);
+    parser.addArgument("-v").action<ArgParse::StoreTrueAction>();
+    parser.prefixChars("+");
+    parser.addArgument("+q").action<ArgParse::StoreTrueAction>();
+    auto args = parse(parser, {"ecc", "+q"});
+    CHECK(args && args->get<bool>("q").val);
+
+    // changing the prefix characters of a parser that already ran rebuilds its tables
+    ArgumentParser reused;
+    reused.addArgument("-v").action<ArgParse::StoreTrueAction>();
+    CHECK(parse(reused, {"ecc", "-v"}));
+    reused.prefixChars("+-");
+    args = parse(reused, {"ecc", "-v"});
+    CHECK(args && args->get<bool>("v").val);
+}
+
+TEST_CASE("cli/argparse_get_by_reference") {
+    ArgumentParser parser;
+    parser.addArgument("-I").nargs(1).action<ArgParse::AppendAction>();
+    auto args = parse(parser, {"ecc", "-Ia", "-I", "b"});
+    CHECK(args);
+    const vector<string>& dirs = args->get<vector<string>>("I").val;
+    CHECK((dirs == vector<string>{"a", "b"}));
+    // no copy: the entry refers into the parsed arguments
+    CHECK(&dirs == &args->get<vector<string>>("I").val);
+    auto missing = args->get<vector<string>>("nonexistent");
+    CHECK(!missing.present && missing.val.empty());
+}
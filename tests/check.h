@@ -0,0 +1,48 @@
+/**
+ * Minimal regression check harness for `make check`.
+ *
+ * A check is a function registered with TEST_CASE; CHECK records a failure with its
+ * location and keeps going, so one run reports every broken expectation.
+ */
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Check {
+
+struct Case {
+    std::string name;
+    std::function<void()> run;
+};
+
+std::vector<Case>& registry();
+void fail(const char* file, int line, const char* expr);
+
+struct Registrar {
+    Registrar(const char* name, std::function<void()> run) {
+        registry().push_back({name, std::move(run)});
+    }
+};
+
+} // namespace Check
+
+#define CHECK_CAT2(a, b) a##b
+#define CHECK_CAT(a, b) CHECK_CAT2(a, b)
+
+#define TEST_CASE(name)                                                                \
+    static void CHECK_CAT(checkCase, __LINE__)();                                      \
+    static Check::Registrar CHECK_CAT(checkReg, __LINE__)(                             \
+        name, CHECK_CAT(checkCase, __LINE__));                                         \
+    static void CHECK_CAT(checkCase, __LINE__)()
+
+#define CHECK(expr)                                                                    \
+    do {                                                                               \
+        if (!(expr)) {                                                                 \
+            Check::fail(__FILE__, __LINE__, #expr);                                    \
+        }                                                                              \
+    } while (0)
+
+#endif // CHECK_H
@@ -0,0 +1,47 @@
+/**
+ * ecc-check: runs every registered regression check, or those whose name contains the
+ * first argument, and exits with failure if any expectation failed.
+ */
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "check.h"
+
+using namespace std;
+
+namespace {
+
+unsigned failures;
+
+} // namespace
+
+namespace Check {
+
+vector<Case>& registry() {
+    static vector<Case> cases;
+    return cases;
+}
+
+void fail(const char* file, int line, const char* expr) {
+    cerr << file << ":" << line << ": check failed: " << expr << "\n";
+    ++failures;
+}
+
+} // namespace Check
+
+int main(int argc, char** argv) {
+    string filter = argc > 1 ? argv[1] : "";
+    unsigned ran = 0;
+    for (const Check::Case& test : Check::registry()) {
+        if (test.name.find(filter) == string::npos) {
+            continue;
+        }
+        unsigned before = failures;
+        test.run();
+        ++ran;
+        cerr << (failures == before ? "pass " : "FAIL ") << test.name << "\n";
+    }
+    cerr << ran << " checks, " << failures << " failures\n";
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,77 @@
+#include <stdlib.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "check.h"
+#include "cli/compile_cache.h"
+
+using namespace std;
+using Driver::CompileCache;
+namespace fs = std::filesystem;
+
+namespace {
+
+uint64_t estimate(const fs::path& root) {
+    uint64_t size = 0;
+    ifstream(root / "size") >> size;
+    return size;
+}
+
+string key(int i) {
+    return Driver::CacheKeyBuilder().addFlag("i", to_string(i)).finish();
+}
+
+} // namespace
+
+TEST_CASE("cli/compile_cache_store") {
+    char tmpl[] = "/tmp/ecc-check-XXXXXX";
+    CHECK(mkdtemp(tmpl) != nullptr);
+    CompileCache cache(tmpl, 10000);
+    string error;
+    string out;
+    CHECK(cache.store(key(0), string(1000, 'a'), error));
+    CHECK(cache.lookup(key(0), out) && out == string(1000, 'a'));
+    CHECK(!cache.lookup(key(1), out));
+    // the first store finds no estimate and scans; later ones only bump it
+    CHECK(estimate(tmpl) == 1000);
+    CHECK(cache.store(key(1), string(2000, 'b'), error));
+    CHECK(estimate(tmpl) == 3000);
+
+    // age the first two entries, so they are the least recently used, oldest first
+    auto now = fs::file_time_type::clock::now();
+    for (int i = 0; i < 2; ++i) {
+        string k = key(i);
+        fs::last_write_time(fs::path(tmpl) / k.substr(0, 2) / k.substr(2),
+                            now - chrono::hours(2 - i));
+    }
+    // the estimate reaches the limit without a scan, and crossing it evicts the oldest
+    // entries down to 90% of the limit
+    for (int i = 2; i < 9; ++i) {
+        CHECK(cache.store(key(i), string(1000, 'c'), error));
+    }
+    CHECK(estimate(tmpl) == 10000);
+    CHECK(cache.store(key(9), string(1000, 'c'), error));
+    CHECK(estimate(tmpl) == 8000);
+    CHECK(!cache.lookup(key(0), out));
+    CHECK(!cache.lookup(key(1), out));
+    CHECK(cache.lookup(key(9), out));
+    fs::remove_all(tmpl);
+}
+
+TEST_CASE("cli/compile_cache_bad_keys") {
+    char tmpl[] = "/tmp/ecc-check-XXXXXX";
+    CHECK(mkdtemp(tmpl) != nullptr);
+    CompileCache cache(tmpl, 10000);
+    string error;
+    string out;
+    for (string bad : {"", "a", "ab", "../../etc", "ab/cd"}) {
+        CHECK(!cache.store(bad, "x", error));
+        CHECK(!cache.lookup(bad, out));
+    }
+    CHECK(cache.store("abc", "x", error));
+    CHECK(cache.lookup("abc", out) && out == "x");
+    fs::remove_all(tmpl);
+}
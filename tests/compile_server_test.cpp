@@ -0,0 +1,64 @@
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "check.h"
+#include "cli/compile_server.h"
+
+using namespace std;
+using namespace Driver;
+
+TEST_CASE("cli/compile_server_roundtrip") {
+    char tmpl[] = "/tmp/ecc-check-XXXXXX";
+    CHECK(mkdtemp(tmpl) != nullptr);
+    string dir = string(tmpl) + "/run";
+    string sock = dir + "/ecc.sock";
+
+    CompileServer server(
+        sock,
+        [](const CompileRequest& req, ostream& out, ostream& diag) {
+            out << req.cwd << ":" << req.args.size();
+            diag << "warned";
+            return 3;
+        },
+        2);
+    string error;
+    CHECK(server.listen(error));
+    // the server creates the socket directory private to the user
+    struct stat info;
+    CHECK(stat(dir.c_str(), &info) == 0 && (info.st_mode & 0777) == 0700);
+    thread runner([&server]() { server.run(); });
+
+    ostringstream out;
+    ostringstream diag;
+    int status = 0;
+    CHECK(forwardCompile(sock, {"/src", {"ecc", "-c", "a.c"}}, out, diag, status, error));
+    CHECK(out.str() == "/src:3");
+    CHECK(diag.str() == "warned");
+    CHECK(status == 3);
+
+    // a second server on the same socket is refused
+    CompileServer second(sock, nullptr, 1);
+    CHECK(!second.listen(error));
+    server.stop();
+    runner.join();
+
+    rmdir(dir.c_str());
+    rmdir(tmpl);
+}
+
+TEST_CASE("cli/compile_server_shared_dir") {
+    char tmpl[] = "/tmp/ecc-check-XXXXXX";
+    CHECK(mkdtemp(tmpl) != nullptr);
+    // a directory others can write to could have its socket swapped underneath us
+    CHECK(chmod(tmpl, 0755) == 0);
+    CompileServer server(string(tmpl) + "/ecc.sock", nullptr, 1);
+    string error;
+    CHECK(!server.listen(error));
+    CHECK(error.find("mode 0700") != string::npos);
+    rmdir(tmpl);
+}
@@ -0,0 +1,131 @@
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "codegen/elf_writer.h"
+
+using namespace std;
+using namespace Codegen;
+
+namespace {
+
+/**
+ * A hello world object: main calls puts on a local string and returns through a local
+ * helper, which leaves locals and globals interleaved in declaration order.
+ */
+vector<uint8_t> helloObject() {
+    ElfWriter writer;
+    ElfWriter::SymbolId mainSym = writer.addSymbol("main");
+    ElfWriter::SymbolId putsSym = writer.addSymbol("puts");
+    ElfWriter::SymbolId helperSym = writer.addSymbol("helper", ElfWriter::Binding::LOCAL);
+    ElfWriter::SymbolId msgSym = writer.addSymbol("msg", ElfWriter::Binding::LOCAL);
+
+    X86Encoder helper;
+    helper.movImm(Reg::RAX, 0);
+    helper.ret();
+    writer.addFunction(helperSym, helper.finish());
+
+    X86Encoder main;
+    main.push(Reg::RBX);
+    main.leaSym(Reg::RDI, msgSym, 0);
+    main.callSym(putsSym);
+    main.callSym(helperSym);
+    main.pop(Reg::RBX);
+    main.ret();
+    writer.addFunction(mainSym, main.finish());
+
+    const char msg[] = "hello from ecc";
+    writer.addData(msgSym, ElfWriter::Section::RODATA,
+                   ArrayRef<uint8_t>(reinterpret_cast<const uint8_t*>(msg), sizeof(msg)),
+                   1);
+    return writer.finish();
+}
+
+template <typename T> const T* at(const vector<uint8_t>& obj, uint64_t offset) {
+    return reinterpret_cast<const T*>(obj.data() + offset);
+}
+
+} // namespace
+
+TEST_CASE("codegen/elf_writer_tables") {
+    vector<uint8_t> obj = helloObject();
+    const Elf64_Ehdr* ehdr = at<Elf64_Ehdr>(obj, 0);
+    CHECK(memcmp(ehdr->e_ident, ELFMAG, SELFMAG) == 0);
+    CHECK(ehdr->e_type == ET_REL && ehdr->e_machine == EM_X86_64);
+    const Elf64_Shdr* shdrs = at<Elf64_Shdr>(obj, ehdr->e_shoff);
+    const char* shstr = at<char>(obj, shdrs[ehdr->e_shstrndx].sh_offset);
+    auto find = [&](const char* name) -> const Elf64_Shdr* {
+        for (unsigned i = 0; i < ehdr->e_shnum; ++i) {
+            if (strcmp(shstr + shdrs[i].sh_name, name) == 0) {
+                return &shdrs[i];
+            }
+        }
+        return nullptr;
+    };
+    const Elf64_Shdr* symtab = find(".symtab");
+    const Elf64_Shdr* rela = find(".rela.text");
+    CHECK(symtab && rela);
+    if (!symtab || !rela) {
+        return;
+    }
+
+    // locals first, in declaration order, then the globals; sh_info is the first global
+    const Elf64_Sym* syms = at<Elf64_Sym>(obj, symtab->sh_offset);
+    const char* strtab = at<char>(obj, shdrs[symtab->sh_link].sh_offset);
+    vector<string> order;
+    for (size_t i = 1; i < symtab->sh_size / sizeof(Elf64_Sym); ++i) {
+        order.push_back(strtab + syms[i].st_name);
+    }
+    CHECK((order == vector<string>{"helper", "msg", "main", "puts"}));
+    CHECK(symtab->sh_info == 3);
+    CHECK(ELF64_ST_BIND(syms[1].st_info) == STB_LOCAL);
+    CHECK(ELF64_ST_BIND(syms[3].st_info) == STB_GLOBAL);
+    CHECK(syms[4].st_shndx == SHN_UNDEF);
+    // main follows the 6-byte helper at the next 16-byte boundary
+    CHECK(syms[3].st_value == 16 && ELF64_ST_TYPE(syms[3].st_info) == STT_FUNC);
+
+    // push rbx is 1 byte, lea rdi 7 and each call 5, so the fields are at 1 + 3, 8 + 1
+    // and 13 + 1 into main; all are relative to the end of their 4-byte field
+    CHECK(rela->sh_info == find(".text") - shdrs);
+    CHECK(rela->sh_size == 3 * sizeof(Elf64_Rela));
+    const Elf64_Rela* relas = at<Elf64_Rela>(obj, rela->sh_offset);
+    CHECK(relas[0].r_offset == 20 && relas[0].r_addend == -4);
+    CHECK(ELF64_R_SYM(relas[0].r_info) == 2);
+    CHECK(ELF64_R_TYPE(relas[0].r_info) == R_X86_64_PC32);
+    CHECK(relas[1].r_offset == 25 && relas[1].r_addend == -4);
+    CHECK(ELF64_R_SYM(relas[1].r_info) == 4);
+    CHECK(ELF64_R_TYPE(relas[1].r_info) == R_X86_64_PLT32);
+    CHECK(relas[2].r_offset == 30 && ELF64_R_SYM(relas[2].r_info) == 1);
+}
+
+TEST_CASE("codegen/elf_writer_links") {
+    // the object must link with the system toolchain and run; skipped without one
+    if (system("command -v cc > /dev/null 2>&1") != 0) {
+        return;
+    }
+    string base = "/tmp/ecc-check-" + to_string(getpid()) + "-hello";
+    vector<uint8_t> obj = helloObject();
+    FILE* file = fopen((base + ".o").c_str(), "wb");
+    CHECK(file && fwrite(obj.data(), 1, obj.size(), file) == obj.size());
+    if (file) {
+        fclose(file);
+    }
+    CHECK(system(("cc -o " + base + " " + base + ".o").c_str()) == 0);
+    CHECK(system((base + " > " + base + ".out").c_str()) == 0);
+    char out[64] = {};
+    file = fopen((base + ".out").c_str(), "rb");
+    CHECK(file && fread(out, 1, sizeof(out) - 1, file) > 0);
+    if (file) {
+        fclose(file);
+    }
+    CHECK(string(out) == "hello from ecc\n");
+    for (const char* suffix : {"", ".o", ".out"}) {
+        remove((base + suffix).c_str());
+    }
+}
@@ -0,0 +1,25 @@
+#include <cstdint>
+#include <string>
+
+#include "check.h"
+#include "util/hash.h"
+
+using namespace std;
+using Util::hash64;
+
+TEST_CASE("util/hash64_reference") {
+    // published XXH64 test vectors; on-disk cache keys depend on these never changing
+    CHECK(hash64("") == 0xEF46DB3751D8E999ULL);
+    CHECK(hash64("a") == 0xD24EC4F1A98C6E5BULL);
+    CHECK(hash64("abc") == 0x44BC2CF5AD770999ULL);
+    CHECK(hash64("Nobody inspects the spammish repetition") == 0xFBCEA83C8A378BF1ULL);
+    CHECK(hash64(string(), 1) == 0xD5AFBA1336A3BE4BULL);
+
+    // 100 bytes covers the 32-byte stripes and every tail size class
+    string bytes;
+    for (int i = 0; i < 100; ++i) {
+        bytes += static_cast<char>(i);
+    }
+    CHECK(hash64(bytes) == 0x6AC1E58032166597ULL);
+    CHECK(hash64(bytes, 42) == 0x819D2B726001D507ULL);
+}
@@ -0,0 +1,66 @@
+#include "frontend/include_cache.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "check.h"
+
+using namespace std;
+using Frontend::detectIncludeGuard;
+
+TEST_CASE("frontend/include_guard") {
+    CHECK(detectIncludeGuard("#ifndef X\n#define X\nint x;\n#endif\n") == "X");
+    CHECK(detectIncludeGuard("#if !defined(X)\n#define X\n#endif") == "X");
+    CHECK(detectIncludeGuard("#ifndef X\n#define X\n#else\n#endif\n").empty());
+    CHECK(detectIncludeGuard("#ifndef X\n#define X\n#endif\nint y;\n").empty());
+    // directives inside literals and comments don't count
+    CHECK(detectIncludeGuard("#ifndef X\n#define X\nconst char* s = \"\\\n#else\";\n"
+                             "/*\n#endif\n*/\n#endif\n") == "X");
+}
+
+TEST_CASE("frontend/include_guard_unterminated_quote") {
+    // an apostrophe in a diagnostic must not swallow the newline before the next line
+    CHECK(detectIncludeGuard(
+              "#ifndef X\n#define X\n#warning it's\n#else\nint other;\n#endif\n")
+              .empty());
+    CHECK(detectIncludeGuard("#ifndef X\n#define X\n#if A\n#error can't\n#endif\n"
+                             "#endif\n") == "X");
+    CHECK(detectIncludeGuard("#ifndef X\n#define X\n#endif\n'").empty());
+}
+
+TEST_CASE("frontend/include_cache_revalidate") {
+    string path = "/tmp/ecc-check-" + to_string(getpid()) + "-header.h";
+    ofstream(path) << "int a;\n";
+    Frontend::IncludeCache cache;
+    string error;
+    shared_ptr<const Frontend::SourceFile> first = cache.load(path, error);
+    CHECK(first && first->contents == "int a;\n");
+    CHECK(cache.revalidate() == 0);
+    CHECK(cache.load(path, error) == first);
+
+    ofstream(path) << "#ifndef B\n#define B\n#endif\n";
+    CHECK(cache.revalidate() == 1);
+    shared_ptr<const Frontend::SourceFile> second = cache.load(path, error);
+    CHECK(second && second != first && second->guard == "B");
+    // files in use keep their old contents
+    CHECK(first->contents == "int a;\n");
+
+    remove(path.c_str());
+    CHECK(cache.revalidate() == 1);
+    CHECK(!cache.load(path, error));
+}
+
+TEST_CASE("frontend/include_cache_not_regular") {
+    Frontend::IncludeCache cache;
+    string error;
+    CHECK(!cache.load("/tmp", error));
+    CHECK(error.find("not a regular file") != string::npos);
+    // nothing was cached, so a second lookup fails the same way
+    error.clear();
+    CHECK(!cache.load("/tmp", error));
+    CHECK(!error.empty());
+}
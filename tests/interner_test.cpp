@@ -0,0 +1,35 @@
+#include "fds/interner.h"
+
+#include <string>
+#include <vector>
+
+#include "check.h"
+
+using namespace std;
+
+TEST_CASE("fds/interner_large_strings") {
+    StringInterner interner;
+    vector<string> expect;
+    vector<StringInterner::Id> ids;
+    // small strings fill the current block while large ones interleave with them
+    for (size_t i = 0; i < 200; ++i) {
+        string str = i % 4 == 0 ? string(20000 + i, static_cast<char>('a' + i % 26))
+                                : "ident" + to_string(i);
+        expect.push_back(str);
+        ids.push_back(interner.intern(str));
+    }
+    CHECK(interner.size() == expect.size());
+    bool same = true;
+    for (size_t i = 0; i < expect.size(); ++i) {
+        same = same && interner.str(ids[i]) == expect[i] &&
+               interner.intern(expect[i]) == ids[i];
+    }
+    CHECK(same);
+
+    // the arena moves with the interner, so interned views stay valid
+    string_view large = interner.str(ids[0]);
+    StringInterner moved(std::move(interner));
+    CHECK(moved.str(ids[0]).data() == large.data());
+    CHECK(moved.intern(expect[0]) == ids[0]);
+    CHECK(moved.intern("") == moved.intern(""));
+}
@@ -0,0 +1,157 @@
+#include "ir/interpreter.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "check.h"
+
+using namespace std;
+using IR::BcBuilder;
+using IR::BcFunction;
+using IR::BcInsn;
+using IR::BcOp;
+using IR::Interpreter;
+using IR::InterpreterLimits;
+
+namespace {
+
+// f(a, b) = a op b
+BcFunction binaryFunc(BcOp op) {
+    BcBuilder b("f", 2);
+    auto dst = b.newReg();
+    b.binary(op, dst, b.param(0), b.param(1));
+    b.ret(dst);
+    return b.finish();
+}
+
+// f(n) counts n down to zero: n taken jumps back plus the taken exit, so n + 1 steps
+BcFunction countdownFunc() {
+    BcBuilder b("countdown", 1);
+    auto n = b.param(0);
+    auto loop = b.newLabel();
+    auto done = b.newLabel();
+    b.bind(loop);
+    b.jz(n, done);
+    b.addImm(n, n, -1);
+    b.jmp(loop);
+    b.bind(done);
+    b.ret(n);
+    return b.finish();
+}
+
+Interpreter make(vector<BcFunction> program, size_t memorySize = 0,
+                 InterpreterLimits limits = {}) {
+    return move(Interpreter::create(program, memorySize, limits).value());
+}
+
+// the trap message of a run, or empty if it returned
+string trapOf(Interpreter& interp, vector<int64_t> args) {
+    auto res = interp.run(0, args);
+    return res ? "" : res.error().message();
+}
+
+// the error of create for a program of one function
+string createError(const BcFunction& func) {
+    auto res = Interpreter::create(vector<BcFunction>{func});
+    return res ? "" : res.error().message();
+}
+
+} // namespace
+
+TEST_CASE("ir/interpreter_division_traps") {
+    Interpreter div = make({binaryFunc(BcOp::DIV)});
+    CHECK(div.run(0, {-7, 2}).value() == -3);
+    CHECK(trapOf(div, {1, 0}) == "division by zero in 'f'");
+    // INT64_MIN / -1 overflows and wraps instead of trapping the host
+    CHECK(div.run(0, {INT64_MIN, -1}).value() == INT64_MIN);
+
+    Interpreter rem = make({binaryFunc(BcOp::REM)});
+    CHECK(rem.run(0, {-7, 2}).value() == -1);
+    CHECK(trapOf(rem, {1, 0}) == "division by zero in 'f'");
+    CHECK(rem.run(0, {INT64_MIN, -1}).value() == 0);
+}
+
+TEST_CASE("ir/interpreter_memory_bounds") {
+    BcBuilder lb("load", 1);
+    auto val = lb.newReg();
+    lb.load(val, lb.param(0));
+    lb.ret(val);
+    BcBuilder sb("storeByte", 1);
+    sb.storeByte(sb.param(0), sb.param(0));
+    sb.ret(sb.param(0));
+    vector<BcFunction> program;
+    program.push_back(lb.finish());
+    program.push_back(sb.finish());
+    Interpreter interp = make(move(program), 16);
+
+    CHECK(interp.run(0, {8}).value() == 0);
+    CHECK(trapOf(interp, {9}) == "load out of bounds in 'load'");
+    // an address that wraps around when the access size is added
+    CHECK(trapOf(interp, {-1}) == "load out of bounds in 'load'");
+    CHECK(interp.run(1, {15}).value() == 15);
+    CHECK(interp.memory()[15] == 15);
+    CHECK(!interp.run(1, {16}));
+}
+
+TEST_CASE("ir/interpreter_call_depth") {
+    // f(n) = f(n), stopped only by the depth limit
+    BcBuilder b("f", 1);
+    auto dst = b.newReg();
+    b.call(dst, 0, b.param(0), 1);
+    b.ret(dst);
+    InterpreterLimits limits;
+    limits.maxDepth = 8;
+    Interpreter interp = make({b.finish()}, 0, limits);
+    CHECK(trapOf(interp, {1}) == "call stack overflow in 'f'");
+    // a trap leaves the interpreter usable
+    CHECK(trapOf(interp, {1}) == "call stack overflow in 'f'");
+}
+
+TEST_CASE("ir/interpreter_step_limit") {
+    InterpreterLimits limits;
+    limits.maxSteps = 11;
+    Interpreter interp = make({countdownFunc()}, 0, limits);
+    CHECK(interp.run(0, {10}).value() == 0);
+    CHECK(trapOf(interp, {11}) == "step limit exceeded in 'countdown'");
+
+    // no steps at all: straight-line code still runs, the first taken jump traps
+    limits.maxSteps = 0;
+    Interpreter none = make({countdownFunc()}, 0, limits);
+    CHECK(trapOf(none, {0}) == "step limit exceeded in 'countdown'");
+    BcBuilder b("id", 1);
+    b.ret(b.param(0));
+    Interpreter straight = make({b.finish()}, 0, limits);
+    CHECK(straight.run(0, {5}).value() == 5);
+}
+
+TEST_CASE("ir/interpreter_create_validation") {
+    BcFunction func;
+    func.name = "g";
+    func.numParams = 2;
+    func.numRegs = 1;
+    func.code = {{BcOp::RET, 0, 0, 0, 0}};
+    CHECK(createError(func) == "bytecode of 'g': more parameters than registers");
+
+    func.numParams = 0;
+    func.numRegs = 2;
+    func.code.clear();
+    CHECK(createError(func) == "bytecode of 'g': control reaches the end of the code");
+    func.code = {{BcOp::MOV, 0, 1, 0, 0}};
+    CHECK(createError(func) == "bytecode of 'g': control reaches the end of the code");
+
+    func.code = {{BcOp::ADD, 0, 1, 2, 0}, {BcOp::RET, 0, 0, 0, 0}};
+    CHECK(createError(func) == "bytecode of 'g': register out of range");
+    func.code = {{BcOp::JMP, 0, 0, 0, 2}, {BcOp::RET, 0, 0, 0, 0}};
+    CHECK(createError(func) == "bytecode of 'g': jump target out of range");
+    func.code = {{BcOp::MOVK, 0, 0, 0, 0}, {BcOp::RET, 0, 0, 0, 0}};
+    CHECK(createError(func) == "bytecode of 'g': constant out of range");
+    func.code = {{BcOp::CALL, 0, 0, 0, 1}, {BcOp::RET, 0, 0, 0, 0}};
+    CHECK(createError(func) == "bytecode of 'g': callee out of range");
+    // g takes no parameters, so calling it with one argument is malformed
+    func.code = {{BcOp::CALL, 0, 0, 1, 0}, {BcOp::RET, 0, 0, 0, 0}};
+    CHECK(createError(func) == "bytecode of 'g': bad arguments for 'g'");
+
+    func.code = {{BcOp::MOVI, 0, 0, 0, 3}, {BcOp::RET, 0, 0, 0, 0}};
+    CHECK(createError(func).empty());
+}
@@ -0,0 +1,112 @@
+#include "codegen/jit.h"
+
+#include <stdlib.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "check.h"
+
+using namespace std;
+using namespace Codegen;
+
+// process symbols for the generated code to reach; the executable is mapped far more than
+// 2GB away from the anonymous mapping of a JIT image
+long jitFarValue = 42;
+
+long jitFarTwice(long val) {
+    return 2 * val;
+}
+
+namespace {
+
+void* farResolver(const string& name) {
+    if (name == "far_twice") {
+        return reinterpret_cast<void*>(&jitFarTwice);
+    }
+    if (name == "far_value") {
+        return &jitFarValue;
+    }
+    return nullptr;
+}
+
+// f(x) = callee(x), keeping the stack 16-byte aligned across the call
+FunctionCode callThrough(ElfWriter::SymbolId callee) {
+    X86Encoder enc;
+    enc.push(Reg::RBX);
+    enc.callSym(callee);
+    enc.pop(Reg::RBX);
+    enc.ret();
+    return enc.finish();
+}
+
+} // namespace
+
+TEST_CASE("codegen/jit_call_libc") {
+    ElfWriter writer;
+    ElfWriter::SymbolId fn = writer.addSymbol("f");
+    writer.addFunction(fn, callThrough(writer.addSymbol("labs")));
+    auto image = JitImage::load(writer);
+    CHECK(image);
+    if (!image) {
+        return;
+    }
+    auto f = image.value().function<long(long)>("f");
+    CHECK(f && f(-5) == 5);
+    CHECK(image.value().symbol("labs") == reinterpret_cast<void*>(&labs));
+}
+
+TEST_CASE("codegen/jit_call_far_through_stub") {
+    ElfWriter writer;
+    ElfWriter::SymbolId fn = writer.addSymbol("f");
+    writer.addFunction(fn, callThrough(writer.addSymbol("far_twice")));
+    auto image = JitImage::load(writer, farResolver);
+    CHECK(image);
+    if (!image) {
+        return;
+    }
+    auto f = image.value().function<long(long)>("f");
+    CHECK(f && f(21) == 42);
+    // the call after the 1-byte push lands on a jmp [rip + table entry] stub
+    const uint8_t* code = reinterpret_cast<const uint8_t*>(f);
+    int32_t rel;
+    memcpy(&rel, code + 2, sizeof(rel));
+    const uint8_t* stub = code + 6 + rel;
+    CHECK(stub[0] == 0xff && stub[1] == 0x25);
+}
+
+TEST_CASE("codegen/jit_lea_far_symbol") {
+    ElfWriter writer;
+    ElfWriter::SymbolId fn = writer.addSymbol("f");
+    ElfWriter::SymbolId value = writer.addSymbol("far_value");
+    X86Encoder enc;
+    enc.leaSym(Reg::RAX, value, 0);
+    enc.ret();
+    writer.addFunction(fn, enc.finish());
+    auto image = JitImage::load(writer, farResolver);
+    CHECK(image);
+    if (!image) {
+        return;
+    }
+    auto f = image.value().function<long*()>("f");
+    CHECK(f && f() == &jitFarValue && *f() == 42);
+    // lea rax, [rip + far_value] was turned into mov rax, [rip + table entry]
+    const uint8_t* code = reinterpret_cast<const uint8_t*>(f);
+    CHECK(code[0] == 0x48 && code[1] == 0x8b);
+}
+
+TEST_CASE("codegen/jit_undefined_symbol") {
+    ElfWriter writer;
+    ElfWriter::SymbolId fn = writer.addSymbol("f");
+    writer.addFunction(fn, callThrough(writer.addSymbol("missing")));
+    auto image = JitImage::load(writer, farResolver);
+    CHECK(!image && image.error().message() == "undefined symbol 'missing'");
+
+    ElfWriter other;
+    fn = other.addSymbol("f");
+    other.addFunction(fn, callThrough(other.addSymbol("ecc_no_such_symbol")));
+    auto unresolved = JitImage::load(other);
+    CHECK(!unresolved &&
+          unresolved.error().message() == "undefined symbol 'ecc_no_such_symbol'");
+}
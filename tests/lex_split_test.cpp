@@ -0,0 +1,39 @@
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "frontend/lex_split.h"
+
+using namespace std;
+using Frontend::findSplitPoints;
+using Frontend::SplitPoint;
+
+namespace {
+
+vector<SplitPoint> split(const string& src, size_t chunkSize) {
+    // copy into an exactly sized buffer, so reading past the end is caught by ASan
+    vector<char> buf(src.begin(), src.end());
+    return findSplitPoints(buf.data(), buf.size(), chunkSize);
+}
+
+} // namespace
+
+TEST_CASE("frontend/split_points") {
+    vector<SplitPoint> splits = split("a;\nb;\nc;\nd;\n", 3);
+    CHECK(splits.size() == 3);
+    CHECK(splits[0].offset == 3 && splits[0].line == 2);
+    // no split inside a block comment, literal or after a line splice
+    splits = split("/*\n\n*/\n\"\\\n\"\nx\\\ny\nz\n", 1);
+    CHECK(splits.size() == 3);
+    CHECK(splits[0].offset == 7 && splits[0].line == 4);
+    CHECK(splits[1].offset == 12 && splits[1].line == 6);
+    CHECK(splits[2].offset == 17 && splits[2].line == 8);
+}
+
+TEST_CASE("frontend/split_points_trailing_backslash") {
+    // an escape at the very end of the input must not step past it
+    CHECK(split("x = \"abc\\", 1).empty());
+    CHECK(split("x = 'a\\", 1).empty());
+    CHECK(split("// comment \\", 1).empty());
+    CHECK(split("a\n\"\\", 1).size() == 1);
+}
@@ -0,0 +1,38 @@
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "util/memstats.h"
+
+using namespace std;
+using Util::MemStats;
+
+TEST_CASE("util/memstats_other_counter") {
+    // names must outlive the registry, which keeps the pointers
+    static vector<string> names;
+    names.reserve(MemStats::MAX_COUNTERS + 8);
+    set<MemStats::Counter> ids;
+    for (size_t i = 0; i < MemStats::MAX_COUNTERS + 8; ++i) {
+        names.push_back("check_counter_" + to_string(i));
+        ids.insert(MemStats::counter(names.back().c_str()));
+    }
+    // counters are handed out in order, after those of the modules linked in; every
+    // counter past the table shares one, which isn't any named counter
+    MemStats::Counter first = MemStats::counter(names.front().c_str());
+    CHECK(ids.size() == MemStats::MAX_COUNTERS - first);
+    MemStats::Counter other = MemStats::counter("check_counter_overflow");
+    CHECK(other == MemStats::MAX_COUNTERS - 1);
+    CHECK(MemStats::counter(names.back().c_str()) == other);
+    CHECK(MemStats::counter(names.front().c_str()) != other);
+
+    MemStats::enable();
+    {
+        Util::MemPhase phase("check");
+        MemStats::alloc(other, 4096);
+    }
+    ostringstream report;
+    MemStats::writeReport(report);
+    CHECK(report.str().find("  other\n") != string::npos);
+}
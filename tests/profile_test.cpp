@@ -0,0 +1,67 @@
+#include "ir/profile.h"
+
+#include <sstream>
+#include <string>
+
+#include "check.h"
+
+using namespace std;
+using IR::FunctionProfile;
+using IR::ProfileData;
+
+namespace {
+
+string serialize(const ProfileData& profile) {
+    ostringstream out;
+    profile.write(out);
+    return out.str();
+}
+
+} // namespace
+
+TEST_CASE("ir/profile_write_is_ordered") {
+    ProfileData forward;
+    ProfileData backward;
+    const char* names[] = {"alpha", "beta", "gamma", "delta", "epsilon"};
+    for (const char* name : names) {
+        forward.merge({name, 1, {2, 3}});
+    }
+    for (size_t i = 5; i-- > 0;) {
+        backward.merge({names[i], 1, {2, 3}});
+    }
+    CHECK(serialize(forward) == serialize(backward));
+
+    ProfileData copy;
+    string error;
+    istringstream in(serialize(forward));
+    CHECK(copy.read(in, error) && copy.size() == 5);
+    CHECK(copy.find("delta") && copy.find("delta")->counters[1] == 3);
+}
+
+TEST_CASE("ir/profile_read_is_all_or_nothing") {
+    ProfileData file;
+    file.merge({"f", 1, {10}});
+    file.merge({"g", 2, {20}});
+    string bytes = serialize(file);
+
+    ProfileData profile;
+    profile.merge({"f", 1, {1}});
+    string error;
+    // cut into the last counter of g, after f has been parsed
+    istringstream truncated(bytes.substr(0, bytes.size() - 1));
+    CHECK(!profile.read(truncated, error) && error == "Truncated profile file.");
+    CHECK(profile.size() == 1 && profile.find("f")->counters[0] == 1);
+
+    // g conflicts with what is held, so f is not summed either
+    profile.merge({"g", 3, {1}});
+    istringstream conflicting(bytes);
+    CHECK(!profile.read(conflicting, error));
+    CHECK(error == "Conflicting profile entries for function 'g'.");
+    CHECK(profile.find("f")->counters[0] == 1);
+
+    ProfileData fresh;
+    fresh.merge({"f", 1, {1}});
+    istringstream good(bytes);
+    CHECK(fresh.read(good, error) && fresh.size() == 2);
+    CHECK(fresh.find("f")->counters[0] == 11);
+}
@@ -0,0 +1,63 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "check.h"
+#include "fds/rope.h"
+
+using namespace std;
+
+TEST_CASE("fds/rope_chunk_growth") {
+    // a small rope takes one small chunk
+    Rope small;
+    small << "mov rax, 1\n";
+    CHECK(small.chunkCount() == 1);
+
+    // chunks double from 256 bytes up to 16 KiB: 256 + 512 + ... + 16384 = 32512 bytes
+    // in 7 chunks, after which each chunk holds 16 KiB
+    Rope big;
+    string expect;
+    for (size_t i = 0; i < 32512; ++i) {
+        big.push_back(static_cast<char>('a' + i % 26));
+        expect += static_cast<char>('a' + i % 26);
+    }
+    CHECK(big.chunkCount() == 7);
+    for (size_t i = 0; i < 16384 + 1; ++i) {
+        big.push_back('x');
+    }
+    expect.append(16384 + 1, 'x');
+    CHECK(big.chunkCount() == 9);
+    CHECK(big.size() == expect.size() && big.str() == expect);
+
+    // an append larger than the next chunk gets a chunk of its own size
+    Rope wide;
+    wide.append(string(100000, 'y'));
+    CHECK(wide.chunkCount() == 1 && wide.size() == 100000);
+}
+
+TEST_CASE("fds/rope_splice_and_write") {
+    string blob(1000, 'r');
+    Rope a;
+    a << "head ";
+    Rope b;
+    b.appendRef(blob.data(), blob.size());
+    b << " tail";
+    a.splice(move(b));
+    CHECK(b.empty() && b.chunkCount() == 0);
+    CHECK(a.str() == "head " + blob + " tail");
+
+    string path = "/tmp/ecc-check-" + to_string(getpid()) + "-rope";
+    string error;
+    CHECK(a.writeFile(path, error));
+    FILE* file = fopen(path.c_str(), "rb");
+    string back(a.size() + 1, '\0');
+    CHECK(file && fread(&back[0], 1, back.size(), file) == a.size());
+    if (file) {
+        fclose(file);
+    }
+    back.resize(a.size());
+    CHECK(back == a.str());
+    remove(path.c_str());
+}
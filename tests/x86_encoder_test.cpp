@@ -0,0 +1,76 @@
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "codegen/x86_encoder.h"
+
+using namespace std;
+using namespace Codegen;
+
+namespace {
+
+vector<uint8_t> encode(const function<void(X86Encoder&)>& emit) {
+    X86Encoder enc;
+    emit(enc);
+    return enc.finish().bytes;
+}
+
+} // namespace
+
+TEST_CASE("codegen/x86_modrm_mem") {
+    // rsp and r12 as base need a SIB byte
+    CHECK((encode([](X86Encoder& e) { e.load(Reg::RAX, {Reg::RSP, 0}); }) ==
+           vector<uint8_t>{0x48, 0x8b, 0x04, 0x24}));
+    CHECK((encode([](X86Encoder& e) { e.load(Reg::RAX, {Reg::R12, 8}); }) ==
+           vector<uint8_t>{0x49, 0x8b, 0x44, 0x24, 0x08}));
+    CHECK((encode([](X86Encoder& e) { e.store({Reg::RSP, -8}, Reg::RAX); }) ==
+           vector<uint8_t>{0x48, 0x89, 0x44, 0x24, 0xf8}));
+    // rbp and r13 as base have no form without displacement
+    CHECK((encode([](X86Encoder& e) { e.load(Reg::RCX, {Reg::RBP, 0}); }) ==
+           vector<uint8_t>{0x48, 0x8b, 0x4d, 0x00}));
+    CHECK((encode([](X86Encoder& e) { e.load(Reg::RAX, {Reg::R13, 0}); }) ==
+           vector<uint8_t>{0x49, 0x8b, 0x45, 0x00}));
+    CHECK((encode([](X86Encoder& e) { e.load(Reg::RDX, {Reg::RBX, 0x1000}); }) ==
+           vector<uint8_t>{0x48, 0x8b, 0x93, 0x00, 0x10, 0x00, 0x00}));
+    CHECK((encode([](X86Encoder& e) { e.load(Reg::RDX, {Reg::RBX, 0}); }) ==
+           vector<uint8_t>{0x48, 0x8b, 0x13}));
+}
+
+TEST_CASE("codegen/x86_mov_imm") {
+    // zero extending mov r32, imm32
+    CHECK((encode([](X86Encoder& e) { e.movImm(Reg::RAX, 5); }) ==
+           vector<uint8_t>{0xb8, 0x05, 0x00, 0x00, 0x00}));
+    CHECK((encode([](X86Encoder& e) { e.movImm(Reg::R9, UINT32_MAX); }) ==
+           vector<uint8_t>{0x41, 0xb9, 0xff, 0xff, 0xff, 0xff}));
+    // sign extending mov r/m64, imm32
+    CHECK((encode([](X86Encoder& e) { e.movImm(Reg::RAX, -1); }) ==
+           vector<uint8_t>{0x48, 0xc7, 0xc0, 0xff, 0xff, 0xff, 0xff}));
+    // movabs r64, imm64
+    CHECK((encode([](X86Encoder& e) { e.movImm(Reg::R10, int64_t{1} << 40); }) ==
+           vector<uint8_t>{0x49, 0xba, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00}));
+}
+
+TEST_CASE("codegen/x86_setcc") {
+    // registers 4-7 need a REX prefix to mean spl, bpl, sil and dil rather than ah..bh
+    CHECK((encode([](X86Encoder& e) { e.setcc(Cond::E, Reg::RSP); }) ==
+           vector<uint8_t>{0x40, 0x0f, 0x94, 0xc4, 0x40, 0x0f, 0xb6, 0xe4}));
+    CHECK((encode([](X86Encoder& e) { e.setcc(Cond::NE, Reg::RBP); }) ==
+           vector<uint8_t>{0x40, 0x0f, 0x95, 0xc5, 0x40, 0x0f, 0xb6, 0xed}));
+    CHECK((encode([](X86Encoder& e) { e.setcc(Cond::L, Reg::RSI); }) ==
+           vector<uint8_t>{0x40, 0x0f, 0x9c, 0xc6, 0x40, 0x0f, 0xb6, 0xf6}));
+    CHECK((encode([](X86Encoder& e) { e.setcc(Cond::G, Reg::RDI); }) ==
+           vector<uint8_t>{0x40, 0x0f, 0x9f, 0xc7, 0x40, 0x0f, 0xb6, 0xff}));
+    CHECK((encode([](X86Encoder& e) { e.setcc(Cond::NE, Reg::RBX); }) ==
+           vector<uint8_t>{0x0f, 0x95, 0xc3, 0x0f, 0xb6, 0xdb}));
+    CHECK((encode([](X86Encoder& e) { e.setcc(Cond::G, Reg::R8); }) ==
+           vector<uint8_t>{0x41, 0x0f, 0x9f, 0xc0, 0x45, 0x0f, 0xb6, 0xc0}));
+
+    // the listing names the registers the bytes use
+    X86Encoder enc(true);
+    enc.setcc(Cond::L, Reg::RSI);
+    enc.setcc(Cond::E, Reg::R9);
+    CHECK(enc.finish().listing.str() ==
+          "    setl sil\n    movzx esi, sil\n    sete r9b\n    movzx r9d, r9b\n");
+}